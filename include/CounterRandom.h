@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+
+// Counter based random numbers (Philox4x32-10, Salmon et al. 2011). Every
+// draw is a pure function of (seed, region, feature type, feature index, draw
+// index), so any feature can be regenerated on its own, on any thread, in O(1).
+// The finite world is region (0, 0).
+class CounterRandom
+{
+public:
+    enum class Feature : uint32_t
+    {
+        Mountain = 1,
+        River = 2,
+        Erosion = 3
+    };
+
+    CounterRandom(uint32_t seed, Feature feature, uint32_t featureIndex, int32_t regionX = 0, int32_t regionY = 0);
+    ~CounterRandom(){};
+
+    uint32_t get(uint32_t drawIndex) const;
+    // Uniform in [min, max], inclusive like std::uniform_int_distribution
+    int uniformInt(uint32_t drawIndex, int min, int max) const;
+    // Uniform in [min, max)
+    float uniformFloat(uint32_t drawIndex, float min, float max) const;
+
+    static void philox(const uint32_t counter[4], const uint32_t key[2], uint32_t result[4]);
+
+private:
+    uint32_t key[2];
+    uint32_t feature;
+    uint32_t featureIndex;
+    uint32_t region;
+};
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "Heightfield.h"
+#include "constants.h"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// Geomipmapping over the full resolution vertex grid of a heightfield. The
+// world is split into square patches which each use every 2^level sample.
+// Edge vertices of a patch next to a coarser patch are snapped down to the
+// coarser spacing, which collapses the T-junctions into degenerate triangles
+// that are left out, so any combination of levels is crack-free.
+class Geomipmap
+{
+public:
+    // patchSize must be a power of two
+    explicit Geomipmap(const Heightfield& world, int patchSize = c_lodPatchSize);
+    ~Geomipmap(){};
+
+    // Recomputes the errors and bounds of the patches containing samples of the rectangle
+    void updateRegion(const DirtyRect& rect);
+
+    // Picks the coarsest level of each patch whose height error projects to
+    // at most pixelError pixels. Returns true if any level changed.
+    bool selectLevels(const glm::vec3& cameraPosition, float pixelScale, float pixelError);
+
+    // Triangles of the selected levels as indices into the row-major sample
+    // grid. The triangles of patch i are [patchOffsets[i], patchOffsets[i + 1])
+    // with patches in row-major order.
+    void buildIndices(std::vector<uint32_t>& indices, std::vector<size_t>& patchOffsets) const;
+
+    int getLevelCount() const;
+    int getPatchCountX() const;
+    int getPatchCountY() const;
+    int getLevel(int patchX, int patchY) const;
+    // Bounding box of a patch in world units
+    void getPatchBounds(int patchX, int patchY, glm::vec3& min, glm::vec3& max) const;
+    // Largest height difference of a patch level against the full resolution
+    float getError(int patchX, int patchY, int level) const;
+
+    // Pixels per world unit at unit distance for a projection matrix
+    static float getPixelScale(const glm::mat4& projection, int viewportHeight);
+
+private:
+    const Heightfield& world;
+    int patchSize;
+    int levelCount;
+    int cellsX;
+    int cellsY;
+    int patchCountX;
+    int patchCountY;
+    std::vector<float> errors;
+    std::vector<float> minHeights;
+    std::vector<float> maxHeights;
+    std::vector<int> levels;
+
+    void computePatchErrors(int patchX, int patchY);
+    int getNeighborStep(int patchX, int patchY, int step) const;
+};
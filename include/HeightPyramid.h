@@ -0,0 +1,62 @@
+#pragma once
+
+#include "Heightfield.h"
+#include "constants.h"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+// Min/max pyramid over the cells of a heightfield for ray casting against its
+// triangle mesh. Level 0 holds the height range of every block of
+// c_pyramidLeafSize x c_pyramidLeafSize cells and each level above the range
+// of 2 x 2 nodes of the level below. Rays descend the pyramid front to back
+// and skip the nodes whose boxes they miss, so only the cells near the ray
+// are tested against their two triangles. Positions are in
+// world units of the mesh: x and z are samples times c_worldScale, y is the height.
+class HeightPyramid
+{
+public:
+    explicit HeightPyramid(const Heightfield& world);
+    ~HeightPyramid(){};
+
+    // Recomputes the ranges of the cells containing samples of the rectangle
+    void updateRegion(const DirtyRect& rect);
+
+    // Distance along direction in multiples of its length to the first
+    // triangle hit within maxDistance. Returns false if nothing is hit.
+    bool intersectRay(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, float& distance) const;
+    // Rays in blocks of c_rayBatchSize on threadCount threads, distances of
+    // rays that hit nothing are set to -1
+    void intersectRays(const std::vector<glm::vec3>& origins, const std::vector<glm::vec3>& directions, float maxDistance,
+                       std::vector<float>& distances, int threadCount) const;
+
+    // Height of the mesh at (x, z), clamped to the world
+    float getSurfaceHeight(float x, float z) const;
+    bool contains(float x, float z) const;
+
+    int getLevelCount() const;
+    size_t getMemoryUsage() const;
+
+    // First hit of the two triangles of a cell, origin and direction in samples
+    static bool intersectCell(const Heightfield& world, int cellX, int cellY, const glm::vec3& origin, const glm::vec3& direction, float& distance);
+
+private:
+    struct Level
+    {
+        int width;
+        int height;
+        // Minimum and maximum of every node, interleaved
+        std::vector<float> ranges;
+    };
+
+    const Heightfield& world;
+    int cellsX;
+    int cellsY;
+    std::vector<Level> levels;
+
+    // Nearest hit among the cells of a leaf block
+    bool intersectLeaf(int blockX, int blockY, const glm::vec3& origin, const glm::vec3& direction, const glm::vec3& inverse, float maxDistance,
+                       float& distance) const;
+    void updateBlocks(int minX, int minY, int maxX, int maxY);
+};
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "world.h"
+#include "WorldParams.h"
+#include "constants.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Heights of a world at scattered points without generating its grid. The
+// bumps of the mountains and rivers are kept as features in a uniform grid of
+// cells and a query sums the features of the cell it falls in. Features are
+// summed in generation order with the exact stamp kernels, so heights at the
+// samples match generateWorld with StampMode::Exact bit for bit. Erosion and
+// smoothing need the whole grid and are not applied.
+class HeightQuery
+{
+public:
+    // Kept between batched queries, one per thread
+    struct Scratch
+    {
+        std::vector<uint64_t> keys;
+        std::vector<float> x;
+        std::vector<float> y;
+        std::vector<float> heights;
+    };
+
+    HeightQuery(unsigned int seed, const WorldParams& params, int cellSize = c_queryCellSize);
+    ~HeightQuery(){};
+
+    // Coordinates are in samples and clamped to [0, params.width] x [0, params.height]
+    float heightAt(float x, float y) const;
+    // Analytic derivatives of the height along x and y
+    float gradientAt(float x, float y, float& dhdx, float& dhdy) const;
+    // Heights of count points, grouped by cell and evaluated with the stamp
+    // kernel of getStampKernel. Safe to call from several threads with their
+    // own scratch.
+    void getHeights(const float* x, const float* y, int count, float* heights, Scratch& scratch) const;
+
+    size_t getFeatureCount() const;
+    size_t getMemoryUsage() const;
+
+private:
+    struct Feature
+    {
+        float x;
+        float y;
+        float limit;
+        float scale;
+        float falloff;
+    };
+
+    WorldParams params;
+    int cellSize;
+    int cellCountX;
+    int cellCountY;
+    std::vector<Feature> features;
+    // Feature indices of every cell in generation order
+    std::vector<std::vector<uint32_t>> cells;
+
+    void addFeature(const Bump& bump);
+    void carveRiver(const std::vector<RiverPoint>& pits);
+    int getCellIndex(float& x, float& y) const;
+};
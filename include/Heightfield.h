@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Inclusive rectangle of samples
+struct DirtyRect
+{
+    int minX;
+    int minY;
+    int maxX;
+    int maxY;
+};
+
+// Height samples in a single aligned allocation. Rows are padded to the
+// stride so that every row starts on an alignment boundary. The tiled layout
+// stores square blocks of c_tileSize x c_tileSize samples contiguously.
+class Heightfield
+{
+public:
+    enum class Layout
+    {
+        RowMajor,
+        Tiled
+    };
+
+    static const int c_alignment = 64;
+    static const int c_tileSize = 16;
+    // Dirty rectangles beyond this are merged into their bounding box
+    static const int c_maxDirtyRects = 16;
+
+    explicit Heightfield(){};
+    Heightfield(int width, int height, Layout layout = Layout::RowMajor);
+    Heightfield(const Heightfield& other);
+    Heightfield(Heightfield&& other) noexcept;
+    ~Heightfield();
+
+    Heightfield& operator=(const Heightfield& other);
+    Heightfield& operator=(Heightfield&& other) noexcept;
+
+    void resize(int width, int height, Layout layout = Layout::RowMajor);
+    void fill(float value);
+
+    int getWidth() const;
+    int getHeight() const;
+    int getStride() const;
+    Layout getLayout() const;
+    size_t getSize() const;
+
+    size_t index(int x, int y) const;
+    // Number of samples stored contiguously in memory from (x, y) towards +x
+    int getContiguousRun(int x) const;
+    float& at(int x, int y);
+    float at(int x, int y) const;
+
+    // Only valid for the row-major layout
+    float* row(int y);
+    const float* row(int y) const;
+
+    float* data();
+    const float* data() const;
+
+    // Samples changed since the last clearDirty, kept as non-overlapping
+    // rectangles for partial mesh and buffer updates. Edits mark what they
+    // change, fill and resize mark everything.
+    void markDirty(int minX, int minY, int maxX, int maxY);
+    void markAllDirty();
+    const std::vector<DirtyRect>& getDirtyRects() const;
+    void clearDirty();
+
+private:
+    int width = 0;
+    int height = 0;
+    int stride = 0;
+    int paddedHeight = 0;
+    Layout layout = Layout::RowMajor;
+    float* samples = nullptr;
+    std::vector<DirtyRect> dirtyRects;
+
+    void release();
+};
+
+inline size_t Heightfield::index(int x, int y) const
+{
+    if (layout == Layout::RowMajor)
+    {
+        return static_cast<size_t>(y) * stride + x;
+    }
+    size_t tileX = static_cast<size_t>(x / c_tileSize);
+    size_t tileY = static_cast<size_t>(y / c_tileSize);
+    size_t tilesPerRow = static_cast<size_t>(stride / c_tileSize);
+    size_t tile = tileY * tilesPerRow + tileX;
+    return tile * c_tileSize * c_tileSize + (y % c_tileSize) * c_tileSize + (x % c_tileSize);
+}
+
+inline int Heightfield::getContiguousRun(int x) const
+{
+    return layout == Layout::RowMajor ? width - x : c_tileSize - x % c_tileSize;
+}
+
+inline float& Heightfield::at(int x, int y)
+{
+    return samples[index(x, y)];
+}
+
+inline float Heightfield::at(int x, int y) const
+{
+    return samples[index(x, y)];
+}
+
+inline float* Heightfield::row(int y)
+{
+    return samples + static_cast<size_t>(y) * stride;
+}
+
+inline const float* Heightfield::row(int y) const
+{
+    return samples + static_cast<size_t>(y) * stride;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "Heightfield.h"
+#include "mesh.h"
+
+#include <cstddef>
+#include <vector>
+
+// Right-triangulated irregular network over a heightfield. The world is
+// covered by a square grid of 2^n cells which is split recursively into
+// right isosceles triangles by bisecting their hypotenuses. Every
+// hypotenuse midpoint stores an upper bound of the height error of the
+// triangles split there: the midpoint error plus the largest bound of their
+// children. Triangles sharing a hypotenuse split together and a split
+// triangle always splits its parent, so the meshes have no cracks. Triangles
+// reaching past the world edge always split and those outside are dropped.
+class Rtin
+{
+public:
+    explicit Rtin(const Heightfield& world);
+    ~Rtin(){};
+
+    // Coarsest triangulation whose height at every sample is within maxError
+    // of the sample. Vertices are the used samples with the position and
+    // normal of generateIndexedMesh, in one chunk.
+    void generateMesh(float maxError, IndexedMesh& mesh) const;
+
+    int getGridSize() const;
+    size_t getMemoryUsage() const;
+
+private:
+    const Heightfield& world;
+    int cellsX;
+    int cellsY;
+    int gridSize;
+    // (gridSize + 1)^2 error bounds
+    std::vector<float> errors;
+
+    void computeErrors();
+    // Error bound of triangle (a, b, c) with the right angle at c, zero
+    // outside the world and infinite across its edge
+    float getTriangleError(int ax, int ay, int bx, int by, int cx, int cy) const;
+    void addTriangles(int ax, int ay, int bx, int by, int cx, int cy, float maxError, std::vector<uint32_t>& vertexMap, IndexedMesh& mesh) const;
+};
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Unit height Gaussian profiles exp(-d^2 / (2 * deviation^2)) for deviations
+// quantized to a fixed step. The Gaussian is separable, so a bump is stamped
+// as profile[dy] * profile[dx] and only one row of samples is stored per
+// quantized deviation. Each profile covers one sample more than the bump
+// window of its deviation so it also covers deviations rounded down into it.
+class StampCache
+{
+public:
+    StampCache(float minDeviation, float maxDeviation, float step);
+    ~StampCache(){};
+
+    bool contains(float deviation) const;
+    float quantize(float deviation) const;
+
+    // Returns the center sample of the profile, valid for offsets [-radius, radius]
+    const float* getProfile(float deviation, int& radius) const;
+
+    int getProfileCount() const;
+    size_t getMemoryUsage() const;
+    // Memory the same cache would need when storing full 2D tiles
+    size_t getTileMemoryUsage() const;
+
+private:
+    float minDeviation;
+    float maxDeviation;
+    float step;
+    std::vector<size_t> centers;
+    std::vector<int> radiuses;
+    std::vector<float> profiles;
+
+    int getProfileIndex(float deviation) const;
+};
+
+// Shared cache covering the mountain and river deviations of constants.h
+const StampCache& getStampCache();
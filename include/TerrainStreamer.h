@@ -0,0 +1,103 @@
+#pragma once
+
+#include "Heightfield.h"
+#include "mesh.h"
+#include "WorldParams.h"
+#include "constants.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Chunk of the infinite world, samples start from (x, z) * c_chunkSize
+struct TerrainChunk
+{
+    int x;
+    int z;
+    Heightfield heights;
+    IndexedMesh mesh;
+    float minHeight;
+    float maxHeight;
+    // From the request to the end of generation
+    double latencySeconds;
+};
+
+struct StreamingStats
+{
+    long long cacheHits = 0;
+    long long cacheMisses = 0;
+    long long generated = 0;
+    long long evicted = 0;
+    long long cancelled = 0;
+    double totalLatencySeconds = 0.0;
+    double maxLatencySeconds = 0.0;
+    double totalGenerationSeconds = 0.0;
+};
+
+// Generates chunks around a moving position on background threads. Finished
+// chunks go to a bounded cache which evicts the chunks farthest from the
+// position first and the least recently used among equally far ones.
+class TerrainStreamer
+{
+public:
+    // Regions of the endless world are params.width x params.height cells
+    TerrainStreamer(unsigned int seed, int workerCount, int radius = c_streamingRadius, int capacity = c_chunkCacheCapacity,
+                    const WorldParams& params = WorldParams());
+    ~TerrainStreamer();
+
+    // Requests the chunks within the radius of a position in world units.
+    // Never waits for generation. Chunks finished since the previous call are
+    // appended to ready and keys of chunks dropped from the cache to evicted.
+    // Chunks finished and dropped in the same call are left out of ready.
+    void update(float x, float z, std::vector<std::shared_ptr<const TerrainChunk>>& ready, std::vector<int64_t>& evicted);
+
+    // True when every requested chunk has been generated
+    bool isIdle();
+    size_t getResidentCount() const;
+    StreamingStats getStats();
+
+    static int64_t getChunkKey(int x, int z);
+    static void generateChunk(unsigned int seed, const WorldParams& params, int x, int z, TerrainChunk& chunk);
+
+private:
+    struct Request
+    {
+        int x;
+        int z;
+        double requestTime;
+    };
+
+    struct Entry
+    {
+        std::shared_ptr<const TerrainChunk> chunk;
+        long long lastUsed;
+    };
+
+    unsigned int seed;
+    WorldParams params;
+    int radius;
+    size_t capacity;
+    long long frame = 0;
+
+    // Accessed by the calling thread only
+    std::unordered_map<int64_t, Entry> resident;
+
+    // Shared with the workers
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::vector<Request> queue;
+    std::unordered_map<int64_t, bool> inFlight;
+    std::vector<std::shared_ptr<const TerrainChunk>> finished;
+    int centerX = 0;
+    int centerZ = 0;
+    bool stopping = false;
+    StreamingStats stats;
+
+    std::vector<std::thread> workers;
+
+    void workerLoop();
+};
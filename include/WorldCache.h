@@ -0,0 +1,58 @@
+#pragma once
+
+#include "Heightfield.h"
+#include "mesh.h"
+#include "WorldParams.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Hash of everything a generated world and its indexed mesh depend on: the
+// cache format version, seed, world parameters and mesh constants
+uint64_t getWorldParameterHash(unsigned int seed, const WorldParams& params);
+std::string getWorldCacheFilename(uint64_t parameterHash);
+
+// Read-only memory mapping of a world cache file. The file has a header,
+// the heights as rows of width samples and optionally the indexed mesh
+// chunks, vertices and indices, each section aligned to 64 bytes. Pages are
+// read from disk only when touched.
+class WorldCache
+{
+public:
+    explicit WorldCache(){};
+    ~WorldCache();
+    WorldCache(const WorldCache&) = delete;
+    WorldCache& operator=(const WorldCache&) = delete;
+
+    // Fails if the file is missing, truncated or made with other parameters
+    bool open(const std::string& filename, uint64_t parameterHash);
+    void close();
+    bool isOpen() const;
+
+    int getWidth() const;
+    int getHeight() const;
+    const float* getHeights() const;
+    // Resizes world to the cached size in its own layout
+    void copyHeights(Heightfield& world) const;
+
+    bool hasMesh() const;
+    IndexedMeshView getMesh() const;
+    size_t getFileSize() const;
+
+    // Writes a temporary file which is then renamed over filename, so an
+    // interrupted write never leaves a partial cache behind
+    static bool write(const std::string& filename, uint64_t parameterHash, const Heightfield& world, const IndexedMesh* mesh);
+
+private:
+    struct Header;
+
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+#ifdef _WIN32
+    void* file = nullptr;
+    void* mapping = nullptr;
+#endif
+
+    const Header& getHeader() const;
+};
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "constants.h"
+
+#include <string>
+
+// Generation parameters of a world, the defaults come from constants.h
+struct WorldParams
+{
+    // Size in cells, the heightfield has one sample more in both directions
+    int width = c_worldWidth;
+    int height = c_worldHeight;
+
+    // Mountains
+    int numMountains = c_numMountains;
+    int minMountainLength = c_minMountainLength;
+    int maxMountainLength = c_maxMountainLength;
+    int mountainEdgeMargin = c_mountainEdgeMargin;
+    float minHeightMultiplier = c_minHeightMultiplier;
+    float maxHeightMultiplier = c_maxHeightMultiplier;
+    float minBumpDeviation = c_minBumpDeviation;
+    float maxBumpDeviation = c_maxBumpDeviation;
+    float mountainWaveLength = c_mountainWaveLength;
+    int bumpDensity = c_bumpDensity;
+    float minParabolaCoefficient = c_minParabolaCoefficient;
+    float maxParabolaCoefficient = c_maxParabolaCoefficient;
+    int minParabolaExponent = c_minParabolaExponent;
+    int maxParabolaExponent = c_maxParabolaExponent;
+
+    // Rivers
+    int numRivers = c_numRivers;
+    int riverControlPoints = c_riverControlPoints;
+    float riverDepth = c_riverDepth;
+    float riverDeviation = c_riverDeviation;
+    int riverPitDensity = c_riverPitDensity;
+    float riverSlopeSteepness = c_riverSlopeSteepness;
+    int riverEndPointMargin = c_riverEndPointMargin;
+
+    // Hydraulic erosion
+    int erosionDroplets = c_erosionDroplets;
+    int erosionLifetime = c_erosionLifetime;
+    float erosionInertia = c_erosionInertia;
+    float erosionCapacity = c_erosionCapacity;
+    float erosionMinCapacity = c_erosionMinCapacity;
+    float erosionErodeSpeed = c_erosionErodeSpeed;
+    float erosionDepositSpeed = c_erosionDepositSpeed;
+    float erosionEvaporateSpeed = c_erosionEvaporateSpeed;
+    float erosionGravity = c_erosionGravity;
+
+    // Thermal erosion and smoothing
+    int thermalIterations = c_thermalIterations;
+    float thermalTalus = c_thermalTalus;
+    float thermalRate = c_thermalRate;
+    int smoothIterations = c_smoothIterations;
+    float smoothStrength = c_smoothStrength;
+};
+
+// Sets a parameter by its member name, e.g. "numMountains". Returns false for
+// unknown names and values that do not parse.
+bool setWorldParam(WorldParams& params, const std::string& name, const std::string& value);
+// False with a message on std::cerr if the ranges are empty or the sizes too small
+bool validateWorldParams(const WorldParams& params);
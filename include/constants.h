@@ -8,7 +8,9 @@ const float pi = 3.14159265f;
 const int c_screenWidth = 1600;
 const int c_screenHeight = 900;
 
+#ifdef SHADER_PATH
 const std::string shaderPath = SHADER_PATH;
+#endif
 
 const float c_mouseSensitivity = 0.1f;
 const float c_movementSpeedMultiplier = 3.0f;
@@ -18,10 +20,89 @@ const int c_worldWidth = 500;
 const int c_worldHeight = 500;
 const float c_worldScale = 0.01f;
 
+// Mesh
+enum class MeshFormat
+{
+    Soup,
+    Indexed,
+    Packed,
+    // Heights in a texture displacing a shared grid of c_gridTileSize cells
+    HeightTexture,
+    // Right-triangulated irregular network within c_adaptiveMaxError of the samples
+    Adaptive
+};
+const MeshFormat c_meshFormat = MeshFormat::Indexed;
+const int c_packedNormalBits = 8;
+// R32F or R16 height texture
+const int c_heightTextureBits = 32;
+const int c_gridTileSize = 64;
+const float c_adaptiveMaxError = 0.005f;
+// Rows per thread task of the triangle soup
+const int c_meshBandHeight = 32;
+// Quads per strip, so that two rows of strip vertices fit a 32 entry vertex cache
+const int c_meshStripWidth = 14;
+
+// Level of detail, used with the indexed mesh. Patches of c_lodPatchSize
+// cells are drawn with every 2^level sample so that the projected height
+// error stays below c_lodPixelError pixels.
+const bool c_lod = true;
+const int c_lodPatchSize = 32;
+const float c_lodPixelError = 2.0f;
+
+// Culling of level of detail patches and streamed chunks
+const bool c_frustumCulling = true;
+const bool c_horizonCulling = false;
+const int c_horizonBins = 512;
+
 // Random
 const bool c_randomSeed = false;
 const unsigned int c_seed = 618344276;
 
+// Generated worlds and their indexed meshes are cached in
+// world-<parameter hash>.cache files in the working directory
+const bool c_worldCache = true;
+
+// Streaming, chunks of c_chunkSize x c_chunkSize cells generated around the camera
+const bool c_streaming = false;
+const int c_chunkSize = 128;
+const int c_streamingRadius = 4;
+const int c_chunkCacheCapacity = 128;
+
+// Terrain edits, the crater rim rises to c_craterRimHeight times the depth
+// and falls off over c_craterRimWidth times the radius
+const float c_craterRimHeight = 0.3f;
+const float c_craterRimWidth = 0.5f;
+// Edits of the viewer, C for a crater and F to flatten
+const float c_craterRadius = 20.0f;
+const float c_craterDepth = 0.5f;
+const float c_flattenRadius = 30.0f;
+
+// Out-of-core export, tiles of c_outOfCoreTileSize cells are halved down to
+// c_outOfCoreMinTileSize to fit a memory limit
+const int c_outOfCoreTileSize = 1024;
+const int c_outOfCoreMinTileSize = 64;
+const int c_outOfCoreApron = 1;
+
+// Ray casting, cells per side of the height pyramid leaves and rays per
+// thread task of batched queries
+const int c_pyramidLeafSize = 4;
+const int c_rayBatchSize = 256;
+// The viewer camera is kept c_cameraGroundClearance above the terrain and
+// edits the terrain point it looks at within c_pickDistance
+const float c_cameraGroundClearance = 0.05f;
+const float c_pickDistance = 10.0f;
+
+// Point queries, bumps are binned into square cells of c_queryCellSize cells
+const int c_queryCellSize = 32;
+
+// Tracing, events kept per thread when built with TERRAIN_TRACING
+const int c_traceBufferEvents = 1 << 16;
+// Written by the viewer on exit
+const std::string c_traceFilename = "trace.json";
+
+// Parallel generation
+const int c_stampBandHeight = 32;
+
 // Mountains
 const int c_numMountains = 5;
 const int c_minMountainLength = 200;
@@ -34,14 +115,44 @@ const float c_maxBumpDeviation = 17.0f;
 const float c_mountainWaveLength = 0.1f;
 const int c_bumpDensity = 3;
 const float c_standardDeviationArea = 4.0f;
+const float c_stampDeviationStep = 1.0f / 256.0f;
 const float c_maxParabolaCoefficient = 0.01f;
 const float c_minParabolaCoefficient = -0.01f;
 const int c_maxParabolaExponent = 2;
 const int c_minParabolaExponent = 2;
 
-// River
+// Rivers, the first follows a fixed slope across the world and the others
+// random splines through riverControlPoints points between two opposite edges
+const int c_numRivers = 1;
+const int c_riverControlPoints = 4;
 const float c_riverDepth = 0.2f;
 const float c_riverDeviation = 15.0f;
 const int c_riverPitDensity = 10;
 const float c_riverSlopeSteepness = 1.5f;
-const int c_riverEndPointMargin = 50;
\ No newline at end of file
+const int c_riverEndPointMargin = 50;
+
+// Hydraulic erosion by water droplets after the rivers are carved, off with
+// zero droplets. Droplets live c_erosionLifetime steps of one cell each.
+const int c_erosionDroplets = 0;
+const int c_erosionLifetime = 30;
+const float c_erosionInertia = 0.05f;
+const float c_erosionCapacity = 4.0f;
+const float c_erosionMinCapacity = 0.01f;
+const float c_erosionErodeSpeed = 0.3f;
+const float c_erosionDepositSpeed = 0.3f;
+const float c_erosionEvaporateSpeed = 0.01f;
+const float c_erosionGravity = 4.0f;
+// Droplets per tile between synchronizations of the tile phases
+const int c_erosionBatch = 1024;
+
+// Thermal erosion moves material down slopes steeper than the talus height
+// difference per cell, smoothing averages every sample with its neighbors.
+// Both run after the hydraulic erosion and are off with zero iterations.
+const int c_thermalIterations = 0;
+const float c_thermalTalus = 0.02f;
+const float c_thermalRate = 0.1f;
+const int c_smoothIterations = 0;
+const float c_smoothStrength = 0.5f;
+// Rows per thread task and columns per cache block of the stencil passes
+const int c_stencilBandHeight = 32;
+const int c_stencilBlockWidth = 1024;
\ No newline at end of file
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Planes a * x + b * y + c * z + d >= 0 for points inside, in the order
+// left, right, bottom, top, near, far
+struct Frustum
+{
+    float planes[6][4];
+};
+
+// Axis aligned boxes in structure of arrays layout for the batch tests
+struct BoxList
+{
+    std::vector<float> minX;
+    std::vector<float> minY;
+    std::vector<float> minZ;
+    std::vector<float> maxX;
+    std::vector<float> maxY;
+    std::vector<float> maxZ;
+
+    void clear();
+    void add(const glm::vec3& min, const glm::vec3& max);
+    size_t size() const;
+};
+
+struct CullingStats
+{
+    int tested = 0;
+    int frustumCulled = 0;
+    int horizonCulled = 0;
+    double seconds = 0.0;
+};
+
+void extractFrustum(const glm::mat4& viewProjection, Frustum& frustum);
+
+// Sets visible[i] to 0 for boxes completely outside a plane of the frustum
+// and to 1 otherwise. Four boxes are tested at a time with SSE2 when available.
+void cullFrustum(const Frustum& frustum, const BoxList& boxes, std::vector<uint8_t>& visible);
+void cullFrustumScalar(const Frustum& frustum, const BoxList& boxes, std::vector<uint8_t>& visible);
+
+// Conservative occlusion of terrain boxes by nearer terrain boxes. A horizon
+// of elevation angles is kept in bins around the camera. Every box raises
+// the bins it fully covers to a lower bound of its own elevation once all
+// boxes in front of it are processed, and boxes below the horizon in every
+// bin they touch are hidden. Returns the number of boxes hidden.
+int cullHorizon(const glm::vec3& camera, const BoxList& boxes, int binCount, std::vector<uint8_t>& visible);
+
+// Frustum culling followed by optional horizon culling, timed into stats
+void cullBoxes(const glm::mat4& viewProjection, const glm::vec3& camera, const BoxList& boxes, bool horizon,
+               std::vector<uint8_t>& visible, CullingStats& stats);
@@ -0,0 +1,16 @@
+#pragma once
+
+#include "Heightfield.h"
+#include "WorldParams.h"
+
+// Side of the square tiles droplets start from. A droplet moves at most
+// params.erosionLifetime cells, so droplets of tiles two apart never touch the
+// same samples.
+int getErosionTileSize(const WorldParams& params);
+
+// Simulates about params.erosionDroplets droplets that pick up sediment going
+// downhill and drop it when they slow down or climb. Tiles are processed in
+// four phases of tiles two apart in both directions on threadCount threads,
+// and every droplet is seeded from its tile and index, so the result does not
+// depend on the thread count. Returns the number of droplets simulated.
+long long erodeHydraulic(Heightfield& world, unsigned int seed, const WorldParams& params, int threadCount);
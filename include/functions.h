@@ -42,4 +42,10 @@ inline float slope(float x, float exponent)
 inline float divide(int dividend, int divider)
 {
     return static_cast<float>(dividend) / static_cast<float>(divider);
-}
\ No newline at end of file
+}
+
+// Rounds towards negative infinity, divider > 0
+inline int floorDivide(int value, int divider)
+{
+    return value >= 0 ? value / divider : -((-value + divider - 1) / divider);
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+#include "Heightfield.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Band of rows drawn with one draw call, indices are relative to baseVertex
+struct MeshChunk
+{
+    int baseVertex;
+    size_t firstIndex;
+    int indexCount;
+};
+
+// One vertex per height sample with interleaved position and normal. Chunks
+// use 16-bit indices unless a single row of samples does not fit into them.
+struct IndexedMesh
+{
+    std::vector<float> vertices;
+    bool wideIndices = false;
+    std::vector<uint16_t> indices16;
+    std::vector<uint32_t> indices32;
+    std::vector<MeshChunk> chunks;
+
+    size_t getVertexCount() const;
+    size_t getIndexCount() const;
+    size_t getMemoryUsage() const;
+};
+
+// Non-owning view of indexed mesh buffers, e.g. mapped from a cache file
+struct IndexedMeshView
+{
+    const float* vertices;
+    size_t vertexFloatCount;
+    bool wideIndices;
+    const void* indices;
+    size_t indexCount;
+    const MeshChunk* chunks;
+    size_t chunkCount;
+};
+
+IndexedMeshView getMeshView(const IndexedMesh& mesh);
+
+// Byte range of a buffer, e.g. for glBufferSubData
+struct BufferRange
+{
+    size_t offset;
+    size_t size;
+};
+
+// Chunk of a packed mesh. Every chunk stores its own rows of vertices,
+// including the boundary rows shared with its neighbors.
+struct PackedChunk
+{
+    int firstRow;
+    int baseVertex;
+    size_t firstIndex;
+    int indexCount;
+    // Decoded height is minHeight + quantized * heightStep
+    float minHeight;
+    float heightStep;
+};
+
+// Vertices hold a 16-bit height quantized against the chunk range and an
+// octahedral normal of 2 x normalBits bits. x and z are implied by the vertex
+// position in the grid. Height steps are powers of two and boundary rows are
+// quantized to the coarser step of the two chunks, so shared samples decode
+// to exactly the same height in both chunks.
+struct PackedMesh
+{
+    int width = 0;
+    int normalBits = 8;
+    int stride = 0;
+    std::vector<uint8_t> vertices;
+    bool wideIndices = false;
+    std::vector<uint16_t> indices16;
+    std::vector<uint32_t> indices32;
+    std::vector<PackedChunk> chunks;
+
+    size_t getVertexCount() const;
+    size_t getIndexCount() const;
+    size_t getMemoryUsage() const;
+};
+
+// Heights of a world as an R32F or R16 texture for shaders/heightmap.vert.
+// The height of a texel is heightOffset + heightScale * value, where value is
+// the float texel or the 16-bit texel normalized to [0, 1]. 16-bit texels use
+// a power of two height step like the packed mesh.
+struct HeightTexture
+{
+    int width = 0;
+    int height = 0;
+    int bits = 32;
+    float heightOffset = 0.0f;
+    float heightScale = 1.0f;
+    std::vector<float> texels32;
+    std::vector<uint16_t> texels16;
+
+    const void* getTexels() const;
+    size_t getTexelSize() const;
+    size_t getMemoryUsage() const;
+    float getHeight(int x, int y) const;
+};
+
+// Triangle soup of six vertices with position and face normal per cell.
+// indices and vertices are resized to fit, rows are split into bands of
+// c_meshBandHeight on threadCount threads with the same output on any count.
+void generateMesh(const Heightfield& world, std::vector<int>& indices, std::vector<float>& vertices, int threadCount = 1);
+// Samples within apron of the border are only used for the normals of the
+// inner samples, e.g. to get matching normals along streamed chunk borders
+void generateIndexedMesh(const Heightfield& world, IndexedMesh& mesh, int apron = 0);
+// Rewrites the vertices of a mesh from generateIndexedMesh(world, mesh) whose
+// height or normal depends on the dirty samples of world, one row of vertices
+// at a time. The changed bytes of mesh.vertices are appended to changed, rows
+// that follow each other in memory as one range. Indices do not change.
+void updateIndexedMesh(const Heightfield& world, IndexedMesh& mesh, std::vector<BufferRange>& changed);
+// Smooth normal of a sample from central differences, one sided at the borders
+void getSampleNormal(const Heightfield& world, int x, int y, float normal[3]);
+// normalBits is 8 or 16
+void generatePackedMesh(const Heightfield& world, int normalBits, PackedMesh& mesh);
+// CPU version of the decoding in shaders/packed.vert
+void unpackVertex(const PackedMesh& mesh, const PackedChunk& chunk, int localVertex, float position[3], float normal[3]);
+
+// bits is 32 or 16
+void generateHeightTexture(const Heightfield& world, int bits, HeightTexture& texture);
+// Rewrites the texels of rect. Returns false if a 16-bit texel falls outside
+// the quantized range, the texture then has to be generated again.
+bool updateHeightTexture(const Heightfield& world, const DirtyRect& rect, HeightTexture& texture);
+// Shared grid of tileSize x tileSize cells drawn once per tile of the height
+// texture. Vertices are x, y pairs within the tile, indices as in the indexed mesh.
+void generateGridMesh(int tileSize, std::vector<uint16_t>& vertices, std::vector<uint16_t>& indices);
+// Instances needed to cover the texture with tiles
+int getGridTileCount(const HeightTexture& texture, int tileSize, int& tileCountX);
+// CPU version of shaders/heightmap.vert for the vertex at sample (x, y)
+void getHeightTextureVertex(const HeightTexture& texture, int x, int y, float position[3], float normal[3]);
+
+// Octahedral mapping of a unit normal around the +y axis to [0, 2^bits - 1]^2
+void encodeOctahedral(const float normal[3], int bits, uint32_t& u, uint32_t& v);
+void decodeOctahedral(uint32_t u, uint32_t v, int bits, float normal[3]);
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "Heightfield.h"
+#include "mesh.h"
+#include "world.h"
+#include "WorldParams.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Out-of-core generation of worlds larger than memory. The world is split
+// into tiles of tileSize x tileSize cells, neighboring tiles share their
+// border samples. Bumps are binned by the tiles they reach and every tile is
+// stamped from its own bin, in bump order, so tile heights match generateWorld
+// bit for bit. Rivers and erosion need the whole world and are not applied.
+struct TileGrid
+{
+    int worldWidth;
+    int worldHeight;
+    int tileSize;
+    int tileCountX;
+    int tileCountY;
+
+    int getTileCount() const;
+};
+
+enum class TileMeshFormat
+{
+    None,
+    // The format of writeIndexedMesh
+    Binary,
+    Gltf
+};
+
+struct TileExportOptions
+{
+    int tileSize = c_outOfCoreTileSize;
+    int threadCount = 1;
+    // Bytes, zero for no limit. The thread count and then the tile size are
+    // lowered until the estimated peak of the bumps, bins and tile buffers fits.
+    size_t maxMemory = 0;
+    bool heights = true;
+    TileMeshFormat meshFormat = TileMeshFormat::Binary;
+    // Files are <prefix>.tiles, <prefix>_<x>_<y>.r16 and .mesh or .gltf and .bin
+    std::string outputPrefix;
+};
+
+struct TileExportStats
+{
+    int tileSize = 0;
+    int threadCount = 0;
+    int tileCount = 0;
+    size_t bumpCount = 0;
+    size_t estimatedMemory = 0;
+    // Heights are stored as heightOffset + texel * heightStep
+    float heightOffset = 0.0f;
+    float heightStep = 0.0f;
+    uint64_t bytesWritten = 0;
+};
+
+TileGrid getTileGrid(const WorldParams& params, int tileSize);
+// Indices of the bumps reaching the samples of each tile and its apron, in
+// bump order. Tiles are in row-major order.
+void binBumps(const std::vector<Bump>& bumps, const TileGrid& grid, std::vector<std::vector<uint32_t>>& bins);
+// Heights of tile (tileX, tileY) with c_outOfCoreApron samples around it,
+// scratch is kept between calls
+void generateTile(const TileGrid& grid, int tileX, int tileY, const std::vector<Bump>& bumps, const std::vector<uint32_t>& bin, Heightfield& tile,
+                  std::vector<Bump>& scratch);
+// Bytes one tile in flight needs for its heights and mesh
+size_t getTileMemory(int tileSize, TileMeshFormat meshFormat);
+// Generates the tiles on options.threadCount threads and writes them as they
+// finish. Returns false with a message on std::cerr if a file cannot be
+// written or the world does not fit into options.maxMemory.
+bool exportTiles(unsigned int seed, const WorldParams& params, const TileExportOptions& options, TileExportStats& stats);
+
+// Index is written as vertex float count, index count, index size in bytes,
+// chunk count, chunks as (base vertex, first index, index count), vertices
+// and indices
+bool writeIndexedMesh(const std::string& filename, const IndexedMesh& mesh);
+// glTF 2.0 with positions, normals and 32-bit indices in a .bin file of the same name
+bool writeGltf(const std::string& filename, const IndexedMesh& mesh);
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <functional>
+
+// Number of hardware threads, at least one
+int getDefaultThreadCount();
+
+// Calls task(i) for every i in [0, count) using up to threadCount threads
+// including the calling one. Indices are handed out in increasing order but
+// may finish in any order, so tasks must write to disjoint data.
+void parallelFor(int count, int threadCount, const std::function<void(int)>& task);
+
+// Calls task(thread, i) for every i in [0, count) on up to threadCount threads,
+// thread in [0, threadCount) identifies the caller e.g. for per-thread buffers.
+// Every thread starts with a contiguous share of the indices and steals half
+// of the largest remaining share once its own runs out, so a few slow tasks
+// do not leave the other threads idle.
+void parallelForStealing(int count, int threadCount, const std::function<void(int, int)>& task);
@@ -0,0 +1,68 @@
+#pragma once
+
+// Row kernels for stamping Gaussian bumps. Each kernel adds
+// scale * exp(-(dx * dx + dy2) * falloff) to count consecutive samples where
+// dx starts from firstDx and grows by one per sample. All kernels evaluate the
+// same polynomial exp approximation with the same operation order, so the
+// output does not depend on which kernel the CPU supports.
+enum class StampKernel
+{
+    Scalar,
+    SSE,
+    AVX2
+};
+
+// Exact evaluates the Gaussian for every sample, Cached scales the
+// separable unit profiles of StampCache
+enum class StampMode
+{
+    Exact,
+    Cached
+};
+
+typedef void (*StampRowFunction)(float* samples, int count, float firstDx, float dy2, float scale, float falloff);
+// Adds scale * profile[i] to count consecutive samples
+typedef void (*AddScaledRowFunction)(float* samples, const float* profile, int count, float scale);
+// Adds scale * exp(-(dx * dx + dy * dy) * falloff) to the heights of count
+// scattered points (x, y) that are at most limit from the center along both
+// axes, the same window and sum as the stamped samples
+typedef void (*AddBumpPointsFunction)(const float* x, const float* y, float* heights, int count, float centerX, float centerY, float limit, float scale,
+                                      float falloff);
+
+void stampRowScalar(float* samples, int count, float firstDx, float dy2, float scale, float falloff);
+void stampRowSse(float* samples, int count, float firstDx, float dy2, float scale, float falloff);
+void stampRowAvx2(float* samples, int count, float firstDx, float dy2, float scale, float falloff);
+
+void addScaledRowScalar(float* samples, const float* profile, int count, float scale);
+void addScaledRowSse(float* samples, const float* profile, int count, float scale);
+void addScaledRowAvx2(float* samples, const float* profile, int count, float scale);
+
+void addBumpPointsScalar(const float* x, const float* y, float* heights, int count, float centerX, float centerY, float limit, float scale, float falloff);
+void addBumpPointsSse(const float* x, const float* y, float* heights, int count, float centerX, float centerY, float limit, float scale, float falloff);
+void addBumpPointsAvx2(const float* x, const float* y, float* heights, int count, float centerX, float centerY, float limit, float scale, float falloff);
+
+bool isStampKernelSupported(StampKernel kernel);
+const char* getStampKernelName(StampKernel kernel);
+StampRowFunction getStampRowFunction(StampKernel kernel);
+AddScaledRowFunction getAddScaledRowFunction(StampKernel kernel);
+AddBumpPointsFunction getAddBumpPointsFunction(StampKernel kernel);
+
+// Best supported kernel unless overridden with setStampKernel
+StampKernel getStampKernel();
+void setStampKernel(StampKernel kernel);
+
+// Cached unless overridden with setStampMode
+StampMode getStampMode();
+void setStampMode(StampMode mode);
+
+// Cephes style expf, max relative error about 2 ulp for the stamped range
+const float c_expMin = -87.0f;
+const float c_expLog2e = 1.44269504088896341f;
+const float c_expLn2Hi = 0.693359375f;
+const float c_expLn2Lo = -2.12194440e-4f;
+const float c_expP0 = 1.9875691500e-4f;
+const float c_expP1 = 1.3981999507e-3f;
+const float c_expP2 = 8.3334519073e-3f;
+const float c_expP3 = 4.1665795894e-2f;
+const float c_expP4 = 1.6666665459e-1f;
+const float c_expP5 = 5.0000001201e-1f;
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "Heightfield.h"
+#include "stamp.h"
+
+#include <algorithm>
+
+// Row kernels of the 5-point stencils. Each writes count samples of out from
+// row[i] and its neighbors row[i - 1], row[i + 1], above[i] and below[i], so
+// row must have a readable sample on both sides. The kernels are picked like
+// the stamp kernels and use the same operation order, so they give identical
+// results.
+typedef void (*StencilRowFunction)(const float* above, const float* row, const float* below, float* out, int count, float a, float b);
+
+// a is the talus, b the rate: every pair of neighbors exchanges rate times
+// their height difference beyond the talus, which keeps the total height
+void thermalRowScalar(const float* above, const float* row, const float* below, float* out, int count, float talus, float rate);
+void thermalRowSse(const float* above, const float* row, const float* below, float* out, int count, float talus, float rate);
+void thermalRowAvx2(const float* above, const float* row, const float* below, float* out, int count, float talus, float rate);
+// a is the strength, the fraction of the way moved towards the neighbor average, b is unused
+void smoothRowScalar(const float* above, const float* row, const float* below, float* out, int count, float strength, float unused);
+void smoothRowSse(const float* above, const float* row, const float* below, float* out, int count, float strength, float unused);
+void smoothRowAvx2(const float* above, const float* row, const float* below, float* out, int count, float strength, float unused);
+
+StencilRowFunction getThermalRowFunction(StampKernel kernel);
+StencilRowFunction getSmoothRowFunction(StampKernel kernel);
+
+inline float getThermalTransfer(float difference, float talus)
+{
+    return std::max(difference - talus, 0.0f) + std::min(difference + talus, 0.0f);
+}
+
+// Every iteration reads world and writes scratch, which is resized to match,
+// in bands of c_stencilBandHeight rows on threadCount threads. Samples on the
+// edges use themselves for the missing neighbors. The result is in world.
+void erodeThermal(Heightfield& world, Heightfield& scratch, int iterations, float talus, float rate, int threadCount);
+void smoothHeights(Heightfield& world, Heightfield& scratch, int iterations, float strength, int threadCount);
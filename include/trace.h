@@ -0,0 +1,51 @@
+#pragma once
+
+// Scoped timers and counters recorded into per-thread ring buffers and
+// exported as Chrome trace events, viewable in chrome://tracing or Perfetto.
+// Configure with -DTERRAIN_TRACING=ON to record, otherwise the macros
+// compile to nothing. Names must be string literals.
+
+#ifdef TERRAIN_TRACING
+
+#include <cstdint>
+#include <string>
+
+uint64_t getTraceTime();
+void recordTraceScope(const char* name, uint64_t start, uint64_t end);
+void recordTraceCounter(const char* name, double value);
+void setTraceThreadName(const char* name);
+// Threads still recording while writing may leave torn events in the file
+bool writeChromeTrace(const std::string& filename);
+void clearTrace();
+
+class TraceScope
+{
+public:
+    explicit TraceScope(const char* name) :
+        name(name),
+        start(getTraceTime()){};
+    ~TraceScope()
+    {
+        recordTraceScope(name, start, getTraceTime());
+    };
+
+private:
+    const char* name;
+    uint64_t start;
+};
+
+#define TRACE_JOIN_NAME(a, b) a##b
+#define TRACE_SCOPE_NAME(line) TRACE_JOIN_NAME(traceScope, line)
+#define TRACE_SCOPE(name) TraceScope TRACE_SCOPE_NAME(__LINE__)(name)
+#define TRACE_COUNTER(name, value) recordTraceCounter(name, static_cast<double>(value))
+#define TRACE_THREAD_NAME(name) setTraceThreadName(name)
+#define TRACE_WRITE(filename) writeChromeTrace(filename)
+
+#else
+
+#define TRACE_SCOPE(name)
+#define TRACE_COUNTER(name, value)
+#define TRACE_THREAD_NAME(name)
+#define TRACE_WRITE(filename) false
+
+#endif
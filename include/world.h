@@ -0,0 +1,91 @@
+#pragma once
+
+#include "Heightfield.h"
+#include "CounterRandom.h"
+#include "WorldParams.h"
+
+#include <vector>
+
+struct Bump
+{
+    int x;
+    int y;
+    float multiplier;
+    float deviation;
+};
+
+struct RiverPoint
+{
+    float x;
+    float y;
+};
+
+// Parameters of one mountain ridge, derived from the world parameters, seed,
+// region and mountain index alone
+struct Mountain
+{
+    CounterRandom random;
+    int length;
+    float baseMultiplier;
+    int centerX;
+    int centerY;
+    int iterationStart;
+    float a;
+    int exp;
+};
+
+float createBump(Heightfield& world, int centerX, int centerY, float bumpHeightMultiplier, float deviation);
+// Marks the samples a bump reaches as dirty
+void markBumpDirty(Heightfield& world, const Bump& bump);
+// Stamps the part of the bump that falls on rows [minY, maxY] without marking
+// it dirty, so that bands can be stamped on several threads
+void stampBump(Heightfield& world, const Bump& bump, int minY, int maxY);
+// Marks the bumps dirty and stamps them in order. Rows are split into bands
+// owned by one thread each, so every sample sums the bumps in the same order
+// as the serial path.
+void stampBumps(Heightfield& world, const std::vector<Bump>& bumps, int threadCount);
+bool getBumpPosition(const WorldParams& params, int iteration, int centerX, int centerY, int& x, int& y, float a, int exp);
+Mountain createMountainParameters(const WorldParams& params, unsigned int seed, int mountainIndex, int regionX = 0, int regionY = 0);
+int getMountainBumpCount(const WorldParams& params, const Mountain& mountain);
+// Returns false if the bump falls outside the edge margins
+bool createMountainBump(const WorldParams& params, const Mountain& mountain, int bumpIndex, Bump& bump);
+void createMountainBumps(const WorldParams& params, unsigned int seed, int mountainIndex, std::vector<Bump>& bumps);
+void createMountain(Heightfield& world, unsigned int seed, int mountainIndex, const WorldParams& params);
+int getPitPosition(const Heightfield& world, int startHeight, int endHeight, int x, const WorldParams& params);
+// Same for a world of sampleWidth samples per row
+int getPitPosition(int sampleWidth, int startHeight, int endHeight, int x, const WorldParams& params);
+// Height change at the center of a bump with multiplier 1
+float getBumpCenterGain(float deviation);
+// Lowers the sample under each pit to -params.riverDepth with a single stamp,
+// pits already deep enough are skipped. Pits outside the world are ignored.
+void carveRiver(Heightfield& world, const std::vector<RiverPoint>& pits, const WorldParams& params);
+// Pits every spacing cells along the Catmull-Rom spline through the control points
+void getRiverPits(const std::vector<RiverPoint>& controlPoints, float spacing, std::vector<RiverPoint>& pits);
+// The first river of a world, along a slope from the left to the right edge
+void createRiver(Heightfield& world, const WorldParams& params);
+// Control points of river riverIndex >= 1 from one edge to the opposite one
+void createRiverPath(const WorldParams& params, unsigned int seed, int riverIndex, std::vector<RiverPoint>& controlPoints);
+// params.numRivers rivers, carved in order
+void createRivers(Heightfield& world, unsigned int seed, const WorldParams& params);
+// Gameplay edits, radius in samples. They mark the samples they change dirty.
+// Bowl depth below the surface at the center with a raised rim around it
+void createCrater(Heightfield& world, int centerX, int centerY, float radius, float depth);
+// Blends the heights towards height, fully within half of the radius
+void flattenArea(Heightfield& world, int centerX, int centerY, float radius, float height);
+
+// Resizes world to (params.width + 1) x (params.height + 1) samples in its own
+// layout. Mountains are stamped and erosion and smoothing run on threadCount threads,
+// the output does not depend on the thread count. bumps and scratch, used by
+// the stencil passes, are kept between calls.
+void generateWorld(Heightfield& world, unsigned int seed, const WorldParams& params, int threadCount, std::vector<Bump>& bumps, Heightfield& scratch);
+void generateWorld(Heightfield& world, unsigned int seed, const WorldParams& params, int threadCount = 1);
+// Default parameters with the size of the heightfield, e.g. (c_worldWidth + 1) x (c_worldHeight + 1) samples
+void generateWorld(Heightfield& world, unsigned int seed, int threadCount = 1);
+
+// Infinite world made of regions of params.width x params.height cells, each
+// with its own params.numMountains mountains. Bumps are in world sample coordinates.
+void createRegionBumps(const WorldParams& params, unsigned int seed, int regionX, int regionY, std::vector<Bump>& bumps);
+// Heights of the infinite world for samples [originX, originX + width) x
+// [originY, originY + height). Bumps reaching the window are stamped in a fixed
+// global order, so overlapping windows get bit-identical samples.
+void generateWindow(Heightfield& window, unsigned int seed, int originX, int originY, const WorldParams& params = WorldParams());
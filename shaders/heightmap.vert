@@ -0,0 +1,36 @@
+#version 450 core
+layout (location = 0) in uvec2 gridPosition;
+
+layout (location = 0) uniform mat4 MVP;
+layout (location = 1) uniform float worldScale;
+layout (location = 2) uniform int tileSize;
+layout (location = 3) uniform int tileCountX;
+layout (location = 4) uniform float heightOffset;
+layout (location = 5) uniform float heightScale;
+
+layout (binding = 0) uniform sampler2D heights;
+
+layout (location = 0) out vec3 outNormal;
+
+float getHeight(ivec2 texel)
+{
+	return heightOffset + heightScale * texelFetch(heights, texel, 0).r;
+}
+
+void main()
+{
+	// Vertices past the last sample are clamped onto it, their triangles are degenerate
+	ivec2 size = textureSize(heights, 0);
+	ivec2 tile = ivec2(gl_InstanceID % tileCountX, gl_InstanceID / tileCountX);
+	ivec2 texel = min(tile * tileSize + ivec2(gridPosition), size - 1);
+
+	// Same gradient as getSampleNormal, one sided at the borders
+	ivec2 low = max(texel - 1, ivec2(0));
+	ivec2 high = min(texel + 1, size - 1);
+	float dx = (getHeight(ivec2(high.x, texel.y)) - getHeight(ivec2(low.x, texel.y))) / float(high.x - low.x);
+	float dz = (getHeight(ivec2(texel.x, high.y)) - getHeight(ivec2(texel.x, low.y))) / float(high.y - low.y);
+	outNormal = normalize(vec3(-dx, worldScale, -dz));
+
+	vec3 position = vec3(float(texel.x) * worldScale, getHeight(texel), float(texel.y) * worldScale);
+	gl_Position = MVP * vec4(position, 1.0);
+}
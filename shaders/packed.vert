@@ -0,0 +1,35 @@
+#version 450 core
+layout (location = 0) in uint height;
+layout (location = 1) in vec2 octahedralNormal;
+
+layout (location = 0) uniform mat4 MVP;
+layout (location = 1) uniform int gridWidth;
+layout (location = 2) uniform float worldScale;
+layout (location = 3) uniform int chunkFirstRow;
+layout (location = 4) uniform int chunkBaseVertex;
+layout (location = 5) uniform float minHeight;
+layout (location = 6) uniform float heightStep;
+
+layout (location = 0) out vec3 outNormal;
+
+vec3 decodeOctahedral(vec2 encoded)
+{
+	vec2 p = encoded * 2.0 - 1.0;
+	vec3 n = vec3(p.x, 1.0 - abs(p.x) - abs(p.y), p.y);
+	if (n.y < 0.0)
+	{
+		n.xz = (1.0 - abs(n.zx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.z >= 0.0 ? 1.0 : -1.0);
+	}
+	return normalize(n);
+}
+
+void main()
+{
+	// gl_VertexID includes the base vertex of the draw call
+	int localVertex = gl_VertexID - chunkBaseVertex;
+	int x = localVertex % gridWidth;
+	int y = chunkFirstRow + localVertex / gridWidth;
+	vec3 position = vec3(float(x) * worldScale, minHeight + float(height) * heightStep, float(y) * worldScale);
+	gl_Position = MVP * vec4(position, 1.0);
+	outNormal = decodeOctahedral(octahedralNormal);
+}
@@ -0,0 +1,77 @@
+#include "CounterRandom.h"
+
+namespace
+{
+const uint32_t c_philoxM0 = 0xD2511F53u;
+const uint32_t c_philoxM1 = 0xCD9E8D57u;
+const uint32_t c_philoxW0 = 0x9E3779B9u;
+const uint32_t c_philoxW1 = 0xBB67AE85u;
+const int c_philoxRounds = 10;
+// Second key word so that seed 0 does not use an all zero key
+const uint32_t c_keySalt = 0x7E3A9C15u;
+} // namespace
+
+CounterRandom::CounterRandom(uint32_t seed, Feature feature, uint32_t featureIndex, int32_t regionX, int32_t regionY) :
+    feature(static_cast<uint32_t>(feature)),
+    featureIndex(featureIndex),
+    region(static_cast<uint32_t>(regionX))
+{
+    // Multiplying by an odd constant is a bijection, so every regionY gets its own key
+    key[0] = seed;
+    key[1] = c_keySalt + static_cast<uint32_t>(regionY) * c_philoxW0;
+}
+
+uint32_t CounterRandom::get(uint32_t drawIndex) const
+{
+    const uint32_t counter[4] = {drawIndex, featureIndex, feature, region};
+    uint32_t result[4];
+    philox(counter, key, result);
+    return result[0];
+}
+
+int CounterRandom::uniformInt(uint32_t drawIndex, int min, int max) const
+{
+    uint64_t range = static_cast<uint64_t>(static_cast<int64_t>(max) - min) + 1;
+    uint64_t offset = (static_cast<uint64_t>(get(drawIndex)) * range) >> 32;
+    return static_cast<int>(min + static_cast<int64_t>(offset));
+}
+
+float CounterRandom::uniformFloat(uint32_t drawIndex, float min, float max) const
+{
+    // 24 random bits fill the float mantissa exactly
+    float t = static_cast<float>(get(drawIndex) >> 8) * (1.0f / 16777216.0f);
+    return min + (max - min) * t;
+}
+
+void CounterRandom::philox(const uint32_t counter[4], const uint32_t key[2], uint32_t result[4])
+{
+    uint32_t c0 = counter[0];
+    uint32_t c1 = counter[1];
+    uint32_t c2 = counter[2];
+    uint32_t c3 = counter[3];
+    uint32_t k0 = key[0];
+    uint32_t k1 = key[1];
+
+    for (int round = 0; round < c_philoxRounds; ++round)
+    {
+        uint64_t product0 = static_cast<uint64_t>(c_philoxM0) * c0;
+        uint64_t product1 = static_cast<uint64_t>(c_philoxM1) * c2;
+        uint32_t hi0 = static_cast<uint32_t>(product0 >> 32);
+        uint32_t lo0 = static_cast<uint32_t>(product0);
+        uint32_t hi1 = static_cast<uint32_t>(product1 >> 32);
+        uint32_t lo1 = static_cast<uint32_t>(product1);
+
+        c0 = hi1 ^ c1 ^ k0;
+        c1 = lo1;
+        c2 = hi0 ^ c3 ^ k1;
+        c3 = lo0;
+
+        k0 += c_philoxW0;
+        k1 += c_philoxW1;
+    }
+
+    result[0] = c0;
+    result[1] = c1;
+    result[2] = c2;
+    result[3] = c3;
+}
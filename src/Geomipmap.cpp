@@ -0,0 +1,268 @@
+#include "Geomipmap.h"
+
+#include <algorithm>
+#include <cmath>
+
+Geomipmap::Geomipmap(const Heightfield& world, int patchSize) :
+    world(world),
+    patchSize(patchSize),
+    cellsX(world.getWidth() - 1),
+    cellsY(world.getHeight() - 1)
+{
+    levelCount = 1;
+    while ((1 << (levelCount - 1)) < patchSize)
+    {
+        ++levelCount;
+    }
+    patchCountX = (cellsX + patchSize - 1) / patchSize;
+    patchCountY = (cellsY + patchSize - 1) / patchSize;
+
+    size_t patchCount = static_cast<size_t>(patchCountX) * patchCountY;
+    errors.assign(patchCount * levelCount, 0.0f);
+    minHeights.resize(patchCount);
+    maxHeights.resize(patchCount);
+    levels.assign(patchCount, 0);
+
+    for (int py = 0; py < patchCountY; ++py)
+    {
+        for (int px = 0; px < patchCountX; ++px)
+        {
+            computePatchErrors(px, py);
+        }
+    }
+}
+
+void Geomipmap::updateRegion(const DirtyRect& rect)
+{
+    // Patch samples overlap by one row and column with the next patch
+    int minPatchX = std::max((rect.minX - 1) / patchSize, 0);
+    int minPatchY = std::max((rect.minY - 1) / patchSize, 0);
+    int maxPatchX = std::min(rect.maxX / patchSize, patchCountX - 1);
+    int maxPatchY = std::min(rect.maxY / patchSize, patchCountY - 1);
+    for (int py = minPatchY; py <= maxPatchY; ++py)
+    {
+        for (int px = minPatchX; px <= maxPatchX; ++px)
+        {
+            computePatchErrors(px, py);
+        }
+    }
+}
+
+void Geomipmap::computePatchErrors(int patchX, int patchY)
+{
+    size_t patch = static_cast<size_t>(patchY) * patchCountX + patchX;
+    int startX = patchX * patchSize;
+    int startY = patchY * patchSize;
+    int endX = std::min(startX + patchSize, cellsX);
+    int endY = std::min(startY + patchSize, cellsY);
+
+    minHeights[patch] = world.at(startX, startY);
+    maxHeights[patch] = minHeights[patch];
+    for (int y = startY; y <= endY; ++y)
+    {
+        for (int x = startX; x <= endX; ++x)
+        {
+            minHeights[patch] = std::min(minHeights[patch], world.at(x, y));
+            maxHeights[patch] = std::max(maxHeights[patch], world.at(x, y));
+        }
+    }
+
+    float* patchErrors = &errors[patch * levelCount];
+    for (int level = 1; level < levelCount; ++level)
+    {
+        int step = 1 << level;
+        float error = patchErrors[level - 1];
+        for (int y0 = startY; y0 < endY; y0 += step)
+        {
+            int y1 = std::min(y0 + step, endY);
+            for (int x0 = startX; x0 < endX; x0 += step)
+            {
+                int x1 = std::min(x0 + step, endX);
+                float h00 = world.at(x0, y0);
+                float h10 = world.at(x1, y0);
+                float h01 = world.at(x0, y1);
+                float h11 = world.at(x1, y1);
+
+                // Same diagonal as the triangles of buildIndices
+                for (int y = y0; y <= y1; ++y)
+                {
+                    float v = static_cast<float>(y - y0) / static_cast<float>(y1 - y0);
+                    for (int x = x0; x <= x1; ++x)
+                    {
+                        float u = static_cast<float>(x - x0) / static_cast<float>(x1 - x0);
+                        float h;
+                        if (u + v <= 1.0f)
+                        {
+                            h = h00 + u * (h10 - h00) + v * (h01 - h00);
+                        }
+                        else
+                        {
+                            h = h11 + (1.0f - u) * (h01 - h11) + (1.0f - v) * (h10 - h11);
+                        }
+                        error = std::max(error, std::abs(world.at(x, y) - h));
+                    }
+                }
+            }
+        }
+        patchErrors[level] = error;
+    }
+}
+
+bool Geomipmap::selectLevels(const glm::vec3& cameraPosition, float pixelScale, float pixelError)
+{
+    bool changed = false;
+    for (int py = 0; py < patchCountY; ++py)
+    {
+        for (int px = 0; px < patchCountX; ++px)
+        {
+            size_t patch = static_cast<size_t>(py) * patchCountX + px;
+
+            // Distance to the bounding box of the patch
+            glm::vec3 min;
+            glm::vec3 max;
+            getPatchBounds(px, py, min, max);
+            float dx = std::max(std::max(min.x - cameraPosition.x, cameraPosition.x - max.x), 0.0f);
+            float dy = std::max(std::max(min.y - cameraPosition.y, cameraPosition.y - max.y), 0.0f);
+            float dz = std::max(std::max(min.z - cameraPosition.z, cameraPosition.z - max.z), 0.0f);
+            float distance = std::sqrt(dx * dx + dy * dy + dz * dz);
+
+            const float* patchErrors = &errors[patch * levelCount];
+            int level = 0;
+            while (level + 1 < levelCount && patchErrors[level + 1] * pixelScale <= pixelError * distance)
+            {
+                ++level;
+            }
+            changed = changed || levels[patch] != level;
+            levels[patch] = level;
+        }
+    }
+    return changed;
+}
+
+int Geomipmap::getNeighborStep(int patchX, int patchY, int step) const
+{
+    if (patchX < 0 || patchY < 0 || patchX >= patchCountX || patchY >= patchCountY)
+    {
+        return step;
+    }
+    return std::max(1 << levels[static_cast<size_t>(patchY) * patchCountX + patchX], step);
+}
+
+void Geomipmap::buildIndices(std::vector<uint32_t>& indices, std::vector<size_t>& patchOffsets) const
+{
+    indices.clear();
+    patchOffsets.clear();
+    uint32_t width = static_cast<uint32_t>(world.getWidth());
+    int samples = patchSize + 1;
+    std::vector<uint32_t> patchVertices(static_cast<size_t>(samples) * samples);
+
+    for (int py = 0; py < patchCountY; ++py)
+    {
+        for (int px = 0; px < patchCountX; ++px)
+        {
+            patchOffsets.push_back(indices.size());
+            int step = 1 << levels[static_cast<size_t>(py) * patchCountX + px];
+            int leftStep = getNeighborStep(px - 1, py, step);
+            int rightStep = getNeighborStep(px + 1, py, step);
+            int topStep = getNeighborStep(px, py - 1, step);
+            int bottomStep = getNeighborStep(px, py + 1, step);
+            int count = patchSize / step;
+
+            for (int j = 0; j <= count; ++j)
+            {
+                for (int i = 0; i <= count; ++i)
+                {
+                    int x = i * step;
+                    int y = j * step;
+                    if (i == 0)
+                    {
+                        y = y / leftStep * leftStep;
+                    }
+                    else if (i == count)
+                    {
+                        y = y / rightStep * rightStep;
+                    }
+                    if (j == 0)
+                    {
+                        x = x / topStep * topStep;
+                    }
+                    else if (j == count)
+                    {
+                        x = x / bottomStep * bottomStep;
+                    }
+                    x = std::min(px * patchSize + x, cellsX);
+                    y = std::min(py * patchSize + y, cellsY);
+                    patchVertices[j * samples + i] = static_cast<uint32_t>(y) * width + static_cast<uint32_t>(x);
+                }
+            }
+
+            for (int j = 0; j < count; ++j)
+            {
+                for (int i = 0; i < count; ++i)
+                {
+                    uint32_t topLeft = patchVertices[j * samples + i];
+                    uint32_t topRight = patchVertices[j * samples + i + 1];
+                    uint32_t bottomLeft = patchVertices[(j + 1) * samples + i];
+                    uint32_t bottomRight = patchVertices[(j + 1) * samples + i + 1];
+
+                    // Same winding as generateMesh, collapsed triangles are skipped
+                    if (topLeft != topRight && topLeft != bottomLeft && topRight != bottomLeft)
+                    {
+                        indices.push_back(topLeft);
+                        indices.push_back(topRight);
+                        indices.push_back(bottomLeft);
+                    }
+                    if (topRight != bottomRight && topRight != bottomLeft && bottomRight != bottomLeft)
+                    {
+                        indices.push_back(topRight);
+                        indices.push_back(bottomRight);
+                        indices.push_back(bottomLeft);
+                    }
+                }
+            }
+        }
+    }
+    patchOffsets.push_back(indices.size());
+}
+
+int Geomipmap::getLevelCount() const
+{
+    return levelCount;
+}
+
+int Geomipmap::getPatchCountX() const
+{
+    return patchCountX;
+}
+
+int Geomipmap::getPatchCountY() const
+{
+    return patchCountY;
+}
+
+int Geomipmap::getLevel(int patchX, int patchY) const
+{
+    return levels[static_cast<size_t>(patchY) * patchCountX + patchX];
+}
+
+void Geomipmap::getPatchBounds(int patchX, int patchY, glm::vec3& min, glm::vec3& max) const
+{
+    size_t patch = static_cast<size_t>(patchY) * patchCountX + patchX;
+    min.x = static_cast<float>(patchX * patchSize) * c_worldScale;
+    min.y = minHeights[patch];
+    min.z = static_cast<float>(patchY * patchSize) * c_worldScale;
+    max.x = static_cast<float>(std::min((patchX + 1) * patchSize, cellsX)) * c_worldScale;
+    max.y = maxHeights[patch];
+    max.z = static_cast<float>(std::min((patchY + 1) * patchSize, cellsY)) * c_worldScale;
+}
+
+float Geomipmap::getError(int patchX, int patchY, int level) const
+{
+    return errors[(static_cast<size_t>(patchY) * patchCountX + patchX) * levelCount + level];
+}
+
+float Geomipmap::getPixelScale(const glm::mat4& projection, int viewportHeight)
+{
+    // projection[1][1] is 1 / tan(fov / 2)
+    return projection[1][1] * static_cast<float>(viewportHeight) * 0.5f;
+}
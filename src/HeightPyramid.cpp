@@ -0,0 +1,332 @@
+#include "HeightPyramid.h"
+#include "parallel.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+// Slack of the box tests in ray lengths, boxes touched by the ray within
+// rounding are descended and the triangle tests decide
+const float c_boxSlack = 1e-4f;
+
+struct Node
+{
+    int level;
+    int x;
+    int z;
+};
+
+bool intersectBox(const glm::vec3& origin, const glm::vec3& inverse, const glm::vec3& min, const glm::vec3& max, float maxDistance)
+{
+    glm::vec3 t0 = (min - origin) * inverse;
+    glm::vec3 t1 = (max - origin) * inverse;
+    float nearest = std::max(std::max(std::min(t0.x, t1.x), std::min(t0.y, t1.y)), std::max(std::min(t0.z, t1.z), 0.0f));
+    float farthest = std::min(std::min(std::max(t0.x, t1.x), std::max(t0.y, t1.y)), std::min(std::max(t0.z, t1.z), maxDistance));
+    return nearest <= farthest + c_boxSlack;
+}
+
+// Moller-Trumbore, both sides of the triangle
+bool intersectTriangle(const glm::vec3& origin, const glm::vec3& direction, const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2, float& distance)
+{
+    glm::vec3 edge1 = v1 - v0;
+    glm::vec3 edge2 = v2 - v0;
+    glm::vec3 p = glm::cross(direction, edge2);
+    float determinant = glm::dot(edge1, p);
+    if (std::abs(determinant) < 1e-12f)
+    {
+        return false;
+    }
+    float inverse = 1.0f / determinant;
+    glm::vec3 s = origin - v0;
+    float u = glm::dot(s, p) * inverse;
+    if (u < 0.0f || u > 1.0f)
+    {
+        return false;
+    }
+    glm::vec3 q = glm::cross(s, edge1);
+    float v = glm::dot(direction, q) * inverse;
+    if (v < 0.0f || u + v > 1.0f)
+    {
+        return false;
+    }
+    distance = glm::dot(edge2, q) * inverse;
+    return distance >= 0.0f;
+}
+
+float getRangeMin(const std::vector<float>& ranges, size_t node)
+{
+    return ranges[2 * node];
+}
+
+float getRangeMax(const std::vector<float>& ranges, size_t node)
+{
+    return ranges[2 * node + 1];
+}
+} // namespace
+
+HeightPyramid::HeightPyramid(const Heightfield& world) :
+    world(world),
+    cellsX(world.getWidth() - 1),
+    cellsY(world.getHeight() - 1)
+{
+    TRACE_SCOPE("buildHeightPyramid");
+    Level level;
+    level.width = (cellsX + c_pyramidLeafSize - 1) / c_pyramidLeafSize;
+    level.height = (cellsY + c_pyramidLeafSize - 1) / c_pyramidLeafSize;
+    level.ranges.resize(2 * static_cast<size_t>(level.width) * level.height);
+    levels.push_back(level);
+    while (level.width > 1 || level.height > 1)
+    {
+        level.width = (level.width + 1) / 2;
+        level.height = (level.height + 1) / 2;
+        level.ranges.resize(2 * static_cast<size_t>(level.width) * level.height);
+        levels.push_back(level);
+    }
+    updateBlocks(0, 0, levels[0].width - 1, levels[0].height - 1);
+}
+
+void HeightPyramid::updateRegion(const DirtyRect& rect)
+{
+    // Cell x has the samples x and x + 1
+    int minX = std::max(rect.minX - 1, 0) / c_pyramidLeafSize;
+    int minY = std::max(rect.minY - 1, 0) / c_pyramidLeafSize;
+    int maxX = std::min(rect.maxX / c_pyramidLeafSize, levels[0].width - 1);
+    int maxY = std::min(rect.maxY / c_pyramidLeafSize, levels[0].height - 1);
+    if (minX <= maxX && minY <= maxY)
+    {
+        updateBlocks(minX, minY, maxX, maxY);
+    }
+}
+
+bool HeightPyramid::intersectRay(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, float& distance) const
+{
+    // Scaling the origin and direction alike keeps the distances, so the
+    // descent works in samples
+    glm::vec3 o(origin.x / c_worldScale, origin.y, origin.z / c_worldScale);
+    glm::vec3 d(direction.x / c_worldScale, direction.y, direction.z / c_worldScale);
+    glm::vec3 inverse;
+    for (int i = 0; i < 3; ++i)
+    {
+        float component = std::abs(d[i]) < 1e-20f ? std::copysign(1e-20f, d[i]) : d[i];
+        inverse[i] = 1.0f / component;
+    }
+
+    // Children are pushed so that the one nearest to the ray origin is popped first
+    int nearX = d.x >= 0.0f ? 0 : 1;
+    int nearZ = d.z >= 0.0f ? 0 : 1;
+    const int childOrder[4][2] = {{1 - nearX, 1 - nearZ}, {nearX, 1 - nearZ}, {1 - nearX, nearZ}, {nearX, nearZ}};
+
+    Node stack[4 * 32];
+    int stackSize = 0;
+    stack[stackSize++] = {static_cast<int>(levels.size()) - 1, 0, 0};
+    while (stackSize > 0)
+    {
+        Node node = stack[--stackSize];
+        const Level& level = levels[node.level];
+        size_t index = static_cast<size_t>(node.z) * level.width + node.x;
+        int size = c_pyramidLeafSize << node.level;
+        glm::vec3 min(static_cast<float>(node.x * size), getRangeMin(level.ranges, index), static_cast<float>(node.z * size));
+        glm::vec3 max(static_cast<float>(std::min((node.x + 1) * size, cellsX)), getRangeMax(level.ranges, index),
+                      static_cast<float>(std::min((node.z + 1) * size, cellsY)));
+        if (!intersectBox(o, inverse, min, max, maxDistance))
+        {
+            continue;
+        }
+        if (node.level == 0)
+        {
+            if (intersectLeaf(node.x, node.z, o, d, inverse, maxDistance, distance))
+            {
+                return true;
+            }
+            continue;
+        }
+
+        const Level& below = levels[node.level - 1];
+        for (const int* child : childOrder)
+        {
+            int x = 2 * node.x + child[0];
+            int z = 2 * node.z + child[1];
+            if (x < below.width && z < below.height)
+            {
+                stack[stackSize++] = {node.level - 1, x, z};
+            }
+        }
+    }
+    return false;
+}
+
+void HeightPyramid::intersectRays(const std::vector<glm::vec3>& origins, const std::vector<glm::vec3>& directions, float maxDistance,
+                                  std::vector<float>& distances, int threadCount) const
+{
+    TRACE_SCOPE("intersectRays");
+    int count = static_cast<int>(origins.size());
+    distances.resize(count);
+    int batchCount = (count + c_rayBatchSize - 1) / c_rayBatchSize;
+    parallelFor(batchCount, threadCount, [&](int batch) {
+        int last = std::min(count, (batch + 1) * c_rayBatchSize);
+        for (int i = batch * c_rayBatchSize; i < last; ++i)
+        {
+            float distance = 0.0f;
+            distances[i] = intersectRay(origins[i], directions[i], maxDistance, distance) ? distance : -1.0f;
+        }
+    });
+}
+
+float HeightPyramid::getSurfaceHeight(float x, float z) const
+{
+    float sampleX = std::min(std::max(x / c_worldScale, 0.0f), static_cast<float>(cellsX));
+    float sampleY = std::min(std::max(z / c_worldScale, 0.0f), static_cast<float>(cellsY));
+    int cellX = std::min(static_cast<int>(sampleX), cellsX - 1);
+    int cellY = std::min(static_cast<int>(sampleY), cellsY - 1);
+    float u = sampleX - static_cast<float>(cellX);
+    float v = sampleY - static_cast<float>(cellY);
+
+    // The triangles of a cell share the diagonal from top right to bottom left
+    float topLeft = world.at(cellX, cellY);
+    float topRight = world.at(cellX + 1, cellY);
+    float bottomLeft = world.at(cellX, cellY + 1);
+    float bottomRight = world.at(cellX + 1, cellY + 1);
+    if (u + v <= 1.0f)
+    {
+        return topLeft + u * (topRight - topLeft) + v * (bottomLeft - topLeft);
+    }
+    return bottomRight + (1.0f - u) * (bottomLeft - bottomRight) + (1.0f - v) * (topRight - bottomRight);
+}
+
+bool HeightPyramid::contains(float x, float z) const
+{
+    return x >= 0.0f && z >= 0.0f && x <= cellsX * c_worldScale && z <= cellsY * c_worldScale;
+}
+
+int HeightPyramid::getLevelCount() const
+{
+    return static_cast<int>(levels.size());
+}
+
+size_t HeightPyramid::getMemoryUsage() const
+{
+    size_t bytes = 0;
+    for (const Level& level : levels)
+    {
+        bytes += level.ranges.capacity() * sizeof(float);
+    }
+    return bytes;
+}
+
+bool HeightPyramid::intersectCell(const Heightfield& world, int cellX, int cellY, const glm::vec3& origin, const glm::vec3& direction, float& distance)
+{
+    // The triangles of generateMesh in samples
+    float x = static_cast<float>(cellX);
+    float z = static_cast<float>(cellY);
+    glm::vec3 topLeft(x, world.at(cellX, cellY), z);
+    glm::vec3 topRight(x + 1.0f, world.at(cellX + 1, cellY), z);
+    glm::vec3 bottomLeft(x, world.at(cellX, cellY + 1), z + 1.0f);
+    glm::vec3 bottomRight(x + 1.0f, world.at(cellX + 1, cellY + 1), z + 1.0f);
+
+    float first = 0.0f;
+    float second = 0.0f;
+    bool hitFirst = intersectTriangle(origin, direction, topLeft, topRight, bottomLeft, first);
+    bool hitSecond = intersectTriangle(origin, direction, topRight, bottomRight, bottomLeft, second);
+    if (hitFirst && hitSecond)
+    {
+        distance = std::min(first, second);
+    }
+    else if (hitFirst || hitSecond)
+    {
+        distance = hitFirst ? first : second;
+    }
+    return hitFirst || hitSecond;
+}
+
+bool HeightPyramid::intersectLeaf(int blockX, int blockY, const glm::vec3& origin, const glm::vec3& direction, const glm::vec3& inverse,
+                                  float maxDistance, float& distance) const
+{
+    int startX = blockX * c_pyramidLeafSize;
+    int startY = blockY * c_pyramidLeafSize;
+    int endX = std::min(startX + c_pyramidLeafSize, cellsX);
+    int endY = std::min(startY + c_pyramidLeafSize, cellsY);
+    bool found = false;
+    for (int y = startY; y < endY; ++y)
+    {
+        for (int x = startX; x < endX; ++x)
+        {
+            float a = world.at(x, y);
+            float b = world.at(x + 1, y);
+            float c = world.at(x, y + 1);
+            float d = world.at(x + 1, y + 1);
+            glm::vec3 min(static_cast<float>(x), std::min(std::min(a, b), std::min(c, d)), static_cast<float>(y));
+            glm::vec3 max(static_cast<float>(x + 1), std::max(std::max(a, b), std::max(c, d)), static_cast<float>(y + 1));
+            float hit = 0.0f;
+            if (intersectBox(origin, inverse, min, max, maxDistance) && intersectCell(world, x, y, origin, direction, hit) && hit <= maxDistance)
+            {
+                // Any cell of the block may be nearest
+                maxDistance = hit;
+                distance = hit;
+                found = true;
+            }
+        }
+    }
+    return found;
+}
+
+void HeightPyramid::updateBlocks(int minX, int minY, int maxX, int maxY)
+{
+    std::vector<float>& blocks = levels[0].ranges;
+    for (int blockY = minY; blockY <= maxY; ++blockY)
+    {
+        for (int blockX = minX; blockX <= maxX; ++blockX)
+        {
+            // Samples of the cells of the block
+            int startX = blockX * c_pyramidLeafSize;
+            int startY = blockY * c_pyramidLeafSize;
+            int endX = std::min(startX + c_pyramidLeafSize, cellsX);
+            int endY = std::min(startY + c_pyramidLeafSize, cellsY);
+            float low = world.at(startX, startY);
+            float high = low;
+            for (int y = startY; y <= endY; ++y)
+            {
+                for (int x = startX; x <= endX; ++x)
+                {
+                    low = std::min(low, world.at(x, y));
+                    high = std::max(high, world.at(x, y));
+                }
+            }
+            size_t block = static_cast<size_t>(blockY) * levels[0].width + blockX;
+            blocks[2 * block] = low;
+            blocks[2 * block + 1] = high;
+        }
+    }
+    for (size_t i = 1; i < levels.size(); ++i)
+    {
+        minX /= 2;
+        minY /= 2;
+        maxX /= 2;
+        maxY /= 2;
+        const Level& below = levels[i - 1];
+        Level& level = levels[i];
+        for (int y = minY; y <= maxY; ++y)
+        {
+            for (int x = minX; x <= maxX; ++x)
+            {
+                float low = getRangeMin(below.ranges, static_cast<size_t>(2 * y) * below.width + 2 * x);
+                float high = getRangeMax(below.ranges, static_cast<size_t>(2 * y) * below.width + 2 * x);
+                for (int child = 1; child < 4; ++child)
+                {
+                    int childX = 2 * x + (child & 1);
+                    int childY = 2 * y + (child >> 1);
+                    if (childX < below.width && childY < below.height)
+                    {
+                        size_t node = static_cast<size_t>(childY) * below.width + childX;
+                        low = std::min(low, getRangeMin(below.ranges, node));
+                        high = std::max(high, getRangeMax(below.ranges, node));
+                    }
+                }
+                size_t node = static_cast<size_t>(y) * level.width + x;
+                level.ranges[2 * node] = low;
+                level.ranges[2 * node + 1] = high;
+            }
+        }
+    }
+}
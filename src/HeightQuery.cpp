@@ -0,0 +1,209 @@
+#include "HeightQuery.h"
+#include "stamp.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cmath>
+
+HeightQuery::HeightQuery(unsigned int seed, const WorldParams& params, int cellSize) :
+    params(params),
+    cellSize(cellSize)
+{
+    TRACE_SCOPE("buildHeightQuery");
+    cellCountX = std::max(1, (params.width + cellSize - 1) / cellSize);
+    cellCountY = std::max(1, (params.height + cellSize - 1) / cellSize);
+    cells.resize(cellCountX * cellCountY);
+
+    std::vector<Bump> bumps;
+    for (int i = 0; i < params.numMountains; ++i)
+    {
+        createMountainBumps(params, seed, i, bumps);
+    }
+    features.reserve(bumps.size());
+    for (const Bump& bump : bumps)
+    {
+        addFeature(bump);
+    }
+
+    // Rivers as in createRivers, each pit reads the heights carved before it
+    std::vector<RiverPoint> pits;
+    if (params.numRivers > 0)
+    {
+        int startHeight = params.riverEndPointMargin;
+        int endHeight = params.height - params.riverEndPointMargin;
+        for (int x = 0; x <= params.width; x += params.riverPitDensity)
+        {
+            int y = getPitPosition(params.width + 1, startHeight, endHeight, x, params);
+            pits.push_back({static_cast<float>(x), static_cast<float>(y)});
+        }
+        carveRiver(pits);
+    }
+    std::vector<RiverPoint> controlPoints;
+    for (int i = 1; i < params.numRivers; ++i)
+    {
+        createRiverPath(params, seed, i, controlPoints);
+        getRiverPits(controlPoints, static_cast<float>(params.riverPitDensity), pits);
+        carveRiver(pits);
+    }
+}
+
+float HeightQuery::heightAt(float x, float y) const
+{
+    const std::vector<uint32_t>& cell = cells[getCellIndex(x, y)];
+    float height = 0.0f;
+    for (uint32_t index : cell)
+    {
+        const Feature& f = features[index];
+        addBumpPointsScalar(&x, &y, &height, 1, f.x, f.y, f.limit, f.scale, f.falloff);
+    }
+    return height;
+}
+
+float HeightQuery::gradientAt(float x, float y, float& dhdx, float& dhdy) const
+{
+    const std::vector<uint32_t>& cell = cells[getCellIndex(x, y)];
+    float height = 0.0f;
+    dhdx = 0.0f;
+    dhdy = 0.0f;
+    for (uint32_t index : cell)
+    {
+        // d/dx of scale * exp(-(dx^2 + dy^2) * falloff) is -2 * falloff * dx times the value,
+        // zero outside the window
+        const Feature& f = features[index];
+        float value = 0.0f;
+        addBumpPointsScalar(&x, &y, &value, 1, f.x, f.y, f.limit, f.scale, f.falloff);
+        height += value;
+        dhdx -= 2.0f * f.falloff * (x - f.x) * value;
+        dhdy -= 2.0f * f.falloff * (y - f.y) * value;
+    }
+    return height;
+}
+
+void HeightQuery::getHeights(const float* x, const float* y, int count, float* heights, Scratch& scratch) const
+{
+    AddBumpPointsFunction addBumpPoints = getAddBumpPointsFunction(getStampKernel());
+
+    scratch.keys.resize(count);
+    for (int i = 0; i < count; ++i)
+    {
+        float px = x[i];
+        float py = y[i];
+        scratch.keys[i] = (static_cast<uint64_t>(getCellIndex(px, py)) << 32) | static_cast<uint32_t>(i);
+    }
+    std::sort(scratch.keys.begin(), scratch.keys.end());
+
+    // Points of one cell are gathered into contiguous arrays and every
+    // feature of the cell is added to all of them with one kernel call
+    int first = 0;
+    while (first < count)
+    {
+        uint32_t cellIndex = static_cast<uint32_t>(scratch.keys[first] >> 32);
+        int last = first + 1;
+        while (last < count && static_cast<uint32_t>(scratch.keys[last] >> 32) == cellIndex)
+        {
+            ++last;
+        }
+        int runLength = last - first;
+
+        scratch.x.resize(runLength);
+        scratch.y.resize(runLength);
+        scratch.heights.assign(runLength, 0.0f);
+        for (int i = 0; i < runLength; ++i)
+        {
+            uint32_t point = static_cast<uint32_t>(scratch.keys[first + i]);
+            float px = x[point];
+            float py = y[point];
+            getCellIndex(px, py);
+            scratch.x[i] = px;
+            scratch.y[i] = py;
+        }
+        for (uint32_t index : cells[cellIndex])
+        {
+            const Feature& f = features[index];
+            addBumpPoints(scratch.x.data(), scratch.y.data(), scratch.heights.data(), runLength, f.x, f.y, f.limit, f.scale, f.falloff);
+        }
+        for (int i = 0; i < runLength; ++i)
+        {
+            heights[static_cast<uint32_t>(scratch.keys[first + i])] = scratch.heights[i];
+        }
+        first = last;
+    }
+}
+
+size_t HeightQuery::getFeatureCount() const
+{
+    return features.size();
+}
+
+size_t HeightQuery::getMemoryUsage() const
+{
+    size_t bytes = features.capacity() * sizeof(Feature) + cells.capacity() * sizeof(std::vector<uint32_t>);
+    for (const std::vector<uint32_t>& cell : cells)
+    {
+        bytes += cell.capacity() * sizeof(uint32_t);
+    }
+    return bytes;
+}
+
+void HeightQuery::addFeature(const Bump& bump)
+{
+    // The window and scale of stampBump
+    int limit = static_cast<int>(bump.deviation * c_standardDeviationArea);
+    float variance = bump.deviation * bump.deviation;
+    Feature feature;
+    feature.x = static_cast<float>(bump.x);
+    feature.y = static_cast<float>(bump.y);
+    feature.limit = static_cast<float>(limit);
+    feature.scale = bump.multiplier / (bump.deviation * std::sqrt(2.0f * pi * variance));
+    feature.falloff = 1.0f / (2.0f * bump.deviation * bump.deviation);
+
+    // Cell c covers [c * cellSize, (c + 1) * cellSize], the last one up to the world edge
+    if (bump.x + limit < 0 || bump.y + limit < 0 || bump.x - limit > params.width || bump.y - limit > params.height)
+    {
+        return;
+    }
+    int minCellX = std::max(0, bump.x - limit) / cellSize;
+    int maxCellX = std::min(std::min(params.width, bump.x + limit) / cellSize, cellCountX - 1);
+    int minCellY = std::max(0, bump.y - limit) / cellSize;
+    int maxCellY = std::min(std::min(params.height, bump.y + limit) / cellSize, cellCountY - 1);
+
+    uint32_t index = static_cast<uint32_t>(features.size());
+    features.push_back(feature);
+    for (int cellY = minCellY; cellY <= maxCellY; ++cellY)
+    {
+        for (int cellX = minCellX; cellX <= maxCellX; ++cellX)
+        {
+            cells[cellY * cellCountX + cellX].push_back(index);
+        }
+    }
+}
+
+void HeightQuery::carveRiver(const std::vector<RiverPoint>& pits)
+{
+    // Same bumps as carveRiver of world.cpp
+    float gain = getBumpCenterGain(params.riverDeviation);
+    for (const RiverPoint& pit : pits)
+    {
+        int x = static_cast<int>(std::lround(pit.x));
+        int y = static_cast<int>(std::lround(pit.y));
+        if (x < 0 || y < 0 || x > params.width || y > params.height)
+        {
+            continue;
+        }
+        float excess = heightAt(static_cast<float>(x), static_cast<float>(y)) + params.riverDepth;
+        if (excess > 0.0f)
+        {
+            Bump bump = {x, y, -excess / gain, params.riverDeviation};
+            addFeature(bump);
+        }
+    }
+}
+
+int HeightQuery::getCellIndex(float& x, float& y) const
+{
+    x = std::min(std::max(x, 0.0f), static_cast<float>(params.width));
+    y = std::min(std::max(y, 0.0f), static_cast<float>(params.height));
+    int cellX = std::min(static_cast<int>(x) / cellSize, cellCountX - 1);
+    int cellY = std::min(static_cast<int>(y) / cellSize, cellCountY - 1);
+    return cellY * cellCountX + cellX;
+}
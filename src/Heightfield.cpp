@@ -0,0 +1,227 @@
+#include "Heightfield.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+#include <utility>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+namespace
+{
+int roundUp(int value, int multiple)
+{
+    return (value + multiple - 1) / multiple * multiple;
+}
+
+float* allocateSamples(size_t count)
+{
+    size_t bytes = std::max<size_t>(count * sizeof(float), Heightfield::c_alignment);
+#ifdef _WIN32
+    void* memory = _aligned_malloc(bytes, Heightfield::c_alignment);
+#else
+    void* memory = nullptr;
+    if (posix_memalign(&memory, Heightfield::c_alignment, bytes) != 0)
+    {
+        memory = nullptr;
+    }
+#endif
+    if (memory == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return static_cast<float*>(memory);
+}
+
+void freeSamples(float* samples)
+{
+#ifdef _WIN32
+    _aligned_free(samples);
+#else
+    std::free(samples);
+#endif
+}
+} // namespace
+
+Heightfield::Heightfield(int width, int height, Layout layout)
+{
+    resize(width, height, layout);
+}
+
+Heightfield::Heightfield(const Heightfield& other)
+{
+    *this = other;
+}
+
+Heightfield::Heightfield(Heightfield&& other) noexcept
+{
+    *this = std::move(other);
+}
+
+Heightfield::~Heightfield()
+{
+    release();
+}
+
+Heightfield& Heightfield::operator=(const Heightfield& other)
+{
+    if (this != &other)
+    {
+        resize(other.width, other.height, other.layout);
+        std::copy(other.samples, other.samples + other.getSize(), samples);
+        dirtyRects = other.dirtyRects;
+    }
+    return *this;
+}
+
+Heightfield& Heightfield::operator=(Heightfield&& other) noexcept
+{
+    if (this != &other)
+    {
+        release();
+        width = other.width;
+        height = other.height;
+        stride = other.stride;
+        paddedHeight = other.paddedHeight;
+        layout = other.layout;
+        samples = other.samples;
+        dirtyRects = std::move(other.dirtyRects);
+        other.dirtyRects.clear();
+        other.width = 0;
+        other.height = 0;
+        other.stride = 0;
+        other.paddedHeight = 0;
+        other.samples = nullptr;
+    }
+    return *this;
+}
+
+void Heightfield::resize(int newWidth, int newHeight, Layout newLayout)
+{
+    int floatsPerLine = c_alignment / static_cast<int>(sizeof(float));
+    int newStride = newLayout == Layout::Tiled ? roundUp(newWidth, c_tileSize) : roundUp(newWidth, floatsPerLine);
+    int newPaddedHeight = newLayout == Layout::Tiled ? roundUp(newHeight, c_tileSize) : newHeight;
+    size_t newSize = static_cast<size_t>(newStride) * newPaddedHeight;
+
+    if (samples == nullptr || newSize != getSize())
+    {
+        release();
+        samples = allocateSamples(newSize);
+    }
+    width = newWidth;
+    height = newHeight;
+    stride = newStride;
+    paddedHeight = newPaddedHeight;
+    layout = newLayout;
+    fill(0.0f);
+}
+
+void Heightfield::fill(float value)
+{
+    std::fill(samples, samples + getSize(), value);
+    markAllDirty();
+}
+
+int Heightfield::getWidth() const
+{
+    return width;
+}
+
+int Heightfield::getHeight() const
+{
+    return height;
+}
+
+int Heightfield::getStride() const
+{
+    return stride;
+}
+
+Heightfield::Layout Heightfield::getLayout() const
+{
+    return layout;
+}
+
+size_t Heightfield::getSize() const
+{
+    return static_cast<size_t>(stride) * paddedHeight;
+}
+
+float* Heightfield::data()
+{
+    return samples;
+}
+
+const float* Heightfield::data() const
+{
+    return samples;
+}
+
+void Heightfield::markDirty(int minX, int minY, int maxX, int maxY)
+{
+    DirtyRect rect = {std::max(minX, 0), std::max(minY, 0), std::min(maxX, width - 1), std::min(maxY, height - 1)};
+    if (rect.minX > rect.maxX || rect.minY > rect.maxY)
+    {
+        return;
+    }
+
+    // Absorb every rectangle the new one overlaps or touches, growing it
+    // until no more are absorbed
+    bool merged = true;
+    while (merged)
+    {
+        merged = false;
+        for (size_t i = 0; i < dirtyRects.size(); ++i)
+        {
+            const DirtyRect& other = dirtyRects[i];
+            if (other.minX <= rect.maxX + 1 && rect.minX <= other.maxX + 1 && other.minY <= rect.maxY + 1 && rect.minY <= other.maxY + 1)
+            {
+                rect = {std::min(rect.minX, other.minX), std::min(rect.minY, other.minY), std::max(rect.maxX, other.maxX), std::max(rect.maxY, other.maxY)};
+                dirtyRects[i] = dirtyRects.back();
+                dirtyRects.pop_back();
+                merged = true;
+                break;
+            }
+        }
+    }
+
+    if (static_cast<int>(dirtyRects.size()) >= c_maxDirtyRects)
+    {
+        for (const DirtyRect& other : dirtyRects)
+        {
+            rect = {std::min(rect.minX, other.minX), std::min(rect.minY, other.minY), std::max(rect.maxX, other.maxX), std::max(rect.maxY, other.maxY)};
+        }
+        dirtyRects.clear();
+    }
+    dirtyRects.push_back(rect);
+}
+
+void Heightfield::markAllDirty()
+{
+    dirtyRects.clear();
+    if (width > 0 && height > 0)
+    {
+        dirtyRects.push_back({0, 0, width - 1, height - 1});
+    }
+}
+
+const std::vector<DirtyRect>& Heightfield::getDirtyRects() const
+{
+    return dirtyRects;
+}
+
+void Heightfield::clearDirty()
+{
+    dirtyRects.clear();
+}
+
+void Heightfield::release()
+{
+    if (samples != nullptr)
+    {
+        freeSamples(samples);
+        samples = nullptr;
+    }
+}
@@ -0,0 +1,181 @@
+#include "Rtin.h"
+#include "trace.h"
+#include "constants.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+Rtin::Rtin(const Heightfield& world) :
+    world(world),
+    cellsX(world.getWidth() - 1),
+    cellsY(world.getHeight() - 1),
+    gridSize(1)
+{
+    TRACE_SCOPE("buildRtin");
+    while (gridSize < cellsX || gridSize < cellsY)
+    {
+        gridSize *= 2;
+    }
+    errors.assign(static_cast<size_t>(gridSize + 1) * (gridSize + 1), 0.0f);
+    computeErrors();
+}
+
+void Rtin::generateMesh(float maxError, IndexedMesh& mesh) const
+{
+    TRACE_SCOPE("generateRtinMesh");
+    mesh.vertices.clear();
+    mesh.indices16.clear();
+    mesh.indices32.clear();
+    mesh.chunks.clear();
+
+    // Indices are collected as 32-bit and narrowed when the vertices fit
+    std::vector<uint32_t> vertexMap(world.getSize(), UINT32_MAX);
+    addTriangles(0, 0, gridSize, gridSize, gridSize, 0, maxError, vertexMap, mesh);
+    addTriangles(gridSize, gridSize, 0, 0, 0, gridSize, maxError, vertexMap, mesh);
+
+    mesh.wideIndices = mesh.getVertexCount() > UINT16_MAX + 1u;
+    if (!mesh.wideIndices)
+    {
+        mesh.indices16.assign(mesh.indices32.begin(), mesh.indices32.end());
+        mesh.indices32.clear();
+        mesh.indices32.shrink_to_fit();
+    }
+    MeshChunk chunk;
+    chunk.baseVertex = 0;
+    chunk.firstIndex = 0;
+    chunk.indexCount = static_cast<int>(mesh.getIndexCount());
+    mesh.chunks.push_back(chunk);
+}
+
+int Rtin::getGridSize() const
+{
+    return gridSize;
+}
+
+size_t Rtin::getMemoryUsage() const
+{
+    return errors.capacity() * sizeof(float);
+}
+
+void Rtin::computeErrors()
+{
+    // Levels from the shortest hypotenuse up, so that the bounds of the
+    // children are final before their parents read them. Level h first has
+    // the axis aligned hypotenuses of length 2h, which are the edges of
+    // squares of 2h cells, and then the diagonals of those squares.
+    size_t stride = static_cast<size_t>(gridSize) + 1;
+    for (int h = 1; h <= gridSize / 2; h *= 2)
+    {
+        for (int y = 0; y <= gridSize; y += h)
+        {
+            // Horizontal hypotenuses on even rows of the level, vertical ones on odd rows
+            bool horizontal = (y / h) % 2 == 0;
+            for (int x = horizontal ? h : 0; x <= gridSize; x += 2 * h)
+            {
+                float& error = errors[y * stride + x];
+                if (horizontal)
+                {
+                    error = std::max(getTriangleError(x - h, y, x + h, y, x, y - h), getTriangleError(x + h, y, x - h, y, x, y + h));
+                }
+                else
+                {
+                    error = std::max(getTriangleError(x, y + h, x, y - h, x - h, y), getTriangleError(x, y - h, x, y + h, x + h, y));
+                }
+            }
+        }
+
+        // Squares of 2h cells alternate their diagonal so that it points at the center of the parent square
+        for (int y = h; y < gridSize; y += 2 * h)
+        {
+            for (int x = h; x < gridSize; x += 2 * h)
+            {
+                bool mainDiagonal = ((x / (2 * h)) + (y / (2 * h))) % 2 == 0;
+                float& error = errors[y * stride + x];
+                if (mainDiagonal)
+                {
+                    error = std::max(getTriangleError(x - h, y - h, x + h, y + h, x + h, y - h), getTriangleError(x + h, y + h, x - h, y - h, x - h, y + h));
+                }
+                else
+                {
+                    error = std::max(getTriangleError(x + h, y - h, x - h, y + h, x + h, y + h), getTriangleError(x - h, y + h, x + h, y - h, x - h, y - h));
+                }
+            }
+        }
+    }
+}
+
+float Rtin::getTriangleError(int ax, int ay, int bx, int by, int cx, int cy) const
+{
+    if (cx < 0 || cy < 0 || cx > gridSize || cy > gridSize)
+    {
+        return 0.0f;
+    }
+    int minX = std::min(std::min(ax, bx), cx);
+    int minY = std::min(std::min(ay, by), cy);
+    int maxX = std::max(std::max(ax, bx), cx);
+    int maxY = std::max(std::max(ay, by), cy);
+    if (minX >= cellsX || minY >= cellsY)
+    {
+        return 0.0f;
+    }
+    if (maxX > cellsX || maxY > cellsY)
+    {
+        return std::numeric_limits<float>::infinity();
+    }
+
+    // The split replaces the hypotenuse by the midpoint, the children are
+    // (c, a, m) and (b, c, m)
+    int mx = (ax + bx) / 2;
+    int my = (ay + by) / 2;
+    float error = std::abs(0.5f * (world.at(ax, ay) + world.at(bx, by)) - world.at(mx, my));
+    // Children of the shortest axis aligned hypotenuses are single cell halves
+    if ((ax + cx) % 2 == 0 && (ay + cy) % 2 == 0)
+    {
+        size_t stride = static_cast<size_t>(gridSize) + 1;
+        float left = errors[((ay + cy) / 2) * stride + (ax + cx) / 2];
+        float right = errors[((by + cy) / 2) * stride + (bx + cx) / 2];
+        error += std::max(left, right);
+    }
+    return error;
+}
+
+void Rtin::addTriangles(int ax, int ay, int bx, int by, int cx, int cy, float maxError, std::vector<uint32_t>& vertexMap, IndexedMesh& mesh) const
+{
+    if (std::min(std::min(ax, bx), cx) >= cellsX || std::min(std::min(ay, by), cy) >= cellsY)
+    {
+        return;
+    }
+    int mx = (ax + bx) / 2;
+    int my = (ay + by) / 2;
+    size_t stride = static_cast<size_t>(gridSize) + 1;
+    if (std::abs(ax - cx) + std::abs(ay - cy) > 1 && errors[my * stride + mx] > maxError)
+    {
+        addTriangles(cx, cy, ax, ay, mx, my, maxError, vertexMap, mesh);
+        addTriangles(bx, by, cx, cy, mx, my, maxError, vertexMap, mesh);
+        return;
+    }
+
+    // Same winding as the triangles of generateIndexedMesh
+    int corners[3][2] = {{ax, ay}, {bx, by}, {cx, cy}};
+    if ((bx - ax) * (cy - ay) - (by - ay) * (cx - ax) < 0)
+    {
+        std::swap(corners[1], corners[2]);
+    }
+    for (const int* corner : corners)
+    {
+        uint32_t& vertex = vertexMap[static_cast<size_t>(corner[1]) * world.getWidth() + corner[0]];
+        if (vertex == UINT32_MAX)
+        {
+            vertex = static_cast<uint32_t>(mesh.getVertexCount());
+            float v[6];
+            v[0] = static_cast<float>(corner[0]) * c_worldScale;
+            v[1] = world.at(corner[0], corner[1]);
+            v[2] = static_cast<float>(corner[1]) * c_worldScale;
+            getSampleNormal(world, corner[0], corner[1], v + 3);
+            mesh.vertices.insert(mesh.vertices.end(), v, v + 6);
+        }
+        mesh.indices32.push_back(vertex);
+    }
+}
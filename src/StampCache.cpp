@@ -0,0 +1,82 @@
+#include "StampCache.h"
+#include "stamp.h"
+#include "constants.h"
+
+#include <algorithm>
+#include <cmath>
+
+StampCache::StampCache(float minDeviation, float maxDeviation, float step) :
+    minDeviation(minDeviation),
+    maxDeviation(maxDeviation),
+    step(step)
+{
+    int count = static_cast<int>(std::ceil((maxDeviation - minDeviation) / step)) + 1;
+    centers.resize(count);
+    radiuses.resize(count);
+
+    for (int i = 0; i < count; ++i)
+    {
+        float deviation = minDeviation + static_cast<float>(i) * step;
+        int radius = static_cast<int>(deviation * c_standardDeviationArea) + 1;
+        centers[i] = profiles.size() + radius;
+        radiuses[i] = radius;
+
+        // Unit height: evaluate exp(-d^2 * falloff) with the stamping kernel on a zeroed row
+        size_t first = profiles.size();
+        profiles.resize(first + 2 * radius + 1, 0.0f);
+        float falloff = 1.0f / (2.0f * deviation * deviation);
+        stampRowScalar(&profiles[first], 2 * radius + 1, static_cast<float>(-radius), 0.0f, 1.0f, falloff);
+    }
+}
+
+bool StampCache::contains(float deviation) const
+{
+    return deviation >= minDeviation && deviation <= maxDeviation;
+}
+
+float StampCache::quantize(float deviation) const
+{
+    return minDeviation + static_cast<float>(getProfileIndex(deviation)) * step;
+}
+
+const float* StampCache::getProfile(float deviation, int& radius) const
+{
+    int index = getProfileIndex(deviation);
+    radius = radiuses[index];
+    return &profiles[centers[index]];
+}
+
+int StampCache::getProfileCount() const
+{
+    return static_cast<int>(centers.size());
+}
+
+size_t StampCache::getMemoryUsage() const
+{
+    return profiles.size() * sizeof(float) + centers.size() * sizeof(size_t) + radiuses.size() * sizeof(int);
+}
+
+size_t StampCache::getTileMemoryUsage() const
+{
+    size_t samples = 0;
+    for (int radius : radiuses)
+    {
+        size_t side = 2 * radius + 1;
+        samples += side * side;
+    }
+    return samples * sizeof(float);
+}
+
+int StampCache::getProfileIndex(float deviation) const
+{
+    int index = static_cast<int>(std::floor((deviation - minDeviation) / step + 0.5f));
+    return std::min(std::max(index, 0), static_cast<int>(centers.size()) - 1);
+}
+
+const StampCache& getStampCache()
+{
+    static const StampCache cache(std::min(c_minBumpDeviation, c_riverDeviation),
+                                  std::max(c_maxBumpDeviation, c_riverDeviation),
+                                  c_stampDeviationStep);
+    return cache;
+}
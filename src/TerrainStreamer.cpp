@@ -0,0 +1,225 @@
+#include "TerrainStreamer.h"
+#include "world.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace
+{
+double getTime()
+{
+    typedef std::chrono::steady_clock Clock;
+    return std::chrono::duration<double>(Clock::now().time_since_epoch()).count();
+}
+
+int getChunkDistance(int x, int z, int centerX, int centerZ)
+{
+    return std::max(std::abs(x - centerX), std::abs(z - centerZ));
+}
+} // namespace
+
+TerrainStreamer::TerrainStreamer(unsigned int seed, int workerCount, int radius, int capacity, const WorldParams& params) :
+    seed(seed),
+    params(params),
+    radius(radius),
+    capacity(static_cast<size_t>(std::max(capacity, (2 * radius + 1) * (2 * radius + 1))))
+{
+    for (int i = 0; i < std::max(workerCount, 1); ++i)
+    {
+        workers.emplace_back(&TerrainStreamer::workerLoop, this);
+    }
+}
+
+TerrainStreamer::~TerrainStreamer()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    condition.notify_all();
+    for (std::thread& worker : workers)
+    {
+        worker.join();
+    }
+}
+
+void TerrainStreamer::update(float x, float z, std::vector<std::shared_ptr<const TerrainChunk>>& ready, std::vector<int64_t>& evicted)
+{
+    ++frame;
+    float chunkWorldSize = static_cast<float>(c_chunkSize) * c_worldScale;
+    int newCenterX = static_cast<int>(std::floor(x / chunkWorldSize));
+    int newCenterZ = static_cast<int>(std::floor(z / chunkWorldSize));
+
+    std::vector<std::shared_ptr<const TerrainChunk>> newChunks;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        centerX = newCenterX;
+        centerZ = newCenterZ;
+        newChunks.swap(finished);
+
+        // Requests that left the radius before a worker picked them up
+        auto outside = [&](const Request& request) {
+            return getChunkDistance(request.x, request.z, centerX, centerZ) > radius;
+        };
+        for (const Request& request : queue)
+        {
+            if (outside(request))
+            {
+                inFlight.erase(getChunkKey(request.x, request.z));
+                ++stats.cancelled;
+            }
+        }
+        queue.erase(std::remove_if(queue.begin(), queue.end(), outside), queue.end());
+
+        double now = getTime();
+        for (int cz = centerZ - radius; cz <= centerZ + radius; ++cz)
+        {
+            for (int cx = centerX - radius; cx <= centerX + radius; ++cx)
+            {
+                int64_t key = getChunkKey(cx, cz);
+                auto found = resident.find(key);
+                if (found != resident.end())
+                {
+                    found->second.lastUsed = frame;
+                    ++stats.cacheHits;
+                }
+                else if (inFlight.find(key) == inFlight.end())
+                {
+                    bool alreadyFinished = false;
+                    for (const std::shared_ptr<const TerrainChunk>& chunk : newChunks)
+                    {
+                        alreadyFinished = alreadyFinished || (chunk->x == cx && chunk->z == cz);
+                    }
+                    if (!alreadyFinished)
+                    {
+                        inFlight[key] = true;
+                        queue.push_back({cx, cz, now});
+                        ++stats.cacheMisses;
+                    }
+                }
+            }
+        }
+    }
+    condition.notify_all();
+
+    size_t firstReady = ready.size();
+    for (const std::shared_ptr<const TerrainChunk>& chunk : newChunks)
+    {
+        resident[getChunkKey(chunk->x, chunk->z)] = {chunk, frame};
+        ready.push_back(chunk);
+    }
+
+    while (resident.size() > capacity)
+    {
+        auto victim = resident.begin();
+        int victimDistance = -1;
+        for (auto it = resident.begin(); it != resident.end(); ++it)
+        {
+            int distance = getChunkDistance(it->second.chunk->x, it->second.chunk->z, newCenterX, newCenterZ);
+            if (distance > victimDistance || (distance == victimDistance && it->second.lastUsed < victim->second.lastUsed))
+            {
+                victim = it;
+                victimDistance = distance;
+            }
+        }
+        // A chunk finished in this call is not handed out at all
+        const TerrainChunk* victimChunk = victim->second.chunk.get();
+        ready.erase(std::remove_if(ready.begin() + firstReady, ready.end(),
+                                   [&](const std::shared_ptr<const TerrainChunk>& chunk) { return chunk.get() == victimChunk; }),
+                    ready.end());
+        evicted.push_back(victim->first);
+        resident.erase(victim);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        ++stats.evicted;
+    }
+}
+
+bool TerrainStreamer::isIdle()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return inFlight.empty() && finished.empty();
+}
+
+size_t TerrainStreamer::getResidentCount() const
+{
+    return resident.size();
+}
+
+StreamingStats TerrainStreamer::getStats()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
+int64_t TerrainStreamer::getChunkKey(int x, int z)
+{
+    return static_cast<int64_t>((static_cast<uint64_t>(static_cast<uint32_t>(x)) << 32) | static_cast<uint32_t>(z));
+}
+
+void TerrainStreamer::generateChunk(unsigned int seed, const WorldParams& params, int x, int z, TerrainChunk& chunk)
+{
+    TRACE_SCOPE("generateChunk");
+    // One sample of apron on every side gives central difference normals on
+    // the chunk borders, matching the neighboring chunks
+    const int apron = 1;
+    Heightfield window(c_chunkSize + 1 + 2 * apron, c_chunkSize + 1 + 2 * apron);
+    generateWindow(window, seed, x * c_chunkSize - apron, z * c_chunkSize - apron, params);
+
+    chunk.x = x;
+    chunk.z = z;
+    chunk.heights.resize(c_chunkSize + 1, c_chunkSize + 1);
+    chunk.minHeight = window.at(apron, apron);
+    chunk.maxHeight = chunk.minHeight;
+    for (int sy = 0; sy <= c_chunkSize; ++sy)
+    {
+        for (int sx = 0; sx <= c_chunkSize; ++sx)
+        {
+            float h = window.at(sx + apron, sy + apron);
+            chunk.heights.at(sx, sy) = h;
+            chunk.minHeight = std::min(chunk.minHeight, h);
+            chunk.maxHeight = std::max(chunk.maxHeight, h);
+        }
+    }
+    generateIndexedMesh(window, chunk.mesh, apron);
+}
+
+void TerrainStreamer::workerLoop()
+{
+    TRACE_THREAD_NAME("streaming worker");
+    while (true)
+    {
+        Request request;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [this]() { return stopping || !queue.empty(); });
+            if (stopping)
+            {
+                return;
+            }
+
+            // Nearest request to the latest position first
+            auto nearest = std::min_element(queue.begin(), queue.end(), [this](const Request& a, const Request& b) {
+                return getChunkDistance(a.x, a.z, centerX, centerZ) < getChunkDistance(b.x, b.z, centerX, centerZ);
+            });
+            request = *nearest;
+            queue.erase(nearest);
+        }
+
+        double start = getTime();
+        std::shared_ptr<TerrainChunk> chunk = std::make_shared<TerrainChunk>();
+        generateChunk(seed, params, request.x, request.z, *chunk);
+        double end = getTime();
+        chunk->latencySeconds = end - request.requestTime;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        inFlight.erase(getChunkKey(request.x, request.z));
+        finished.push_back(chunk);
+        ++stats.generated;
+        stats.totalGenerationSeconds += end - start;
+        stats.totalLatencySeconds += chunk->latencySeconds;
+        stats.maxLatencySeconds = std::max(stats.maxLatencySeconds, chunk->latencySeconds);
+    }
+}
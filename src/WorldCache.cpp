@@ -0,0 +1,401 @@
+#include "WorldCache.h"
+#include "stamp.h"
+#include "constants.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+const char c_magic[8] = {'T', 'E', 'R', 'R', 'A', 'I', 'N', 0};
+// Bump when the generation or the mesh layout changes in a way the constants do not show
+const uint32_t c_formatVersion = 1;
+// Changed whenever generation gives different heights for the same parameters
+const uint32_t c_generationVersion = 3;
+const uint64_t c_sectionAlignment = 64;
+
+uint64_t align(uint64_t offset)
+{
+    return (offset + c_sectionAlignment - 1) / c_sectionAlignment * c_sectionAlignment;
+}
+
+bool isAligned(uint64_t offset)
+{
+    return offset % c_sectionAlignment == 0;
+}
+
+// Whether count elements from offset end within size, without overflowing
+bool sectionFits(uint64_t offset, uint64_t count, uint64_t elementSize, uint64_t size)
+{
+    return offset <= size && count <= (size - offset) / elementSize;
+}
+
+// FNV-1a
+template<typename T>
+void hashValue(uint64_t& hash, const T& value)
+{
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+    for (size_t i = 0; i < sizeof(T); ++i)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+}
+} // namespace
+
+struct WorldCache::Header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint64_t parameterHash;
+    int32_t width;
+    int32_t height;
+    uint64_t heightsOffset;
+    // Mesh sections are empty when the cache has no mesh
+    uint64_t chunkOffset;
+    uint64_t chunkCount;
+    uint64_t vertexOffset;
+    uint64_t vertexFloatCount;
+    uint64_t indexOffset;
+    uint64_t indexCount;
+    uint32_t indexSize;
+    uint32_t hasMesh;
+    uint64_t fileSize;
+};
+
+uint64_t getWorldParameterHash(unsigned int seed, const WorldParams& params)
+{
+    uint64_t hash = 14695981039346656037ull;
+    hashValue(hash, c_formatVersion);
+    hashValue(hash, c_generationVersion);
+    hashValue(hash, seed);
+    hashValue(hash, sizeof(MeshChunk));
+
+    // Cached stamping rounds deviations, the kernels themselves give identical results
+    hashValue(hash, static_cast<int>(getStampMode()));
+    hashValue(hash, c_stampDeviationStep);
+    hashValue(hash, c_standardDeviationArea);
+    hashValue(hash, c_worldScale);
+    hashValue(hash, c_meshStripWidth);
+    // Where the erosion tile phases synchronize changes the eroded heights
+    hashValue(hash, c_erosionBatch);
+
+    // Member by member, the padding of the struct is not initialized
+    hashValue(hash, params.width);
+    hashValue(hash, params.height);
+    hashValue(hash, params.numMountains);
+    hashValue(hash, params.minMountainLength);
+    hashValue(hash, params.maxMountainLength);
+    hashValue(hash, params.mountainEdgeMargin);
+    hashValue(hash, params.minHeightMultiplier);
+    hashValue(hash, params.maxHeightMultiplier);
+    hashValue(hash, params.minBumpDeviation);
+    hashValue(hash, params.maxBumpDeviation);
+    hashValue(hash, params.mountainWaveLength);
+    hashValue(hash, params.bumpDensity);
+    hashValue(hash, params.minParabolaCoefficient);
+    hashValue(hash, params.maxParabolaCoefficient);
+    hashValue(hash, params.minParabolaExponent);
+    hashValue(hash, params.maxParabolaExponent);
+    hashValue(hash, params.numRivers);
+    hashValue(hash, params.riverControlPoints);
+    hashValue(hash, params.riverDepth);
+    hashValue(hash, params.riverDeviation);
+    hashValue(hash, params.riverPitDensity);
+    hashValue(hash, params.riverSlopeSteepness);
+    hashValue(hash, params.riverEndPointMargin);
+    hashValue(hash, params.erosionDroplets);
+    hashValue(hash, params.erosionLifetime);
+    hashValue(hash, params.erosionInertia);
+    hashValue(hash, params.erosionCapacity);
+    hashValue(hash, params.erosionMinCapacity);
+    hashValue(hash, params.erosionErodeSpeed);
+    hashValue(hash, params.erosionDepositSpeed);
+    hashValue(hash, params.erosionEvaporateSpeed);
+    hashValue(hash, params.erosionGravity);
+    hashValue(hash, params.thermalIterations);
+    hashValue(hash, params.thermalTalus);
+    hashValue(hash, params.thermalRate);
+    hashValue(hash, params.smoothIterations);
+    hashValue(hash, params.smoothStrength);
+    return hash;
+}
+
+std::string getWorldCacheFilename(uint64_t parameterHash)
+{
+    char name[64];
+    std::snprintf(name, sizeof(name), "world-%016llx.cache", static_cast<unsigned long long>(parameterHash));
+    return name;
+}
+
+WorldCache::~WorldCache()
+{
+    close();
+}
+
+bool WorldCache::open(const std::string& filename, uint64_t parameterHash)
+{
+    close();
+
+#ifdef _WIN32
+    HANDLE fileHandle = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (fileHandle == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+    LARGE_INTEGER fileSize;
+    HANDLE mappingHandle = NULL;
+    if (GetFileSizeEx(fileHandle, &fileSize) && fileSize.QuadPart >= static_cast<LONGLONG>(sizeof(Header)))
+    {
+        mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+    }
+    if (mappingHandle == NULL)
+    {
+        CloseHandle(fileHandle);
+        return false;
+    }
+    file = fileHandle;
+    mapping = mappingHandle;
+    size = static_cast<size_t>(fileSize.QuadPart);
+    data = static_cast<const uint8_t*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+#else
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+    struct stat status;
+    if (fstat(fd, &status) != 0 || status.st_size < static_cast<off_t>(sizeof(Header)))
+    {
+        ::close(fd);
+        return false;
+    }
+    size = static_cast<size_t>(status.st_size);
+    void* address = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    // The mapping stays valid after closing the descriptor
+    ::close(fd);
+    data = address == MAP_FAILED ? nullptr : static_cast<const uint8_t*>(address);
+#endif
+
+    if (data == nullptr)
+    {
+        close();
+        return false;
+    }
+
+    const Header& header = getHeader();
+    bool valid = std::memcmp(header.magic, c_magic, sizeof(c_magic)) == 0 && header.version == c_formatVersion &&
+                 header.headerSize == sizeof(Header) && header.parameterHash == parameterHash && header.fileSize == size &&
+                 header.width >= 0 && header.height >= 0 && header.heightsOffset >= sizeof(Header) && isAligned(header.heightsOffset) &&
+                 sectionFits(header.heightsOffset, static_cast<uint64_t>(header.width) * header.height, sizeof(float), size);
+    if (valid && header.hasMesh != 0)
+    {
+        // The sections follow each other in this order, so the ends below cannot overflow once each section fits
+        valid = (header.indexSize == sizeof(uint16_t) || header.indexSize == sizeof(uint32_t)) && isAligned(header.chunkOffset) &&
+                isAligned(header.vertexOffset) && isAligned(header.indexOffset) &&
+                header.chunkOffset >= header.heightsOffset + sizeof(float) * static_cast<uint64_t>(header.width) * header.height &&
+                sectionFits(header.chunkOffset, header.chunkCount, sizeof(MeshChunk), size) &&
+                header.vertexOffset >= header.chunkOffset + sizeof(MeshChunk) * header.chunkCount &&
+                sectionFits(header.vertexOffset, header.vertexFloatCount, sizeof(float), size) &&
+                header.indexOffset >= header.vertexOffset + sizeof(float) * header.vertexFloatCount &&
+                sectionFits(header.indexOffset, header.indexCount, header.indexSize, size);
+    }
+    else if (valid)
+    {
+        valid = header.chunkCount == 0 && header.vertexFloatCount == 0 && header.indexCount == 0;
+    }
+    if (!valid)
+    {
+        close();
+    }
+    return valid;
+}
+
+void WorldCache::close()
+{
+#ifdef _WIN32
+    if (data != nullptr)
+    {
+        UnmapViewOfFile(data);
+    }
+    if (mapping != nullptr)
+    {
+        CloseHandle(mapping);
+    }
+    if (file != nullptr)
+    {
+        CloseHandle(file);
+    }
+    file = nullptr;
+    mapping = nullptr;
+#else
+    if (data != nullptr)
+    {
+        munmap(const_cast<uint8_t*>(data), size);
+    }
+#endif
+    data = nullptr;
+    size = 0;
+}
+
+bool WorldCache::isOpen() const
+{
+    return data != nullptr;
+}
+
+int WorldCache::getWidth() const
+{
+    return getHeader().width;
+}
+
+int WorldCache::getHeight() const
+{
+    return getHeader().height;
+}
+
+const float* WorldCache::getHeights() const
+{
+    return reinterpret_cast<const float*>(data + getHeader().heightsOffset);
+}
+
+void WorldCache::copyHeights(Heightfield& world) const
+{
+    int width = getWidth();
+    int height = getHeight();
+    world.resize(width, height);
+    const float* heights = getHeights();
+    for (int y = 0; y < height; ++y)
+    {
+        if (world.getLayout() == Heightfield::Layout::RowMajor)
+        {
+            std::memcpy(world.row(y), heights + static_cast<size_t>(y) * width, sizeof(float) * width);
+            continue;
+        }
+        for (int x = 0; x < width; ++x)
+        {
+            world.at(x, y) = heights[static_cast<size_t>(y) * width + x];
+        }
+    }
+}
+
+bool WorldCache::hasMesh() const
+{
+    return getHeader().hasMesh != 0;
+}
+
+IndexedMeshView WorldCache::getMesh() const
+{
+    const Header& header = getHeader();
+    IndexedMeshView view;
+    view.vertices = reinterpret_cast<const float*>(data + header.vertexOffset);
+    view.vertexFloatCount = static_cast<size_t>(header.vertexFloatCount);
+    view.wideIndices = header.indexSize == sizeof(uint32_t);
+    view.indices = data + header.indexOffset;
+    view.indexCount = static_cast<size_t>(header.indexCount);
+    view.chunks = reinterpret_cast<const MeshChunk*>(data + header.chunkOffset);
+    view.chunkCount = static_cast<size_t>(header.chunkCount);
+    return view;
+}
+
+size_t WorldCache::getFileSize() const
+{
+    return size;
+}
+
+const WorldCache::Header& WorldCache::getHeader() const
+{
+    return *reinterpret_cast<const Header*>(data);
+}
+
+bool WorldCache::write(const std::string& filename, uint64_t parameterHash, const Heightfield& world, const IndexedMesh* mesh)
+{
+    Header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, c_magic, sizeof(c_magic));
+    header.version = c_formatVersion;
+    header.headerSize = sizeof(Header);
+    header.parameterHash = parameterHash;
+    header.width = world.getWidth();
+    header.height = world.getHeight();
+    header.heightsOffset = align(sizeof(Header));
+    uint64_t end = header.heightsOffset + sizeof(float) * static_cast<uint64_t>(header.width) * header.height;
+    if (mesh != nullptr)
+    {
+        header.hasMesh = 1;
+        header.chunkOffset = align(end);
+        header.chunkCount = mesh->chunks.size();
+        header.vertexOffset = align(header.chunkOffset + sizeof(MeshChunk) * header.chunkCount);
+        header.vertexFloatCount = mesh->vertices.size();
+        header.indexOffset = align(header.vertexOffset + sizeof(float) * header.vertexFloatCount);
+        header.indexCount = mesh->getIndexCount();
+        header.indexSize = mesh->wideIndices ? sizeof(uint32_t) : sizeof(uint16_t);
+        end = header.indexOffset + static_cast<uint64_t>(header.indexSize) * header.indexCount;
+    }
+    header.fileSize = end;
+
+    std::string temporaryFilename = filename + ".tmp";
+    {
+        std::ofstream file(temporaryFilename.c_str(), std::ios::binary);
+        if (!file)
+        {
+            std::cerr << "ERROR: Could not open file: " << temporaryFilename << "\n";
+            return false;
+        }
+
+        uint64_t position = 0;
+        auto writeAt = [&file, &position](uint64_t offset, const void* bytes, uint64_t count) {
+            static const char padding[c_sectionAlignment] = {};
+            file.write(padding, static_cast<std::streamsize>(offset - position));
+            file.write(static_cast<const char*>(bytes), static_cast<std::streamsize>(count));
+            position = offset + count;
+        };
+
+        writeAt(0, &header, sizeof(header));
+        std::vector<float> row(world.getWidth());
+        for (int y = 0; y < world.getHeight(); ++y)
+        {
+            for (int x = 0; x < world.getWidth(); ++x)
+            {
+                row[x] = world.at(x, y);
+            }
+            uint64_t offset = header.heightsOffset + sizeof(float) * static_cast<uint64_t>(y) * world.getWidth();
+            writeAt(offset, row.data(), sizeof(float) * row.size());
+        }
+        if (mesh != nullptr)
+        {
+            IndexedMeshView view = getMeshView(*mesh);
+            writeAt(header.chunkOffset, view.chunks, sizeof(MeshChunk) * view.chunkCount);
+            writeAt(header.vertexOffset, view.vertices, sizeof(float) * view.vertexFloatCount);
+            writeAt(header.indexOffset, view.indices, static_cast<uint64_t>(header.indexSize) * view.indexCount);
+        }
+        if (!file)
+        {
+            std::cerr << "ERROR: Could not write file: " << temporaryFilename << "\n";
+            return false;
+        }
+    }
+
+    // rename does not replace an existing file on Windows
+    std::remove(filename.c_str());
+    if (std::rename(temporaryFilename.c_str(), filename.c_str()) != 0)
+    {
+        std::cerr << "ERROR: Could not rename " << temporaryFilename << " to " << filename << "\n";
+        std::remove(temporaryFilename.c_str());
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,130 @@
+#include "WorldParams.h"
+
+#include <cstdlib>
+#include <iostream>
+
+namespace
+{
+bool parseValue(const std::string& text, int& value)
+{
+    char* end = nullptr;
+    long parsed = std::strtol(text.c_str(), &end, 10);
+    if (text.empty() || *end != '\0')
+    {
+        return false;
+    }
+    value = static_cast<int>(parsed);
+    return true;
+}
+
+bool parseValue(const std::string& text, float& value)
+{
+    char* end = nullptr;
+    float parsed = std::strtof(text.c_str(), &end);
+    if (text.empty() || *end != '\0')
+    {
+        return false;
+    }
+    value = parsed;
+    return true;
+}
+} // namespace
+
+bool setWorldParam(WorldParams& params, const std::string& name, const std::string& value)
+{
+#define WORLD_PARAM(member)                      \
+    if (name == #member)                         \
+    {                                            \
+        return parseValue(value, params.member); \
+    }
+    WORLD_PARAM(width)
+    WORLD_PARAM(height)
+    WORLD_PARAM(numMountains)
+    WORLD_PARAM(minMountainLength)
+    WORLD_PARAM(maxMountainLength)
+    WORLD_PARAM(mountainEdgeMargin)
+    WORLD_PARAM(minHeightMultiplier)
+    WORLD_PARAM(maxHeightMultiplier)
+    WORLD_PARAM(minBumpDeviation)
+    WORLD_PARAM(maxBumpDeviation)
+    WORLD_PARAM(mountainWaveLength)
+    WORLD_PARAM(bumpDensity)
+    WORLD_PARAM(minParabolaCoefficient)
+    WORLD_PARAM(maxParabolaCoefficient)
+    WORLD_PARAM(minParabolaExponent)
+    WORLD_PARAM(maxParabolaExponent)
+    WORLD_PARAM(numRivers)
+    WORLD_PARAM(riverControlPoints)
+    WORLD_PARAM(riverDepth)
+    WORLD_PARAM(riverDeviation)
+    WORLD_PARAM(riverPitDensity)
+    WORLD_PARAM(riverSlopeSteepness)
+    WORLD_PARAM(riverEndPointMargin)
+    WORLD_PARAM(erosionDroplets)
+    WORLD_PARAM(erosionLifetime)
+    WORLD_PARAM(erosionInertia)
+    WORLD_PARAM(erosionCapacity)
+    WORLD_PARAM(erosionMinCapacity)
+    WORLD_PARAM(erosionErodeSpeed)
+    WORLD_PARAM(erosionDepositSpeed)
+    WORLD_PARAM(erosionEvaporateSpeed)
+    WORLD_PARAM(erosionGravity)
+    WORLD_PARAM(thermalIterations)
+    WORLD_PARAM(thermalTalus)
+    WORLD_PARAM(thermalRate)
+    WORLD_PARAM(smoothIterations)
+    WORLD_PARAM(smoothStrength)
+#undef WORLD_PARAM
+    return false;
+}
+
+bool validateWorldParams(const WorldParams& params)
+{
+    const char* error = nullptr;
+    if (params.width <= 0 || params.height <= 0)
+    {
+        error = "world size must be positive";
+    }
+    else if (params.numMountains < 0 || params.minMountainLength > params.maxMountainLength || params.minMountainLength < 0)
+    {
+        error = "mountain count or length range is invalid";
+    }
+    else if (params.minBumpDeviation <= 0.0f || params.minBumpDeviation > params.maxBumpDeviation)
+    {
+        error = "bump deviation range is invalid";
+    }
+    else if (params.minHeightMultiplier > params.maxHeightMultiplier || params.minParabolaCoefficient > params.maxParabolaCoefficient ||
+             params.minParabolaExponent > params.maxParabolaExponent)
+    {
+        error = "height multiplier or parabola range is invalid";
+    }
+    else if (params.erosionDroplets < 0 || params.erosionLifetime <= 0 || params.erosionInertia < 0.0f || params.erosionInertia >= 1.0f ||
+             params.erosionEvaporateSpeed < 0.0f || params.erosionEvaporateSpeed > 1.0f)
+    {
+        error = "erosion droplets, lifetime, inertia or evaporation is out of range";
+    }
+    else if (params.thermalIterations < 0 || params.thermalTalus < 0.0f || params.thermalRate < 0.0f || params.thermalRate > 0.25f ||
+             params.smoothIterations < 0 || params.smoothStrength < 0.0f || params.smoothStrength > 1.0f)
+    {
+        error = "thermal erosion or smoothing parameters are out of range";
+    }
+    else if (params.numRivers < 0 || params.riverControlPoints < 2)
+    {
+        error = "river count must not be negative and rivers need at least two control points";
+    }
+    else if (params.bumpDensity <= 0 || params.riverPitDensity <= 0 || params.riverDeviation <= 0.0f)
+    {
+        error = "bump density, river pit density and river deviation must be positive";
+    }
+    else if (2 * params.riverEndPointMargin > params.height || params.mountainEdgeMargin > params.width || params.mountainEdgeMargin > params.height)
+    {
+        error = "margins do not fit the world";
+    }
+
+    if (error != nullptr)
+    {
+        std::cerr << "ERROR: Invalid world parameters: " << error << "\n";
+        return false;
+    }
+    return true;
+}
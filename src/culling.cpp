@@ -0,0 +1,265 @@
+#include "culling.h"
+#include "constants.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <queue>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+void BoxList::clear()
+{
+    minX.clear();
+    minY.clear();
+    minZ.clear();
+    maxX.clear();
+    maxY.clear();
+    maxZ.clear();
+}
+
+void BoxList::add(const glm::vec3& min, const glm::vec3& max)
+{
+    minX.push_back(min.x);
+    minY.push_back(min.y);
+    minZ.push_back(min.z);
+    maxX.push_back(max.x);
+    maxY.push_back(max.y);
+    maxZ.push_back(max.z);
+}
+
+size_t BoxList::size() const
+{
+    return minX.size();
+}
+
+void extractFrustum(const glm::mat4& viewProjection, Frustum& frustum)
+{
+    // Rows of the matrix, glm is column major
+    float rows[4][4];
+    for (int r = 0; r < 4; ++r)
+    {
+        for (int c = 0; c < 4; ++c)
+        {
+            rows[r][c] = viewProjection[c][r];
+        }
+    }
+
+    for (int i = 0; i < 6; ++i)
+    {
+        const float* row = rows[i / 2];
+        float sign = (i % 2 == 0) ? 1.0f : -1.0f;
+        float* plane = frustum.planes[i];
+        for (int c = 0; c < 4; ++c)
+        {
+            plane[c] = rows[3][c] + sign * row[c];
+        }
+        float length = std::sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+        for (int c = 0; c < 4; ++c)
+        {
+            plane[c] /= length;
+        }
+    }
+}
+
+void cullFrustumScalar(const Frustum& frustum, const BoxList& boxes, std::vector<uint8_t>& visible)
+{
+    visible.resize(boxes.size());
+    for (size_t i = 0; i < boxes.size(); ++i)
+    {
+        bool inside = true;
+        for (const float* plane : frustum.planes)
+        {
+            // Corner furthest along the plane normal
+            float x = plane[0] >= 0.0f ? boxes.maxX[i] : boxes.minX[i];
+            float y = plane[1] >= 0.0f ? boxes.maxY[i] : boxes.minY[i];
+            float z = plane[2] >= 0.0f ? boxes.maxZ[i] : boxes.minZ[i];
+            inside = inside && plane[0] * x + plane[1] * y + plane[2] * z + plane[3] >= 0.0f;
+        }
+        visible[i] = inside ? 1 : 0;
+    }
+}
+
+void cullFrustum(const Frustum& frustum, const BoxList& boxes, std::vector<uint8_t>& visible)
+{
+#if defined(__x86_64__) || defined(_M_X64)
+    visible.resize(boxes.size());
+    size_t count = boxes.size();
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (const float* plane : frustum.planes)
+        {
+            // The sign of the normal picks the corner for all four boxes at once
+            __m128 x = _mm_loadu_ps(plane[0] >= 0.0f ? &boxes.maxX[i] : &boxes.minX[i]);
+            __m128 y = _mm_loadu_ps(plane[1] >= 0.0f ? &boxes.maxY[i] : &boxes.minY[i]);
+            __m128 z = _mm_loadu_ps(plane[2] >= 0.0f ? &boxes.maxZ[i] : &boxes.minZ[i]);
+            __m128 distance = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane[0]), x), _mm_mul_ps(_mm_set1_ps(plane[1]), y));
+            distance = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(plane[2]), z));
+            distance = _mm_add_ps(distance, _mm_set1_ps(plane[3]));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, _mm_setzero_ps()));
+        }
+        int mask = _mm_movemask_ps(inside);
+        for (int lane = 0; lane < 4; ++lane)
+        {
+            visible[i + lane] = static_cast<uint8_t>((mask >> lane) & 1);
+        }
+    }
+
+    // Remaining boxes one at a time
+    for (; i < count; ++i)
+    {
+        bool inside = true;
+        for (const float* plane : frustum.planes)
+        {
+            float x = plane[0] >= 0.0f ? boxes.maxX[i] : boxes.minX[i];
+            float y = plane[1] >= 0.0f ? boxes.maxY[i] : boxes.minY[i];
+            float z = plane[2] >= 0.0f ? boxes.maxZ[i] : boxes.minZ[i];
+            inside = inside && plane[0] * x + plane[1] * y + plane[2] * z + plane[3] >= 0.0f;
+        }
+        visible[i] = inside ? 1 : 0;
+    }
+#else
+    cullFrustumScalar(frustum, boxes, visible);
+#endif
+}
+
+namespace
+{
+struct HorizonSpan
+{
+    size_t box;
+    float nearDistance;
+    float farDistance;
+    // Bins touched by the box, lastBin may be past binCount when wrapping around
+    int firstBin;
+    int lastBin;
+    // Bins every ray of which crosses the box, empty when lastFullBin < firstFullBin
+    int firstFullBin;
+    int lastFullBin;
+    float lowTangent;
+    float highTangent;
+};
+
+float wrapAngle(float angle)
+{
+    while (angle > pi)
+    {
+        angle -= 2.0f * pi;
+    }
+    while (angle <= -pi)
+    {
+        angle += 2.0f * pi;
+    }
+    return angle;
+}
+} // namespace
+
+int cullHorizon(const glm::vec3& camera, const BoxList& boxes, int binCount, std::vector<uint8_t>& visible)
+{
+    float binWidth = 2.0f * pi / static_cast<float>(binCount);
+    std::vector<HorizonSpan> spans;
+    spans.reserve(boxes.size());
+    for (size_t i = 0; i < boxes.size(); ++i)
+    {
+        float dx = std::max(std::max(boxes.minX[i] - camera.x, camera.x - boxes.maxX[i]), 0.0f);
+        float dz = std::max(std::max(boxes.minZ[i] - camera.z, camera.z - boxes.maxZ[i]), 0.0f);
+        if (dx == 0.0f && dz == 0.0f)
+        {
+            // The camera is above the box, it neither hides nor is hidden
+            continue;
+        }
+
+        HorizonSpan span;
+        span.box = i;
+        span.nearDistance = std::sqrt(dx * dx + dz * dz);
+        float fx = std::max(std::abs(boxes.minX[i] - camera.x), std::abs(boxes.maxX[i] - camera.x));
+        float fz = std::max(std::abs(boxes.minZ[i] - camera.z), std::abs(boxes.maxZ[i] - camera.z));
+        span.farDistance = std::sqrt(fx * fx + fz * fz);
+
+        float centerAngle = std::atan2(0.5f * (boxes.minZ[i] + boxes.maxZ[i]) - camera.z, 0.5f * (boxes.minX[i] + boxes.maxX[i]) - camera.x);
+        float low = 0.0f;
+        float high = 0.0f;
+        const float cornersX[] = {boxes.minX[i], boxes.maxX[i]};
+        const float cornersZ[] = {boxes.minZ[i], boxes.maxZ[i]};
+        for (float x : cornersX)
+        {
+            for (float z : cornersZ)
+            {
+                float angle = wrapAngle(std::atan2(z - camera.z, x - camera.x) - centerAngle);
+                low = std::min(low, angle);
+                high = std::max(high, angle);
+            }
+        }
+        span.firstBin = static_cast<int>(std::floor((centerAngle + low) / binWidth));
+        span.lastBin = static_cast<int>(std::floor((centerAngle + high) / binWidth));
+        span.firstFullBin = static_cast<int>(std::ceil((centerAngle + low) / binWidth));
+        span.lastFullBin = span.lastBin - 1;
+
+        // Bounds of the elevation of any terrain point in the box
+        float above = boxes.maxY[i] - camera.y;
+        float below = boxes.minY[i] - camera.y;
+        span.highTangent = above / (above > 0.0f ? span.nearDistance : span.farDistance);
+        span.lowTangent = below / (below > 0.0f ? span.farDistance : span.nearDistance);
+        spans.push_back(span);
+    }
+
+    std::sort(spans.begin(), spans.end(), [](const HorizonSpan& a, const HorizonSpan& b) { return a.nearDistance < b.nearDistance; });
+
+    // Boxes wait until every box tested later is completely behind them
+    typedef std::pair<float, const HorizonSpan*> Pending;
+    std::priority_queue<Pending, std::vector<Pending>, std::greater<Pending>> pending;
+    std::vector<float> horizon(binCount, -INFINITY);
+    auto getBin = [binCount](int bin) { return ((bin % binCount) + binCount) % binCount; };
+
+    int hidden = 0;
+    for (const HorizonSpan& span : spans)
+    {
+        while (!pending.empty() && pending.top().first <= span.nearDistance)
+        {
+            const HorizonSpan& occluder = *pending.top().second;
+            for (int bin = occluder.firstFullBin; bin <= occluder.lastFullBin; ++bin)
+            {
+                float& tangent = horizon[getBin(bin)];
+                tangent = std::max(tangent, occluder.lowTangent);
+            }
+            pending.pop();
+        }
+
+        if (visible[span.box])
+        {
+            bool occluded = true;
+            for (int bin = span.firstBin; bin <= span.lastBin && occluded; ++bin)
+            {
+                occluded = span.highTangent < horizon[getBin(bin)];
+            }
+            if (occluded)
+            {
+                visible[span.box] = 0;
+                ++hidden;
+            }
+        }
+        pending.push(Pending(span.farDistance, &span));
+    }
+    return hidden;
+}
+
+void cullBoxes(const glm::mat4& viewProjection, const glm::vec3& camera, const BoxList& boxes, bool horizon,
+               std::vector<uint8_t>& visible, CullingStats& stats)
+{
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point start = Clock::now();
+
+    Frustum frustum;
+    extractFrustum(viewProjection, frustum);
+    cullFrustum(frustum, boxes, visible);
+
+    stats.tested = static_cast<int>(boxes.size());
+    stats.frustumCulled = static_cast<int>(std::count(visible.begin(), visible.end(), 0));
+    stats.horizonCulled = horizon ? cullHorizon(camera, boxes, c_horizonBins, visible) : 0;
+    stats.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+}
@@ -0,0 +1,171 @@
+#include "erosion.h"
+#include "CounterRandom.h"
+#include "parallel.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace
+{
+struct Tile
+{
+    int x;
+    int y;
+    int droplets;
+};
+
+// Bilinear height and gradient inside the cell containing (x, y)
+void getHeightGradient(const Heightfield& world, float x, float y, float& height, float& gradientX, float& gradientY)
+{
+    int nodeX = static_cast<int>(x);
+    int nodeY = static_cast<int>(y);
+    float u = x - static_cast<float>(nodeX);
+    float v = y - static_cast<float>(nodeY);
+    float northWest = world.at(nodeX, nodeY);
+    float northEast = world.at(nodeX + 1, nodeY);
+    float southWest = world.at(nodeX, nodeY + 1);
+    float southEast = world.at(nodeX + 1, nodeY + 1);
+
+    gradientX = (northEast - northWest) * (1.0f - v) + (southEast - southWest) * v;
+    gradientY = (southWest - northWest) * (1.0f - u) + (southEast - northEast) * u;
+    height = northWest * (1.0f - u) * (1.0f - v) + northEast * u * (1.0f - v) + southWest * (1.0f - u) * v + southEast * u * v;
+}
+
+void addBilinear(Heightfield& world, int nodeX, int nodeY, float u, float v, float amount)
+{
+    world.at(nodeX, nodeY) += amount * (1.0f - u) * (1.0f - v);
+    world.at(nodeX + 1, nodeY) += amount * u * (1.0f - v);
+    world.at(nodeX, nodeY + 1) += amount * (1.0f - u) * v;
+    world.at(nodeX + 1, nodeY + 1) += amount * u * v;
+}
+
+void simulateDroplet(Heightfield& world, float x, float y, const WorldParams& params)
+{
+    float maxX = static_cast<float>(world.getWidth() - 1);
+    float maxY = static_cast<float>(world.getHeight() - 1);
+    float directionX = 0.0f;
+    float directionY = 0.0f;
+    float speed = 1.0f;
+    float water = 1.0f;
+    float sediment = 0.0f;
+    if (x >= maxX || y >= maxY)
+    {
+        return;
+    }
+
+    for (int step = 0; step < params.erosionLifetime; ++step)
+    {
+        int nodeX = static_cast<int>(x);
+        int nodeY = static_cast<int>(y);
+        float u = x - static_cast<float>(nodeX);
+        float v = y - static_cast<float>(nodeY);
+        float height;
+        float gradientX;
+        float gradientY;
+        getHeightGradient(world, x, y, height, gradientX, gradientY);
+
+        directionX = directionX * params.erosionInertia - gradientX * (1.0f - params.erosionInertia);
+        directionY = directionY * params.erosionInertia - gradientY * (1.0f - params.erosionInertia);
+        float length = std::sqrt(directionX * directionX + directionY * directionY);
+        if (length == 0.0f)
+        {
+            break;
+        }
+        directionX /= length;
+        directionY /= length;
+        x += directionX;
+        y += directionY;
+        if (x < 0.0f || y < 0.0f || x >= maxX || y >= maxY)
+        {
+            break;
+        }
+
+        float newHeight;
+        float unused;
+        getHeightGradient(world, x, y, newHeight, unused, unused);
+        float deltaHeight = newHeight - height;
+        float capacity = std::max(-deltaHeight * speed * water * params.erosionCapacity, params.erosionMinCapacity);
+        if (sediment > capacity || deltaHeight > 0.0f)
+        {
+            // Uphill the droplet fills the pit it leaves, downhill it drops part of the excess
+            float deposit = deltaHeight > 0.0f ? std::min(deltaHeight, sediment) : (sediment - capacity) * params.erosionDepositSpeed;
+            sediment -= deposit;
+            addBilinear(world, nodeX, nodeY, u, v, deposit);
+        }
+        else
+        {
+            float erosion = std::min((capacity - sediment) * params.erosionErodeSpeed, -deltaHeight);
+            sediment += erosion;
+            addBilinear(world, nodeX, nodeY, u, v, -erosion);
+        }
+
+        speed = std::sqrt(std::max(0.0f, speed * speed - deltaHeight * params.erosionGravity));
+        water *= 1.0f - params.erosionEvaporateSpeed;
+    }
+}
+} // namespace
+
+int getErosionTileSize(const WorldParams& params)
+{
+    // Reach of lifetime cells plus the bilinear footprint on both sides of the
+    // tile between, with a few cells to spare for rounding
+    return 2 * params.erosionLifetime + 8;
+}
+
+long long erodeHydraulic(Heightfield& world, unsigned int seed, const WorldParams& params, int threadCount)
+{
+    TRACE_SCOPE("erodeHydraulic");
+    int cellsX = world.getWidth() - 1;
+    int cellsY = world.getHeight() - 1;
+    if (cellsX <= 0 || cellsY <= 0)
+    {
+        return 0;
+    }
+    int tileSize = getErosionTileSize(params);
+    int tilesX = (cellsX + tileSize - 1) / tileSize;
+    int tilesY = (cellsY + tileSize - 1) / tileSize;
+
+    // Droplets are shared out by tile area, clipped tiles on the edges get fewer
+    std::vector<Tile> phases[4];
+    long long total = 0;
+    int maxDroplets = 0;
+    long long cellCount = static_cast<long long>(cellsX) * cellsY;
+    for (int ty = 0; ty < tilesY; ++ty)
+    {
+        for (int tx = 0; tx < tilesX; ++tx)
+        {
+            long long area = static_cast<long long>(std::min(tileSize, cellsX - tx * tileSize)) * std::min(tileSize, cellsY - ty * tileSize);
+            int droplets = static_cast<int>(params.erosionDroplets * area / cellCount);
+            phases[(ty % 2) * 2 + tx % 2].push_back({tx, ty, droplets});
+            total += droplets;
+            maxDroplets = std::max(maxDroplets, droplets);
+        }
+    }
+
+    // Batches keep the tiles of different phases eroding in step
+    for (int first = 0; first < maxDroplets; first += c_erosionBatch)
+    {
+        for (const std::vector<Tile>& tiles : phases)
+        {
+            parallelFor(static_cast<int>(tiles.size()), threadCount, [&](int i) {
+                TRACE_SCOPE("erosionTile");
+                const Tile& tile = tiles[i];
+                CounterRandom random(seed, CounterRandom::Feature::Erosion, 0, tile.x, tile.y);
+                float minX = static_cast<float>(tile.x * tileSize);
+                float minY = static_cast<float>(tile.y * tileSize);
+                float maxX = static_cast<float>(std::min((tile.x + 1) * tileSize, cellsX));
+                float maxY = static_cast<float>(std::min((tile.y + 1) * tileSize, cellsY));
+                int last = std::min(first + c_erosionBatch, tile.droplets);
+                for (int droplet = first; droplet < last; ++droplet)
+                {
+                    uint32_t draw = 2 * static_cast<uint32_t>(droplet);
+                    simulateDroplet(world, random.uniformFloat(draw, minX, maxX), random.uniformFloat(draw + 1, minY, maxY), params);
+                }
+            });
+        }
+    }
+    world.markAllDirty();
+    return total;
+}
@@ -1,7 +1,16 @@
 #include "shader.h"
 #include "camera.h"
 #include "transformation.h"
-#include "functions.h"
+#include "world.h"
+#include "mesh.h"
+#include "parallel.h"
+#include "TerrainStreamer.h"
+#include "Geomipmap.h"
+#include "HeightPyramid.h"
+#include "Rtin.h"
+#include "culling.h"
+#include "WorldCache.h"
+#include "trace.h"
 #include "constants.h"
 
 #include <glm/glm.hpp>
@@ -9,18 +18,20 @@
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 
+#include <algorithm>
+#include <chrono>
 #include <iostream>
+#include <memory>
+#include <unordered_map>
 #include <vector>
 #include <random>
-#include <algorithm>
-#include <cstdlib>
+#include <string>
 
 Camera g_camera;
 double g_mousePosX = 0.0;
 double g_mousePosY = 0.0;
 
 std::random_device g_randomDevice;
-std::mt19937 g_rng(c_randomSeed ? g_randomDevice() : c_seed);
 
 void processInput(GLFWwindow* window, float deltaTime)
 {
@@ -68,169 +79,240 @@ void processInput(GLFWwindow* window, float deltaTime)
     transformation.updateModelMatrix();
 }
 
-float createBump(std::vector<std::vector<float>>& world, int centerX, int centerY, float bumpHeightMultiplier, float deviation)
+// True when the key went down since the last call
+bool wasKeyPressed(GLFWwindow* window, int key, bool& down)
 {
-    int limit = static_cast<int>(deviation * c_standardDeviationArea);
-    int minX = std::max(0, centerX - limit);
-    int maxX = std::min(c_worldWidth, centerX + limit);
-    int minY = std::max(0, centerY - limit);
-    int maxY = std::min(c_worldHeight, centerY + limit);
+    bool pressed = glfwGetKey(window, key) == GLFW_PRESS;
+    bool result = pressed && !down;
+    down = pressed;
+    return result;
+}
 
-    for (int y = minY; y <= maxY; ++y)
-    {
-        for (int x = minX; x <= maxX; ++x)
-        {
-            float d = distance(centerX, centerY, x, y);
-            float height = normalDistribution(0.0f, deviation, d) * bumpHeightMultiplier;
-            world[x][y] += height;
-        }
-    }
-    return world[centerX][centerY];
+struct TerrainDraw
+{
+    GLsizei indexCount;
+    GLenum indexType;
+    size_t indexOffset;
+    GLint baseVertex;
+    int firstRow;
+    float minHeight;
+    float heightStep;
+};
+
+// The upload functions fill the bound vertex and index buffers and set up the vertex attributes
+void uploadSoupMesh(const Heightfield& world, std::vector<TerrainDraw>& draws)
+{
+    TRACE_SCOPE("uploadSoupMesh");
+    std::vector<int> indices;
+    std::vector<float> vertices;
+    generateMesh(world, indices, vertices, getDefaultThreadCount());
+
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(int) * indices.size(), indices.data(), GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(float) * vertices.size(), vertices.data(), GL_STATIC_DRAW);
+
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
+    glEnableVertexAttribArray(1);
+
+    draws.push_back({static_cast<GLsizei>(indices.size()), GL_UNSIGNED_INT, 0, 0, 0, 0.0f, 0.0f});
 }
 
-bool getBumpPosition(int iteration, int centerX, int centerY, int& x, int& y, float a, int exp)
+void uploadIndexedMesh(const IndexedMeshView& mesh, std::vector<TerrainDraw>& draws)
 {
-    float relativeY = 0.0f;
-    relativeY = parabola(a, static_cast<float>(iteration), exp);
-
-    int newX = centerX + iteration;
-    int newY = centerY + static_cast<int>(relativeY);
-    int widthLimit = c_worldWidth - c_mountainEdgeMargin;
-    int heightLimit = c_worldHeight - c_mountainEdgeMargin;
-    bool insideLimits = newX >= 0 && newX <= widthLimit && newY >= 0 && newY <= heightLimit;
-
-    x = std::min(std::max(0, newX), widthLimit);
-    y = std::min(std::max(0, newY), heightLimit);
-    return insideLimits;
+    TRACE_SCOPE("uploadIndexedMesh");
+    size_t indexSize = mesh.wideIndices ? sizeof(uint32_t) : sizeof(uint16_t);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexSize * mesh.indexCount, mesh.indices, GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(float) * mesh.vertexFloatCount, mesh.vertices, GL_STATIC_DRAW);
+
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
+    glEnableVertexAttribArray(1);
+
+    GLenum indexType = mesh.wideIndices ? GL_UNSIGNED_INT : GL_UNSIGNED_SHORT;
+    for (size_t i = 0; i < mesh.chunkCount; ++i)
+    {
+        const MeshChunk& chunk = mesh.chunks[i];
+        draws.push_back({chunk.indexCount, indexType, chunk.firstIndex * indexSize, chunk.baseVertex, 0, 0.0f, 0.0f});
+    }
 }
 
-void createMountain(std::vector<std::vector<float>>& world)
+void uploadPackedMesh(const Heightfield& world, std::vector<TerrainDraw>& draws)
 {
-    std::uniform_int_distribution<int> randomX(0, c_worldWidth);
-    std::uniform_int_distribution<int> randomY(0, c_worldHeight);
-    std::uniform_int_distribution<int> randomMountainLength(c_minMountainLength, c_maxMountainLength);
-    std::uniform_real_distribution<float> randomBumpHeightMultiplier(c_minHeightMultiplier, c_maxHeightMultiplier);
-    std::uniform_real_distribution<float> randomDeviation(c_minBumpDeviation, c_maxBumpDeviation);
-    std::uniform_real_distribution<float> randomCoefficient(c_minParabolaCoefficient, c_maxParabolaCoefficient);
-    std::uniform_int_distribution<int> randomExponent(c_minParabolaExponent, c_maxParabolaExponent);
-
-    int mountainLength = randomMountainLength(g_rng);
-    std::uniform_int_distribution<int> randomIterationStart(-mountainLength / 2, mountainLength / 2);
-
-    float bumpHeightBaseMultiplier = randomBumpHeightMultiplier(g_rng);
-
-    int centerX = randomX(g_rng);
-    int centerY = randomY(g_rng);
-    int iterationStart = randomIterationStart(g_rng);
-    int x = 0;
-    int y = 0;
-    float a = randomCoefficient(g_rng);
-    int exp = randomExponent(g_rng);
-
-    for (int i = 0; i < mountainLength; i += c_bumpDensity)
+    TRACE_SCOPE("uploadPackedMesh");
+    PackedMesh mesh;
+    generatePackedMesh(world, c_packedNormalBits, mesh);
+
+    size_t indexSize = mesh.wideIndices ? sizeof(uint32_t) : sizeof(uint16_t);
+    const void* indexData = mesh.wideIndices ? static_cast<const void*>(mesh.indices32.data()) : mesh.indices16.data();
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexSize * mesh.getIndexCount(), indexData, GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, mesh.vertices.size(), mesh.vertices.data(), GL_STATIC_DRAW);
+
+    glVertexAttribIPointer(0, 1, GL_UNSIGNED_SHORT, mesh.stride, (void*)0);
+    glEnableVertexAttribArray(0);
+
+    GLenum normalType = mesh.normalBits == 16 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_BYTE;
+    glVertexAttribPointer(1, 2, normalType, GL_TRUE, mesh.stride, (void*)2);
+    glEnableVertexAttribArray(1);
+
+    GLenum indexType = mesh.wideIndices ? GL_UNSIGNED_INT : GL_UNSIGNED_SHORT;
+    for (const PackedChunk& chunk : mesh.chunks)
     {
-        if (getBumpPosition(iterationStart + i, centerX, centerY, x, y, a, exp))
-        {
-            float sinStep = std::sin(static_cast<float>(i) * c_mountainWaveLength);
-            sinStep = (sinStep + 2.0f) / 2.0f;
-            float bumpHeightMultiplier = bumpHeightBaseMultiplier * sinStep;
-            float deviation = randomDeviation(g_rng);
-            createBump(world, x, y, bumpHeightMultiplier, deviation);
-        }
+        draws.push_back({chunk.indexCount, indexType, chunk.firstIndex * indexSize, chunk.baseVertex, chunk.firstRow, chunk.minHeight, chunk.heightStep});
     }
 }
 
-int getPitPosition(int startHeight, int endHeight, int x)
+// Draws are instanced over the tiles of the texture
+void uploadGridMesh(std::vector<TerrainDraw>& draws)
 {
-    float yt = slope(divide(x, c_worldWidth), c_riverSlopeSteepness);
-    return interpolate(startHeight, endHeight, yt);
+    TRACE_SCOPE("uploadGridMesh");
+    std::vector<uint16_t> vertices;
+    std::vector<uint16_t> indices;
+    generateGridMesh(c_gridTileSize, vertices, indices);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint16_t) * indices.size(), indices.data(), GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(uint16_t) * vertices.size(), vertices.data(), GL_STATIC_DRAW);
+
+    glVertexAttribIPointer(0, 2, GL_UNSIGNED_SHORT, 2 * sizeof(uint16_t), (void*)0);
+    glEnableVertexAttribArray(0);
+
+    draws.push_back({static_cast<GLsizei>(indices.size()), GL_UNSIGNED_SHORT, 0, 0, 0, 0.0f, 0.0f});
 }
 
-void createRiver(std::vector<std::vector<float>>& world)
+// Fills the bound texture and sets the height uniforms of the bound program
+void uploadHeightTexture(const HeightTexture& texture)
 {
-    int startHeight = c_riverEndPointMargin;
-    int endHeight = c_worldHeight - c_riverEndPointMargin;
-    float currentDepth = 0.0f;
+    TRACE_SCOPE("uploadHeightTexture");
+    GLenum internalFormat = texture.bits == 16 ? GL_R16 : GL_R32F;
+    GLenum type = texture.bits == 16 ? GL_UNSIGNED_SHORT : GL_FLOAT;
+    glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, texture.width, texture.height, 0, GL_RED, type, texture.getTexels());
+    glUniform1f(4, texture.heightOffset);
+    glUniform1f(5, texture.heightScale);
+}
 
-    for (int x = 0; x <= c_worldWidth; x += c_riverPitDensity)
-    {
-        int y = getPitPosition(startHeight, endHeight, x);
-        currentDepth = world[x][y];
-        while (currentDepth > -c_riverDepth)
-        {
-            currentDepth = createBump(world, x, y, -2.0f, c_riverDeviation);
-        }
-    }
+// GPU copy of a streamed chunk
+struct ChunkBuffers
+{
+    GLuint vertexArray = 0;
+    GLuint indexBuffer = 0;
+    GLuint vertexBuffer = 0;
+    glm::mat4 model;
+    glm::vec3 boundsMin;
+    glm::vec3 boundsMax;
+    std::vector<TerrainDraw> draws;
+};
+
+void deleteChunk(ChunkBuffers& buffers)
+{
+    glDeleteVertexArrays(1, &buffers.vertexArray);
+    glDeleteBuffers(1, &buffers.indexBuffer);
+    glDeleteBuffers(1, &buffers.vertexBuffer);
+    buffers.vertexArray = 0;
+    buffers.indexBuffer = 0;
+    buffers.vertexBuffer = 0;
 }
 
-void generateWorld(std::vector<std::vector<float>>& world)
+// Streamed chunks are always indexed meshes with their own buffers. The
+// buffers of a chunk that is delivered again are replaced.
+void uploadChunk(const TerrainChunk& chunk, ChunkBuffers& buffers)
 {
-    world.resize(c_worldHeight + 1);
-    for (std::vector<float>& width : world)
+    if (buffers.vertexArray != 0)
     {
-        width.resize(c_worldWidth + 1);
+        deleteChunk(buffers);
     }
+    buffers.draws.clear();
+    glGenVertexArrays(1, &buffers.vertexArray);
+    glBindVertexArray(buffers.vertexArray);
+    glGenBuffers(1, &buffers.indexBuffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers.indexBuffer);
+    glGenBuffers(1, &buffers.vertexBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, buffers.vertexBuffer);
+    uploadIndexedMesh(getMeshView(chunk.mesh), buffers.draws);
+
+    float chunkWorldSize = static_cast<float>(c_chunkSize) * c_worldScale;
+    buffers.model = glm::mat4(1.0f);
+    buffers.model[3] = glm::vec4(chunk.x * chunkWorldSize, 0.0f, chunk.z * chunkWorldSize, 1.0f);
+    buffers.boundsMin = glm::vec3(chunk.x * chunkWorldSize, chunk.minHeight, chunk.z * chunkWorldSize);
+    buffers.boundsMax = glm::vec3((chunk.x + 1) * chunkWorldSize, chunk.maxHeight, (chunk.z + 1) * chunkWorldSize);
+}
 
-    for (int i = 0; i < c_numMountains; ++i)
+void getPatchBoxes(const Geomipmap& geomipmap, BoxList& boxes)
+{
+    boxes.clear();
+    for (int py = 0; py < geomipmap.getPatchCountY(); ++py)
     {
-        createMountain(world);
+        for (int px = 0; px < geomipmap.getPatchCountX(); ++px)
+        {
+            glm::vec3 min;
+            glm::vec3 max;
+            geomipmap.getPatchBounds(px, py, min, max);
+            boxes.add(min, max);
+        }
     }
-
-    createRiver(world);
 }
 
-void addVertex(std::vector<float>& vertices, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c)
+// Uploads the vertices of the dirty samples and refreshes the level of detail
+// patches they touch. mesh holds the vertices last uploaded.
+void updateTerrain(Heightfield& world, IndexedMesh& mesh, GLuint vertexBuffer, Geomipmap* geomipmap, BoxList& lodBoxes, std::vector<BufferRange>& ranges)
 {
-    auto addVec3 = [](std::vector<float>& vec, const glm::vec3& v) {
-        vec.push_back(v.x);
-        vec.push_back(v.y);
-        vec.push_back(v.z);
-    };
-
-    addVec3(vertices, a);
-    addVec3(vertices, glm::normalize(glm::cross(c - a, b - a)));
-
-    addVec3(vertices, b);
-    addVec3(vertices, glm::normalize(glm::cross(a - b, c - b)));
+    TRACE_SCOPE("updateTerrain");
+    ranges.clear();
+    updateIndexedMesh(world, mesh, ranges);
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(mesh.vertices.data());
+    for (const BufferRange& range : ranges)
+    {
+        glBufferSubData(GL_ARRAY_BUFFER, range.offset, range.size, bytes + range.offset);
+    }
 
-    addVec3(vertices, c);
-    addVec3(vertices, glm::normalize(glm::cross(b - c, a - c)));
+    if (geomipmap != nullptr)
+    {
+        for (const DirtyRect& rect : world.getDirtyRects())
+        {
+            geomipmap->updateRegion(rect);
+        }
+        getPatchBoxes(*geomipmap, lodBoxes);
+    }
+    world.clearDirty();
 }
 
-void generateMesh(const std::vector<std::vector<float>>& world, std::vector<int>& indices, std::vector<float>& vertices)
+// Uploads the texels of the dirty samples to the bound texture, or the whole
+// texture if 16-bit heights left the quantized range
+void updateTerrainTexture(Heightfield& world, HeightTexture& texture)
 {
-    const int verticesPerSquare = 6;
-    int count = c_worldWidth * c_worldHeight * verticesPerSquare;
-
-    indices.reserve(count);
-    vertices.reserve(count);
-
-    for (int h = 0; h < c_worldWidth; ++h)
+    TRACE_SCOPE("updateTerrainTexture");
+    GLenum type = texture.bits == 16 ? GL_UNSIGNED_SHORT : GL_FLOAT;
+    const uint8_t* texels = static_cast<const uint8_t*>(texture.getTexels());
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, texture.width);
+    for (const DirtyRect& rect : world.getDirtyRects())
     {
-        for (int w = 0; w < c_worldHeight; ++w)
+        if (!updateHeightTexture(world, rect, texture))
         {
-            float x = static_cast<float>(w) * c_worldScale;
-            float z = static_cast<float>(h) * c_worldScale;
-
-            // First triangle
-            glm::vec3 a(x, world[h][w], z);
-            glm::vec3 b(x + c_worldScale, world[h][w + 1], z);
-            glm::vec3 c(x, world[h + 1][w], z + c_worldScale);
-
-            addVertex(vertices, a, b, c);
-
-            // Second triangle
-            a = glm::vec3(x + c_worldScale, world[h][w + 1], z);
-            b = glm::vec3(x + c_worldScale, world[h + 1][w + 1], z + c_worldScale);
-            c = glm::vec3(x, world[h + 1][w], z + c_worldScale);
-
-            addVertex(vertices, a, b, c);
+            generateHeightTexture(world, texture.bits, texture);
+            uploadHeightTexture(texture);
+            break;
         }
+        size_t offset = (static_cast<size_t>(rect.minY) * texture.width + rect.minX) * texture.getTexelSize();
+        glTexSubImage2D(GL_TEXTURE_2D, 0, rect.minX, rect.minY, rect.maxX - rect.minX + 1, rect.maxY - rect.minY + 1, GL_RED, type, texels + offset);
     }
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    world.clearDirty();
+}
 
-    for (int i = 0; i < count; ++i)
+void cullTerrain(const glm::mat4& viewProjection, const BoxList& boxes, std::vector<uint8_t>& visible, CullingStats& stats)
+{
+    TRACE_SCOPE("cullTerrain");
+    if (c_frustumCulling)
+    {
+        cullBoxes(viewProjection, g_camera.getTransformation().position, boxes, c_horizonCulling, visible, stats);
+    }
+    else
     {
-        indices.push_back(i);
+        visible.assign(boxes.size(), 1);
+        stats = CullingStats();
+        stats.tested = static_cast<int>(boxes.size());
     }
 }
 
@@ -256,13 +338,47 @@ int main()
         std::cout << "Failed to initialize GLAD\n";
         return 2;
     }
-
-    std::vector<std::vector<float>> world;
-    generateWorld(world);
-
-    std::vector<int> indices;
-    std::vector<float> vertices;
-    generateMesh(world, indices, vertices);
+    TRACE_THREAD_NAME("main");
+
+    unsigned int seed = c_randomSeed ? g_randomDevice() : c_seed;
+    Heightfield world;
+    WorldCache worldCache;
+    std::unique_ptr<TerrainStreamer> streamer;
+    std::unordered_map<int64_t, ChunkBuffers> chunkBuffers;
+    if (c_streaming)
+    {
+        // Leave one core for rendering
+        streamer.reset(new TerrainStreamer(seed, std::max(getDefaultThreadCount() - 1, 1)));
+    }
+    else
+    {
+        TRACE_SCOPE("loadWorld");
+        typedef std::chrono::steady_clock Clock;
+        Clock::time_point start = Clock::now();
+        WorldParams params;
+        uint64_t parameterHash = getWorldParameterHash(seed, params);
+        std::string cacheFilename = getWorldCacheFilename(parameterHash);
+        if (c_worldCache && worldCache.open(cacheFilename, parameterHash))
+        {
+            worldCache.copyHeights(world);
+            std::cout << "World loaded from " << cacheFilename;
+        }
+        else
+        {
+            generateWorld(world, seed, params, getDefaultThreadCount());
+            if (c_worldCache)
+            {
+                IndexedMesh mesh;
+                generateIndexedMesh(world, mesh);
+                if (WorldCache::write(cacheFilename, parameterHash, world, &mesh))
+                {
+                    worldCache.open(cacheFilename, parameterHash);
+                }
+            }
+            std::cout << "World generated";
+        }
+        std::cout << " in " << std::chrono::duration<double>(Clock::now() - start).count() * 1000.0 << " ms\n";
+    }
 
     glEnable(GL_DEPTH_TEST);
     glViewport(0, 0, c_screenWidth, c_screenHeight);
@@ -274,32 +390,184 @@ int main()
     GLuint indexBuffer;
     glGenBuffers(1, &indexBuffer);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(float) * indices.size(), indices.data(), GL_STATIC_DRAW);
 
     GLuint vertexBuffer;
     glGenBuffers(1, &vertexBuffer);
     glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(int) * vertices.size(), vertices.data(), GL_STATIC_DRAW);
-
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
 
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
+    std::vector<TerrainDraw> draws;
+    std::unique_ptr<Geomipmap> geomipmap;
+    std::unique_ptr<HeightPyramid> pyramid;
+    std::vector<uint32_t> lodIndices;
+    std::vector<size_t> lodPatchOffsets;
+    BoxList lodBoxes;
+    HeightTexture heightTexture;
+    GLuint heightTextureObject = 0;
+    int gridInstanceCount = 0;
+    int gridTileCountX = 0;
+    std::string vertexShader = "shader.vert";
+    if (!c_streaming)
+    {
+        if (c_meshFormat == MeshFormat::Packed)
+        {
+            vertexShader = "packed.vert";
+            uploadPackedMesh(world, draws);
+        }
+        else if (c_meshFormat == MeshFormat::HeightTexture)
+        {
+            vertexShader = "heightmap.vert";
+            uploadGridMesh(draws);
+            generateHeightTexture(world, c_heightTextureBits, heightTexture);
+            gridInstanceCount = getGridTileCount(heightTexture, c_gridTileSize, gridTileCountX);
+
+            // Rows of 16-bit texels are not 4 byte aligned for odd widths
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+            glGenTextures(1, &heightTextureObject);
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, heightTextureObject);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        }
+        else if (c_meshFormat == MeshFormat::Indexed)
+        {
+            if (worldCache.isOpen() && worldCache.hasMesh())
+            {
+                uploadIndexedMesh(worldCache.getMesh(), draws);
+            }
+            else
+            {
+                IndexedMesh mesh;
+                generateIndexedMesh(world, mesh);
+                uploadIndexedMesh(getMeshView(mesh), draws);
+            }
+            if (c_lod)
+            {
+                // Indices are rebuilt whenever the selected levels change
+                geomipmap.reset(new Geomipmap(world));
+                draws.clear();
+                getPatchBoxes(*geomipmap, lodBoxes);
+            }
+        }
+        else if (c_meshFormat == MeshFormat::Adaptive)
+        {
+            IndexedMesh mesh;
+            Rtin rtin(world);
+            rtin.generateMesh(c_adaptiveMaxError, mesh);
+            uploadIndexedMesh(getMeshView(mesh), draws);
+        }
+        else
+        {
+            uploadSoupMesh(world, draws);
+        }
+        pyramid.reset(new HeightPyramid(world));
+    }
 
     Shader shader;
-    shader.createProgram({shaderPath + "shader.vert", shaderPath + "shader.frag"});
+    shader.createProgram({shaderPath + vertexShader, shaderPath + "shader.frag"});
     glUseProgram(shader.getProgram());
+    if (!c_streaming && c_meshFormat == MeshFormat::Packed)
+    {
+        glUniform1i(1, world.getWidth());
+        glUniform1f(2, c_worldScale);
+    }
+    if (!c_streaming && c_meshFormat == MeshFormat::HeightTexture)
+    {
+        glUniform1f(1, c_worldScale);
+        glUniform1i(2, c_gridTileSize);
+        glUniform1i(3, gridTileCountX);
+        uploadHeightTexture(heightTexture);
+    }
 
     double lastTime = 0.0;
+    std::vector<std::shared_ptr<const TerrainChunk>> readyChunks;
+    std::vector<int64_t> evictedChunks;
+    std::vector<const ChunkBuffers*> residentChunks;
+    BoxList chunkBoxes;
+    std::vector<uint8_t> visible;
+    CullingStats cullingStats;
+    double lastTitleTime = 0.0;
+    IndexedMesh editMesh;
+    std::vector<BufferRange> editRanges;
+    bool craterKeyDown = false;
+    bool flattenKeyDown = false;
+    world.clearDirty();
 
     while (!glfwWindowShouldClose(window))
     {
+        TRACE_SCOPE("frame");
         double currentTime = glfwGetTime();
         double deltaTime = currentTime - lastTime;
         lastTime = currentTime;
 
         processInput(window, static_cast<float>(deltaTime));
+        if (pyramid)
+        {
+            // Keep the camera above the ground
+            Transformation& transformation = g_camera.getTransformation();
+            glm::vec3& position = transformation.position;
+            if (pyramid->contains(position.x, position.z))
+            {
+                float ground = pyramid->getSurfaceHeight(position.x, position.z) + c_cameraGroundClearance;
+                if (position.y < ground)
+                {
+                    position.y = ground;
+                    transformation.updateModelMatrix();
+                }
+            }
+        }
+        if (!c_streaming && (c_meshFormat == MeshFormat::Indexed || c_meshFormat == MeshFormat::HeightTexture))
+        {
+            // Edits at the terrain point in the middle of the view
+            bool crater = wasKeyPressed(window, GLFW_KEY_C, craterKeyDown);
+            bool flatten = wasKeyPressed(window, GLFW_KEY_F, flattenKeyDown);
+            int sampleX = 0;
+            int sampleY = 0;
+            if (crater || flatten)
+            {
+                const Transformation& transformation = g_camera.getTransformation();
+                glm::vec3 forward = transformation.getForward();
+                float distance = 0.0f;
+                if (pyramid->intersectRay(transformation.position, forward, c_pickDistance, distance))
+                {
+                    glm::vec3 target = transformation.position + forward * distance;
+                    sampleX = std::min(std::max(static_cast<int>(std::lround(target.x / c_worldScale)), 0), world.getWidth() - 1);
+                    sampleY = std::min(std::max(static_cast<int>(std::lround(target.z / c_worldScale)), 0), world.getHeight() - 1);
+                }
+                else
+                {
+                    crater = false;
+                    flatten = false;
+                }
+            }
+            if ((crater || flatten) && c_meshFormat == MeshFormat::Indexed && editMesh.vertices.empty())
+            {
+                // The uploaded mesh may be mapped from the cache, edits need a copy of their own
+                generateIndexedMesh(world, editMesh);
+            }
+            if (crater)
+            {
+                createCrater(world, sampleX, sampleY, c_craterRadius, c_craterDepth);
+            }
+            if (flatten)
+            {
+                flattenArea(world, sampleX, sampleY, c_flattenRadius, world.at(sampleX, sampleY));
+            }
+            for (const DirtyRect& rect : world.getDirtyRects())
+            {
+                pyramid->updateRegion(rect);
+            }
+            if (!world.getDirtyRects().empty() && c_meshFormat == MeshFormat::HeightTexture)
+            {
+                updateTerrainTexture(world, heightTexture);
+            }
+            else if (!world.getDirtyRects().empty())
+            {
+                updateTerrain(world, editMesh, vertexBuffer, geomipmap.get(), lodBoxes, editRanges);
+                lodIndices.clear();
+            }
+        }
         glClearColor(0.0f, 0.0f, 0.2f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -307,15 +575,141 @@ int main()
         glm::mat4 mvp = g_camera.getProjectionMatrix() * g_camera.getViewMatrix();
         glUniformMatrix4fv(0, 1, GL_FALSE, &mvp[0][0]);
 
-        glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(indices.size()), GL_UNSIGNED_INT, 0);
+        if (c_streaming)
+        {
+            TRACE_SCOPE("streaming");
+            const glm::vec3& position = g_camera.getTransformation().position;
+            readyChunks.clear();
+            evictedChunks.clear();
+            streamer->update(position.x, position.z, readyChunks, evictedChunks);
+            for (const std::shared_ptr<const TerrainChunk>& chunk : readyChunks)
+            {
+                uploadChunk(*chunk, chunkBuffers[TerrainStreamer::getChunkKey(chunk->x, chunk->z)]);
+            }
+            for (int64_t key : evictedChunks)
+            {
+                auto found = chunkBuffers.find(key);
+                if (found != chunkBuffers.end())
+                {
+                    deleteChunk(found->second);
+                    chunkBuffers.erase(found);
+                }
+            }
+            TRACE_COUNTER("residentChunks", chunkBuffers.size());
+
+            residentChunks.clear();
+            chunkBoxes.clear();
+            for (const auto& entry : chunkBuffers)
+            {
+                residentChunks.push_back(&entry.second);
+                chunkBoxes.add(entry.second.boundsMin, entry.second.boundsMax);
+            }
+            cullTerrain(mvp, chunkBoxes, visible, cullingStats);
+
+            for (size_t i = 0; i < residentChunks.size(); ++i)
+            {
+                if (!visible[i])
+                {
+                    continue;
+                }
+                const ChunkBuffers& buffers = *residentChunks[i];
+                glm::mat4 chunkMvp = mvp * buffers.model;
+                glUniformMatrix4fv(0, 1, GL_FALSE, &chunkMvp[0][0]);
+                glBindVertexArray(buffers.vertexArray);
+                for (const TerrainDraw& draw : buffers.draws)
+                {
+                    glDrawElementsBaseVertex(GL_TRIANGLES, draw.indexCount, draw.indexType, (void*)draw.indexOffset, draw.baseVertex);
+                }
+            }
+            glBindVertexArray(vertexArray);
+        }
 
+        if (geomipmap)
+        {
+            TRACE_SCOPE("lod");
+            float pixelScale = Geomipmap::getPixelScale(g_camera.getProjectionMatrix(), c_screenHeight);
+            if (geomipmap->selectLevels(g_camera.getTransformation().position, pixelScale, c_lodPixelError) || lodIndices.empty())
+            {
+                TRACE_SCOPE("uploadLodIndices");
+                geomipmap->buildIndices(lodIndices, lodPatchOffsets);
+                glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint32_t) * lodIndices.size(), lodIndices.data(), GL_STREAM_DRAW);
+            }
+
+            cullTerrain(mvp, lodBoxes, visible, cullingStats);
+            draws.clear();
+            for (size_t i = 0; i < lodBoxes.size(); ++i)
+            {
+                if (!visible[i])
+                {
+                    continue;
+                }
+                GLsizei indexCount = static_cast<GLsizei>(lodPatchOffsets[i + 1] - lodPatchOffsets[i]);
+                size_t indexOffset = lodPatchOffsets[i] * sizeof(uint32_t);
+                // Visible patches next to each other in the index buffer share a draw
+                if (!draws.empty() && draws.back().indexOffset + draws.back().indexCount * sizeof(uint32_t) == indexOffset)
+                {
+                    draws.back().indexCount += indexCount;
+                }
+                else
+                {
+                    draws.push_back({indexCount, GL_UNSIGNED_INT, indexOffset, 0, 0, 0.0f, 0.0f});
+                }
+            }
+        }
+
+        if ((c_streaming || geomipmap) && currentTime - lastTitleTime > 1.0)
+        {
+            lastTitleTime = currentTime;
+            std::string title = "GL - culled " + std::to_string(cullingStats.frustumCulled) + " by frustum, " +
+                                std::to_string(cullingStats.horizonCulled) + " by horizon of " + std::to_string(cullingStats.tested) +
+                                " in " + std::to_string(cullingStats.seconds * 1000.0) + " ms";
+            glfwSetWindowTitle(window, title.c_str());
+        }
+
+        TRACE_COUNTER("frustumCulled", cullingStats.frustumCulled);
+        TRACE_COUNTER("horizonCulled", cullingStats.horizonCulled);
+        {
+            TRACE_SCOPE("draw");
+            for (const TerrainDraw& draw : draws)
+            {
+                if (c_meshFormat == MeshFormat::Packed)
+                {
+                    glUniform1i(3, draw.firstRow);
+                    glUniform1i(4, draw.baseVertex);
+                    glUniform1f(5, draw.minHeight);
+                    glUniform1f(6, draw.heightStep);
+                }
+                if (c_meshFormat == MeshFormat::HeightTexture)
+                {
+                    glDrawElementsInstanced(GL_TRIANGLES, draw.indexCount, draw.indexType, (void*)draw.indexOffset, gridInstanceCount);
+                    continue;
+                }
+                glDrawElementsBaseVertex(GL_TRIANGLES, draw.indexCount, draw.indexType, (void*)draw.indexOffset, draw.baseVertex);
+            }
+        }
+
+        TRACE_SCOPE("swap");
         glfwSwapBuffers(window);
         glfwPollEvents();
     }
 
+    if (TRACE_WRITE(c_traceFilename))
+    {
+        std::cout << "Trace written to " << c_traceFilename << "\n";
+    }
+
     glDeleteVertexArrays(1, &vertexArray);
     glDeleteBuffers(1, &indexBuffer);
     glDeleteBuffers(1, &vertexBuffer);
+    if (heightTextureObject != 0)
+    {
+        glDeleteTextures(1, &heightTextureObject);
+    }
+    for (auto& entry : chunkBuffers)
+    {
+        deleteChunk(entry.second);
+    }
+    streamer.reset();
 
     glfwTerminate();
     return 0;
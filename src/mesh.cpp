@@ -0,0 +1,622 @@
+#include "mesh.h"
+#include "constants.h"
+#include "parallel.h"
+#include "trace.h"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+void writeVec3(float* out, const glm::vec3& v)
+{
+    out[0] = v.x;
+    out[1] = v.y;
+    out[2] = v.z;
+}
+
+// Three vertices of position and face normal
+float* writeTriangle(float* out, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c)
+{
+    glm::vec3 normal = glm::normalize(glm::cross(c - a, b - a));
+    writeVec3(out, a);
+    writeVec3(out + 3, normal);
+    writeVec3(out + 6, b);
+    writeVec3(out + 9, normal);
+    writeVec3(out + 12, c);
+    writeVec3(out + 15, normal);
+    return out + 18;
+}
+} // namespace
+
+void generateMesh(const Heightfield& world, std::vector<int>& indices, std::vector<float>& vertices, int threadCount)
+{
+    TRACE_SCOPE("generateMesh");
+    const int verticesPerSquare = 6;
+    const int floatsPerVertex = 6;
+    int columns = world.getWidth() - 1;
+    int rows = world.getHeight() - 1;
+    size_t rowVertices = static_cast<size_t>(columns) * verticesPerSquare;
+
+    indices.resize(rowVertices * rows);
+    vertices.resize(rowVertices * rows * floatsPerVertex);
+
+    // Every band writes its own rows of the presized output
+    int bandCount = (rows + c_meshBandHeight - 1) / c_meshBandHeight;
+    parallelFor(bandCount, threadCount, [&](int band) {
+        TRACE_SCOPE("meshBand");
+        int firstRow = band * c_meshBandHeight;
+        int lastRow = std::min(firstRow + c_meshBandHeight, rows);
+        float* vertex = &vertices[rowVertices * firstRow * floatsPerVertex];
+        for (int h = firstRow; h < lastRow; ++h)
+        {
+            for (int w = 0; w < columns; ++w)
+            {
+                float x = static_cast<float>(w) * c_worldScale;
+                float z = static_cast<float>(h) * c_worldScale;
+                float topLeft = world.at(w, h);
+                float topRight = world.at(w + 1, h);
+                float bottomLeft = world.at(w, h + 1);
+                float bottomRight = world.at(w + 1, h + 1);
+
+                // First triangle
+                vertex = writeTriangle(vertex, glm::vec3(x, topLeft, z), glm::vec3(x + c_worldScale, topRight, z), glm::vec3(x, bottomLeft, z + c_worldScale));
+
+                // Second triangle
+                vertex = writeTriangle(vertex, glm::vec3(x + c_worldScale, topRight, z), glm::vec3(x + c_worldScale, bottomRight, z + c_worldScale),
+                                       glm::vec3(x, bottomLeft, z + c_worldScale));
+            }
+        }
+
+        size_t firstIndex = rowVertices * firstRow;
+        size_t lastIndex = rowVertices * lastRow;
+        for (size_t i = firstIndex; i < lastIndex; ++i)
+        {
+            indices[i] = static_cast<int>(i);
+        }
+    });
+}
+
+size_t IndexedMesh::getVertexCount() const
+{
+    return vertices.size() / 6;
+}
+
+size_t IndexedMesh::getIndexCount() const
+{
+    return wideIndices ? indices32.size() : indices16.size();
+}
+
+size_t IndexedMesh::getMemoryUsage() const
+{
+    return vertices.size() * sizeof(float) + indices16.size() * sizeof(uint16_t) + indices32.size() * sizeof(uint32_t);
+}
+
+IndexedMeshView getMeshView(const IndexedMesh& mesh)
+{
+    IndexedMeshView view;
+    view.vertices = mesh.vertices.data();
+    view.vertexFloatCount = mesh.vertices.size();
+    view.wideIndices = mesh.wideIndices;
+    view.indices = mesh.wideIndices ? static_cast<const void*>(mesh.indices32.data()) : mesh.indices16.data();
+    view.indexCount = mesh.getIndexCount();
+    view.chunks = mesh.chunks.data();
+    view.chunkCount = mesh.chunks.size();
+    return view;
+}
+
+void getSampleNormal(const Heightfield& world, int x, int y, float normal[3])
+{
+    int left = std::max(x - 1, 0);
+    int right = std::min(x + 1, world.getWidth() - 1);
+    int up = std::max(y - 1, 0);
+    int down = std::min(y + 1, world.getHeight() - 1);
+
+    // Gradient scaled by the sample spacing so that the normal points up
+    float dx = (world.at(right, y) - world.at(left, y)) / static_cast<float>(right - left);
+    float dz = (world.at(x, down) - world.at(x, up)) / static_cast<float>(down - up);
+    glm::vec3 n = glm::normalize(glm::vec3(-dx, c_worldScale, -dz));
+    normal[0] = n.x;
+    normal[1] = n.y;
+    normal[2] = n.z;
+}
+
+void updateIndexedMesh(const Heightfield& world, IndexedMesh& mesh, std::vector<BufferRange>& changed)
+{
+    TRACE_SCOPE("updateIndexedMesh");
+    int width = world.getWidth();
+    const size_t vertexSize = 6 * sizeof(float);
+    for (const DirtyRect& rect : world.getDirtyRects())
+    {
+        // Normals use the neighboring samples
+        int minX = std::max(rect.minX - 1, 0);
+        int maxX = std::min(rect.maxX + 1, width - 1);
+        int minY = std::max(rect.minY - 1, 0);
+        int maxY = std::min(rect.maxY + 1, world.getHeight() - 1);
+        for (int y = minY; y <= maxY; ++y)
+        {
+            size_t first = static_cast<size_t>(y) * width + minX;
+            float* vertex = &mesh.vertices[first * 6];
+            for (int x = minX; x <= maxX; ++x)
+            {
+                vertex[1] = world.at(x, y);
+                getSampleNormal(world, x, y, vertex + 3);
+                vertex += 6;
+            }
+
+            BufferRange range = {first * vertexSize, static_cast<size_t>(maxX - minX + 1) * vertexSize};
+            if (!changed.empty() && changed.back().offset + changed.back().size == range.offset)
+            {
+                changed.back().size += range.size;
+            }
+            else
+            {
+                changed.push_back(range);
+            }
+        }
+    }
+}
+
+template<typename Index>
+void addChunkIndices(std::vector<Index>& indices, int width, int firstRow, int lastRow)
+{
+    // Columns are walked in narrow strips so that the vertices shared with
+    // the previous row of quads are still in the post-transform cache
+    int columns = width - 1;
+    for (int stripStart = 0; stripStart < columns; stripStart += c_meshStripWidth)
+    {
+        int stripEnd = std::min(stripStart + c_meshStripWidth, columns);
+        for (int h = firstRow; h < lastRow; ++h)
+        {
+            for (int w = stripStart; w < stripEnd; ++w)
+            {
+                Index topLeft = static_cast<Index>((h - firstRow) * width + w);
+                Index bottomLeft = static_cast<Index>(topLeft + width);
+
+                // Same winding as generateMesh
+                indices.push_back(topLeft);
+                indices.push_back(static_cast<Index>(topLeft + 1));
+                indices.push_back(bottomLeft);
+
+                indices.push_back(static_cast<Index>(topLeft + 1));
+                indices.push_back(static_cast<Index>(bottomLeft + 1));
+                indices.push_back(bottomLeft);
+            }
+        }
+    }
+}
+
+int getRowsPerShortChunk(int width)
+{
+    const int maxShortVertices = 65536;
+    return maxShortVertices / width - 1;
+}
+
+void generateIndexedMesh(const Heightfield& world, IndexedMesh& mesh, int apron)
+{
+    TRACE_SCOPE("generateIndexedMesh");
+    int width = world.getWidth() - 2 * apron;
+    int height = world.getHeight() - 2 * apron;
+
+    mesh.vertices.resize(static_cast<size_t>(width) * height * 6);
+    for (int y = 0; y < height; ++y)
+    {
+        float* vertex = &mesh.vertices[static_cast<size_t>(y) * width * 6];
+        for (int x = 0; x < width; ++x)
+        {
+            vertex[0] = static_cast<float>(x) * c_worldScale;
+            vertex[1] = world.at(x + apron, y + apron);
+            vertex[2] = static_cast<float>(y) * c_worldScale;
+            getSampleNormal(world, x + apron, y + apron, vertex + 3);
+            vertex += 6;
+        }
+    }
+
+    // Chunks share their boundary row of vertices with the next chunk
+    int rowsPerChunk = getRowsPerShortChunk(width);
+    mesh.wideIndices = rowsPerChunk < 1;
+    if (mesh.wideIndices)
+    {
+        rowsPerChunk = height - 1;
+    }
+
+    mesh.indices16.clear();
+    mesh.indices32.clear();
+    mesh.chunks.clear();
+    size_t quadCount = static_cast<size_t>(width - 1) * (height - 1);
+    if (mesh.wideIndices)
+    {
+        mesh.indices32.reserve(quadCount * 6);
+    }
+    else
+    {
+        mesh.indices16.reserve(quadCount * 6);
+    }
+
+    for (int firstRow = 0; firstRow < height - 1; firstRow += rowsPerChunk)
+    {
+        int lastRow = std::min(firstRow + rowsPerChunk, height - 1);
+        MeshChunk chunk;
+        chunk.baseVertex = firstRow * width;
+        chunk.firstIndex = mesh.getIndexCount();
+        if (mesh.wideIndices)
+        {
+            addChunkIndices(mesh.indices32, width, firstRow, lastRow);
+        }
+        else
+        {
+            addChunkIndices(mesh.indices16, width, firstRow, lastRow);
+        }
+        chunk.indexCount = static_cast<int>(mesh.getIndexCount() - chunk.firstIndex);
+        mesh.chunks.push_back(chunk);
+    }
+}
+
+size_t PackedMesh::getVertexCount() const
+{
+    return stride > 0 ? vertices.size() / stride : 0;
+}
+
+size_t PackedMesh::getIndexCount() const
+{
+    return wideIndices ? indices32.size() : indices16.size();
+}
+
+size_t PackedMesh::getMemoryUsage() const
+{
+    return vertices.size() + indices16.size() * sizeof(uint16_t) + indices32.size() * sizeof(uint32_t) + chunks.size() * sizeof(PackedChunk);
+}
+
+void encodeOctahedral(const float normal[3], int bits, uint32_t& u, uint32_t& v)
+{
+    float length = std::abs(normal[0]) + std::abs(normal[1]) + std::abs(normal[2]);
+    float px = normal[0] / length;
+    float pz = normal[2] / length;
+    if (normal[1] < 0.0f)
+    {
+        float fx = (1.0f - std::abs(pz)) * (px >= 0.0f ? 1.0f : -1.0f);
+        float fz = (1.0f - std::abs(px)) * (pz >= 0.0f ? 1.0f : -1.0f);
+        px = fx;
+        pz = fz;
+    }
+    float maxValue = static_cast<float>((1u << bits) - 1);
+    u = static_cast<uint32_t>(std::floor((px * 0.5f + 0.5f) * maxValue + 0.5f));
+    v = static_cast<uint32_t>(std::floor((pz * 0.5f + 0.5f) * maxValue + 0.5f));
+}
+
+void decodeOctahedral(uint32_t u, uint32_t v, int bits, float normal[3])
+{
+    float maxValue = static_cast<float>((1u << bits) - 1);
+    glm::vec3 n(static_cast<float>(u) / maxValue * 2.0f - 1.0f, 0.0f, static_cast<float>(v) / maxValue * 2.0f - 1.0f);
+    n.y = 1.0f - std::abs(n.x) - std::abs(n.z);
+    if (n.y < 0.0f)
+    {
+        float fx = (1.0f - std::abs(n.z)) * (n.x >= 0.0f ? 1.0f : -1.0f);
+        float fz = (1.0f - std::abs(n.x)) * (n.z >= 0.0f ? 1.0f : -1.0f);
+        n.x = fx;
+        n.z = fz;
+    }
+    n = glm::normalize(n);
+    normal[0] = n.x;
+    normal[1] = n.y;
+    normal[2] = n.z;
+}
+
+// Smallest power of two step that covers the range with 16 bits. The lower
+// bound keeps minHeight / step below 2^24 so that decoding stays exact.
+float getHeightStep(float range)
+{
+    const float maxQuantized = 65535.0f;
+    float step = std::ldexp(1.0f, -20);
+    while (range / step > maxQuantized)
+    {
+        step *= 2.0f;
+    }
+    return step;
+}
+
+void generatePackedMesh(const Heightfield& world, int normalBits, PackedMesh& mesh)
+{
+    TRACE_SCOPE("generatePackedMesh");
+    int width = world.getWidth();
+    int height = world.getHeight();
+    int rowsPerChunk = std::max(getRowsPerShortChunk(width), 1);
+    int chunkCount = (height - 2) / rowsPerChunk + 1;
+
+    mesh.width = width;
+    mesh.normalBits = normalBits;
+    mesh.stride = normalBits == 16 ? 8 : 4;
+    mesh.wideIndices = getRowsPerShortChunk(width) < 1;
+    mesh.indices16.clear();
+    mesh.indices32.clear();
+    mesh.chunks.resize(chunkCount);
+
+    std::vector<float> minHeights(chunkCount);
+    std::vector<float> maxHeights(chunkCount);
+    std::vector<float> steps(chunkCount);
+    for (int c = 0; c < chunkCount; ++c)
+    {
+        PackedChunk& chunk = mesh.chunks[c];
+        chunk.firstRow = c * rowsPerChunk;
+        int lastRow = std::min(chunk.firstRow + rowsPerChunk, height - 1);
+        minHeights[c] = world.at(0, chunk.firstRow);
+        maxHeights[c] = minHeights[c];
+        for (int y = chunk.firstRow; y <= lastRow; ++y)
+        {
+            for (int x = 0; x < width; ++x)
+            {
+                minHeights[c] = std::min(minHeights[c], world.at(x, y));
+                maxHeights[c] = std::max(maxHeights[c], world.at(x, y));
+            }
+        }
+        steps[c] = getHeightStep(maxHeights[c] - minHeights[c]);
+    }
+
+    // The chunk minimum is aligned to the coarsest neighboring step so that
+    // snapped boundary heights are representable in both chunks. Aligning can
+    // grow the range and the step, so repeat until nothing changes.
+    auto getAlignmentStep = [&](int c) {
+        float step = steps[c];
+        step = c > 0 ? std::max(step, steps[c - 1]) : step;
+        step = c + 1 < chunkCount ? std::max(step, steps[c + 1]) : step;
+        return step;
+    };
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (int c = 0; c < chunkCount; ++c)
+        {
+            float alignment = getAlignmentStep(c);
+            float alignedMin = std::floor(minHeights[c] / alignment) * alignment;
+            float step = getHeightStep(maxHeights[c] - alignedMin);
+            if (step > steps[c])
+            {
+                steps[c] = step;
+                changed = true;
+            }
+        }
+    }
+
+    size_t vertexCount = 0;
+    for (int c = 0; c < chunkCount; ++c)
+    {
+        PackedChunk& chunk = mesh.chunks[c];
+        float alignment = getAlignmentStep(c);
+        chunk.minHeight = std::floor(minHeights[c] / alignment) * alignment;
+        chunk.heightStep = steps[c];
+        chunk.baseVertex = static_cast<int>(vertexCount);
+        int lastRow = std::min(chunk.firstRow + rowsPerChunk, height - 1);
+        vertexCount += static_cast<size_t>(lastRow - chunk.firstRow + 1) * width;
+    }
+    mesh.vertices.resize(vertexCount * mesh.stride);
+
+    for (int c = 0; c < chunkCount; ++c)
+    {
+        PackedChunk& chunk = mesh.chunks[c];
+        int lastRow = std::min(chunk.firstRow + rowsPerChunk, height - 1);
+        for (int y = chunk.firstRow; y <= lastRow; ++y)
+        {
+            // Boundary rows use the coarser step of the two chunks sharing them
+            float snapStep = 0.0f;
+            if (y == chunk.firstRow && c > 0)
+            {
+                snapStep = std::max(steps[c], steps[c - 1]);
+            }
+            if (y == lastRow && c + 1 < chunkCount)
+            {
+                snapStep = std::max(steps[c], steps[c + 1]);
+            }
+
+            uint8_t* vertex = &mesh.vertices[(chunk.baseVertex + static_cast<size_t>(y - chunk.firstRow) * width) * mesh.stride];
+            for (int x = 0; x < width; ++x)
+            {
+                float h = world.at(x, y);
+                float quantized = 0.0f;
+                if (snapStep > 0.0f)
+                {
+                    quantized = (std::floor(h / snapStep) * snapStep - chunk.minHeight) / chunk.heightStep;
+                }
+                else
+                {
+                    quantized = std::floor((h - chunk.minHeight) / chunk.heightStep + 0.5f);
+                }
+                uint16_t packedHeight = static_cast<uint16_t>(std::min(std::max(quantized, 0.0f), 65535.0f));
+
+                float normal[3];
+                getSampleNormal(world, x, y, normal);
+                uint32_t u = 0;
+                uint32_t v = 0;
+                encodeOctahedral(normal, normalBits, u, v);
+
+                std::memcpy(vertex, &packedHeight, sizeof(packedHeight));
+                if (normalBits == 16)
+                {
+                    uint16_t packedNormal[2] = {static_cast<uint16_t>(u), static_cast<uint16_t>(v)};
+                    std::memcpy(vertex + 2, packedNormal, sizeof(packedNormal));
+                }
+                else
+                {
+                    vertex[2] = static_cast<uint8_t>(u);
+                    vertex[3] = static_cast<uint8_t>(v);
+                }
+                vertex += mesh.stride;
+            }
+        }
+
+        chunk.firstIndex = mesh.getIndexCount();
+        if (mesh.wideIndices)
+        {
+            addChunkIndices(mesh.indices32, width, chunk.firstRow, lastRow);
+        }
+        else
+        {
+            addChunkIndices(mesh.indices16, width, chunk.firstRow, lastRow);
+        }
+        chunk.indexCount = static_cast<int>(mesh.getIndexCount() - chunk.firstIndex);
+    }
+}
+
+void unpackVertex(const PackedMesh& mesh, const PackedChunk& chunk, int localVertex, float position[3], float normal[3])
+{
+    const uint8_t* vertex = &mesh.vertices[(static_cast<size_t>(chunk.baseVertex) + localVertex) * mesh.stride];
+    uint16_t packedHeight;
+    std::memcpy(&packedHeight, vertex, sizeof(packedHeight));
+    uint32_t u = 0;
+    uint32_t v = 0;
+    if (mesh.normalBits == 16)
+    {
+        uint16_t packedNormal[2];
+        std::memcpy(packedNormal, vertex + 2, sizeof(packedNormal));
+        u = packedNormal[0];
+        v = packedNormal[1];
+    }
+    else
+    {
+        u = vertex[2];
+        v = vertex[3];
+    }
+
+    int x = localVertex % mesh.width;
+    int y = chunk.firstRow + localVertex / mesh.width;
+    position[0] = static_cast<float>(x) * c_worldScale;
+    position[1] = chunk.minHeight + static_cast<float>(packedHeight) * chunk.heightStep;
+    position[2] = static_cast<float>(y) * c_worldScale;
+    decodeOctahedral(u, v, mesh.normalBits, normal);
+}
+
+const void* HeightTexture::getTexels() const
+{
+    return bits == 16 ? static_cast<const void*>(texels16.data()) : texels32.data();
+}
+
+size_t HeightTexture::getTexelSize() const
+{
+    return bits == 16 ? sizeof(uint16_t) : sizeof(float);
+}
+
+size_t HeightTexture::getMemoryUsage() const
+{
+    return static_cast<size_t>(width) * height * getTexelSize();
+}
+
+float HeightTexture::getHeight(int x, int y) const
+{
+    size_t texel = static_cast<size_t>(y) * width + x;
+    if (bits == 16)
+    {
+        return heightOffset + heightScale * (static_cast<float>(texels16[texel]) / 65535.0f);
+    }
+    return heightOffset + heightScale * texels32[texel];
+}
+
+void generateHeightTexture(const Heightfield& world, int bits, HeightTexture& texture)
+{
+    TRACE_SCOPE("generateHeightTexture");
+    texture.width = world.getWidth();
+    texture.height = world.getHeight();
+    texture.bits = bits;
+    texture.texels32.clear();
+    texture.texels16.clear();
+    if (bits == 16)
+    {
+        float minHeight = world.at(0, 0);
+        float maxHeight = minHeight;
+        for (int y = 0; y < texture.height; ++y)
+        {
+            for (int x = 0; x < texture.width; ++x)
+            {
+                minHeight = std::min(minHeight, world.at(x, y));
+                maxHeight = std::max(maxHeight, world.at(x, y));
+            }
+        }
+        texture.heightOffset = minHeight;
+        texture.heightScale = getHeightStep(maxHeight - minHeight) * 65535.0f;
+        texture.texels16.resize(static_cast<size_t>(texture.width) * texture.height);
+    }
+    else
+    {
+        texture.heightOffset = 0.0f;
+        texture.heightScale = 1.0f;
+        texture.texels32.resize(static_cast<size_t>(texture.width) * texture.height);
+    }
+    updateHeightTexture(world, {0, 0, texture.width - 1, texture.height - 1}, texture);
+}
+
+bool updateHeightTexture(const Heightfield& world, const DirtyRect& rect, HeightTexture& texture)
+{
+    if (texture.bits != 16)
+    {
+        for (int y = rect.minY; y <= rect.maxY; ++y)
+        {
+            float* texel = &texture.texels32[static_cast<size_t>(y) * texture.width + rect.minX];
+            for (int x = rect.minX; x <= rect.maxX; ++x)
+            {
+                *texel++ = world.at(x, y);
+            }
+        }
+        return true;
+    }
+
+    float step = texture.heightScale / 65535.0f;
+    for (int y = rect.minY; y <= rect.maxY; ++y)
+    {
+        uint16_t* texel = &texture.texels16[static_cast<size_t>(y) * texture.width + rect.minX];
+        for (int x = rect.minX; x <= rect.maxX; ++x)
+        {
+            float quantized = std::floor((world.at(x, y) - texture.heightOffset) / step + 0.5f);
+            if (quantized < 0.0f || quantized > 65535.0f)
+            {
+                return false;
+            }
+            *texel++ = static_cast<uint16_t>(quantized);
+        }
+    }
+    return true;
+}
+
+void generateGridMesh(int tileSize, std::vector<uint16_t>& vertices, std::vector<uint16_t>& indices)
+{
+    int width = tileSize + 1;
+    vertices.clear();
+    vertices.reserve(static_cast<size_t>(width) * width * 2);
+    for (int y = 0; y < width; ++y)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            vertices.push_back(static_cast<uint16_t>(x));
+            vertices.push_back(static_cast<uint16_t>(y));
+        }
+    }
+    indices.clear();
+    addChunkIndices(indices, width, 0, tileSize);
+}
+
+int getGridTileCount(const HeightTexture& texture, int tileSize, int& tileCountX)
+{
+    tileCountX = (texture.width - 2) / tileSize + 1;
+    int tileCountY = (texture.height - 2) / tileSize + 1;
+    return tileCountX * tileCountY;
+}
+
+void getHeightTextureVertex(const HeightTexture& texture, int x, int y, float position[3], float normal[3])
+{
+    int left = std::max(x - 1, 0);
+    int right = std::min(x + 1, texture.width - 1);
+    int up = std::max(y - 1, 0);
+    int down = std::min(y + 1, texture.height - 1);
+
+    // Same gradient as getSampleNormal
+    float dx = (texture.getHeight(right, y) - texture.getHeight(left, y)) / static_cast<float>(right - left);
+    float dz = (texture.getHeight(x, down) - texture.getHeight(x, up)) / static_cast<float>(down - up);
+    glm::vec3 n = glm::normalize(glm::vec3(-dx, c_worldScale, -dz));
+    position[0] = static_cast<float>(x) * c_worldScale;
+    position[1] = texture.getHeight(x, y);
+    position[2] = static_cast<float>(y) * c_worldScale;
+    normal[0] = n.x;
+    normal[1] = n.y;
+    normal[2] = n.z;
+}
@@ -0,0 +1,421 @@
+#include "outOfCore.h"
+#include "parallel.h"
+#include "trace.h"
+#include "functions.h"
+#include "constants.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+
+namespace
+{
+int getTileWidth(const TileGrid& grid, int tileX)
+{
+    return std::min(grid.tileSize, grid.worldWidth - tileX * grid.tileSize) + 1;
+}
+
+int getTileHeight(const TileGrid& grid, int tileY)
+{
+    return std::min(grid.tileSize, grid.worldHeight - tileY * grid.tileSize) + 1;
+}
+
+size_t getBinMemory(const std::vector<std::vector<uint32_t>>& bins)
+{
+    size_t bytes = bins.size() * sizeof(std::vector<uint32_t>);
+    for (const std::vector<uint32_t>& bin : bins)
+    {
+        bytes += bin.capacity() * sizeof(uint32_t);
+    }
+    return bytes;
+}
+
+// Upper and lower bound of the heights from the peaks of the bumps reaching each tile
+void getHeightBounds(const std::vector<Bump>& bumps, const std::vector<std::vector<uint32_t>>& bins, float& minHeight, float& maxHeight)
+{
+    minHeight = 0.0f;
+    maxHeight = 0.0f;
+    for (const std::vector<uint32_t>& bin : bins)
+    {
+        float low = 0.0f;
+        float high = 0.0f;
+        for (uint32_t index : bin)
+        {
+            const Bump& bump = bumps[index];
+            float peak = normalDistribution(0.0f, bump.deviation, 0.0f) * bump.multiplier;
+            (peak < 0.0f ? low : high) += peak;
+        }
+        minHeight = std::min(minHeight, low);
+        maxHeight = std::max(maxHeight, high);
+    }
+}
+
+bool openFile(const std::string& filename, std::ofstream& file)
+{
+    file.open(filename.c_str(), std::ios::binary);
+    if (!file)
+    {
+        std::cerr << "ERROR: Could not open file: " << filename << "\n";
+        return false;
+    }
+    return true;
+}
+
+// Samples of the tile without its apron as 16-bit little-endian texels, row by row
+bool writeRaw16(const std::string& filename, const Heightfield& tile, int apron, float heightOffset, float heightStep, std::vector<uint16_t>& row)
+{
+    std::ofstream file;
+    if (!openFile(filename, file))
+    {
+        return false;
+    }
+    int width = tile.getWidth() - 2 * apron;
+    int height = tile.getHeight() - 2 * apron;
+    row.resize(width);
+    for (int y = 0; y < height; ++y)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            float texel = std::floor((tile.at(x + apron, y + apron) - heightOffset) / heightStep + 0.5f);
+            uint16_t value = static_cast<uint16_t>(std::min(std::max(texel, 0.0f), 65535.0f));
+            reinterpret_cast<uint8_t*>(&row[x])[0] = static_cast<uint8_t>(value & 0xff);
+            reinterpret_cast<uint8_t*>(&row[x])[1] = static_cast<uint8_t>(value >> 8);
+        }
+        file.write(reinterpret_cast<const char*>(row.data()), sizeof(uint16_t) * row.size());
+    }
+    return static_cast<bool>(file);
+}
+
+uint64_t getFileSize(const std::string& filename)
+{
+    std::ifstream file(filename.c_str(), std::ios::binary | std::ios::ate);
+    return file ? static_cast<uint64_t>(file.tellg()) : 0;
+}
+
+// Buffers of one export thread, reused from tile to tile
+struct TileBuffers
+{
+    Heightfield tile;
+    std::vector<Bump> scratch;
+    IndexedMesh mesh;
+    std::vector<uint16_t> row;
+};
+} // namespace
+
+int TileGrid::getTileCount() const
+{
+    return tileCountX * tileCountY;
+}
+
+TileGrid getTileGrid(const WorldParams& params, int tileSize)
+{
+    TileGrid grid;
+    grid.worldWidth = params.width;
+    grid.worldHeight = params.height;
+    grid.tileSize = tileSize;
+    grid.tileCountX = (params.width + tileSize - 1) / tileSize;
+    grid.tileCountY = (params.height + tileSize - 1) / tileSize;
+    return grid;
+}
+
+void binBumps(const std::vector<Bump>& bumps, const TileGrid& grid, std::vector<std::vector<uint32_t>>& bins)
+{
+    TRACE_SCOPE("binBumps");
+    bins.assign(grid.getTileCount(), std::vector<uint32_t>());
+
+    // Tile x covers samples [x * tileSize - apron, (x + 1) * tileSize + apron]
+    const int apron = c_outOfCoreApron;
+    int size = grid.tileSize;
+    for (size_t i = 0; i < bumps.size(); ++i)
+    {
+        const Bump& bump = bumps[i];
+        int limit = static_cast<int>(bump.deviation * c_standardDeviationArea);
+        int firstX = std::max(-floorDivide(-(bump.x - limit - apron - size), size), 0);
+        int lastX = std::min(floorDivide(bump.x + limit + apron, size), grid.tileCountX - 1);
+        int firstY = std::max(-floorDivide(-(bump.y - limit - apron - size), size), 0);
+        int lastY = std::min(floorDivide(bump.y + limit + apron, size), grid.tileCountY - 1);
+        for (int y = firstY; y <= lastY; ++y)
+        {
+            for (int x = firstX; x <= lastX; ++x)
+            {
+                bins[static_cast<size_t>(y) * grid.tileCountX + x].push_back(static_cast<uint32_t>(i));
+            }
+        }
+    }
+}
+
+void generateTile(const TileGrid& grid, int tileX, int tileY, const std::vector<Bump>& bumps, const std::vector<uint32_t>& bin, Heightfield& tile,
+                  std::vector<Bump>& scratch)
+{
+    TRACE_SCOPE("generateTile");
+    const int apron = c_outOfCoreApron;
+    int width = getTileWidth(grid, tileX) + 2 * apron;
+    int height = getTileHeight(grid, tileY) + 2 * apron;
+    if (tile.getWidth() != width || tile.getHeight() != height)
+    {
+        tile.resize(width, height, tile.getLayout());
+    }
+    tile.fill(0.0f);
+
+    int originX = tileX * grid.tileSize - apron;
+    int originY = tileY * grid.tileSize - apron;
+    scratch.clear();
+    for (uint32_t index : bin)
+    {
+        Bump bump = bumps[index];
+        bump.x -= originX;
+        bump.y -= originY;
+        scratch.push_back(bump);
+    }
+    stampBumps(tile, scratch, 1);
+}
+
+size_t getTileMemory(int tileSize, TileMeshFormat meshFormat)
+{
+    size_t sampleWidth = static_cast<size_t>(tileSize) + 1 + 2 * c_outOfCoreApron;
+    // Rows are padded to the alignment
+    size_t paddedWidth = (sampleWidth + Heightfield::c_alignment / sizeof(float) - 1) / (Heightfield::c_alignment / sizeof(float)) *
+                         (Heightfield::c_alignment / sizeof(float));
+    size_t bytes = paddedWidth * sampleWidth * sizeof(float) + sampleWidth * sizeof(uint16_t);
+    if (meshFormat != TileMeshFormat::None)
+    {
+        size_t vertices = static_cast<size_t>(tileSize + 1) * (tileSize + 1);
+        size_t indices = static_cast<size_t>(tileSize) * tileSize * 6;
+        bytes += vertices * 6 * sizeof(float) + indices * sizeof(uint32_t);
+    }
+    return bytes;
+}
+
+bool exportTiles(unsigned int seed, const WorldParams& params, const TileExportOptions& options, TileExportStats& stats)
+{
+    TRACE_SCOPE("exportTiles");
+    std::vector<Bump> bumps;
+    {
+        TRACE_SCOPE("planMountains");
+        for (int i = 0; i < params.numMountains; ++i)
+        {
+            createMountainBumps(params, seed, i, bumps);
+        }
+    }
+    stats = TileExportStats();
+    stats.bumpCount = bumps.size();
+
+    // Smaller tiles reach more bins with every bump but need less per thread
+    TileGrid grid;
+    std::vector<std::vector<uint32_t>> bins;
+    int tileSize = options.tileSize;
+    int threadCount = options.threadCount;
+    size_t sharedMemory = 0;
+    size_t tileMemory = 0;
+    while (true)
+    {
+        grid = getTileGrid(params, tileSize);
+        binBumps(bumps, grid, bins);
+        sharedMemory = bumps.capacity() * sizeof(Bump) + getBinMemory(bins);
+        tileMemory = getTileMemory(tileSize, options.meshFormat);
+        threadCount = options.threadCount;
+        if (options.maxMemory == 0)
+        {
+            break;
+        }
+        if (sharedMemory + tileMemory <= options.maxMemory)
+        {
+            threadCount = static_cast<int>(std::min<size_t>(threadCount, (options.maxMemory - sharedMemory) / tileMemory));
+            break;
+        }
+        if (tileSize / 2 < c_outOfCoreMinTileSize)
+        {
+            std::cerr << "ERROR: " << (sharedMemory + tileMemory) / (1024 * 1024) << " MiB needed with " << tileSize << " cell tiles, more than the "
+                      << options.maxMemory / (1024 * 1024) << " MiB limit\n";
+            return false;
+        }
+        tileSize /= 2;
+    }
+    stats.tileSize = tileSize;
+    stats.threadCount = threadCount;
+    stats.tileCount = grid.getTileCount();
+    stats.estimatedMemory = sharedMemory + tileMemory * threadCount;
+
+    float minHeight = 0.0f;
+    float maxHeight = 0.0f;
+    getHeightBounds(bumps, bins, minHeight, maxHeight);
+    stats.heightOffset = minHeight;
+    stats.heightStep = std::ldexp(1.0f, -20);
+    while ((maxHeight - minHeight) / stats.heightStep > 65535.0f)
+    {
+        stats.heightStep *= 2.0f;
+    }
+
+    std::string indexFilename = options.outputPrefix + ".tiles";
+    {
+        std::ofstream index;
+        if (!openFile(indexFilename, index))
+        {
+            return false;
+        }
+        index << std::setprecision(std::numeric_limits<float>::max_digits10) << "worldSize " << grid.worldWidth << " " << grid.worldHeight << "\n"
+              << "tileSize " << grid.tileSize << "\n"
+              << "tileCount " << grid.tileCountX << " " << grid.tileCountY << "\n"
+              << "heightOffset " << stats.heightOffset << "\n"
+              << "heightStep " << stats.heightStep << "\n"
+              << "worldScale " << c_worldScale << "\n";
+    }
+
+    std::vector<TileBuffers> buffers(threadCount);
+    std::atomic<bool> failed(false);
+    std::atomic<uint64_t> bytesWritten(0);
+    parallelForStealing(grid.getTileCount(), threadCount, [&](int thread, int i) {
+        if (failed)
+        {
+            return;
+        }
+        TileBuffers& buffer = buffers[thread];
+        int tileX = i % grid.tileCountX;
+        int tileY = i / grid.tileCountX;
+        generateTile(grid, tileX, tileY, bumps, bins[i], buffer.tile, buffer.scratch);
+
+        std::string prefix = options.outputPrefix + "_" + std::to_string(tileX) + "_" + std::to_string(tileY);
+        std::vector<std::string> filenames;
+        bool written = true;
+        if (options.heights)
+        {
+            filenames.push_back(prefix + ".r16");
+            written = writeRaw16(filenames.back(), buffer.tile, c_outOfCoreApron, stats.heightOffset, stats.heightStep, buffer.row);
+        }
+        if (written && options.meshFormat != TileMeshFormat::None)
+        {
+            // Positions in world space so that the tiles line up
+            generateIndexedMesh(buffer.tile, buffer.mesh, c_outOfCoreApron);
+            float offsetX = static_cast<float>(tileX * grid.tileSize) * c_worldScale;
+            float offsetZ = static_cast<float>(tileY * grid.tileSize) * c_worldScale;
+            for (size_t v = 0; v < buffer.mesh.vertices.size(); v += 6)
+            {
+                buffer.mesh.vertices[v] += offsetX;
+                buffer.mesh.vertices[v + 2] += offsetZ;
+            }
+            if (options.meshFormat == TileMeshFormat::Gltf)
+            {
+                filenames.push_back(prefix + ".gltf");
+                written = writeGltf(filenames.back(), buffer.mesh);
+                filenames.push_back(prefix + ".bin");
+            }
+            else
+            {
+                filenames.push_back(prefix + ".mesh");
+                written = writeIndexedMesh(filenames.back(), buffer.mesh);
+            }
+        }
+        if (!written)
+        {
+            failed = true;
+            return;
+        }
+        for (const std::string& filename : filenames)
+        {
+            bytesWritten += getFileSize(filename);
+        }
+    });
+    stats.bytesWritten = bytesWritten;
+    return !failed;
+}
+
+bool writeIndexedMesh(const std::string& filename, const IndexedMesh& mesh)
+{
+    std::ofstream file;
+    if (!openFile(filename, file))
+    {
+        return false;
+    }
+    uint32_t header[4] = {static_cast<uint32_t>(mesh.vertices.size()),
+                          static_cast<uint32_t>(mesh.getIndexCount()),
+                          mesh.wideIndices ? 4u : 2u,
+                          static_cast<uint32_t>(mesh.chunks.size())};
+    file.write(reinterpret_cast<const char*>(header), sizeof(header));
+    for (const MeshChunk& chunk : mesh.chunks)
+    {
+        uint32_t values[3] = {static_cast<uint32_t>(chunk.baseVertex), static_cast<uint32_t>(chunk.firstIndex), static_cast<uint32_t>(chunk.indexCount)};
+        file.write(reinterpret_cast<const char*>(values), sizeof(values));
+    }
+    file.write(reinterpret_cast<const char*>(mesh.vertices.data()), sizeof(float) * mesh.vertices.size());
+    if (mesh.wideIndices)
+    {
+        file.write(reinterpret_cast<const char*>(mesh.indices32.data()), sizeof(uint32_t) * mesh.indices32.size());
+    }
+    else
+    {
+        file.write(reinterpret_cast<const char*>(mesh.indices16.data()), sizeof(uint16_t) * mesh.indices16.size());
+    }
+    return static_cast<bool>(file);
+}
+
+bool writeGltf(const std::string& filename, const IndexedMesh& mesh)
+{
+    std::string binFilename = filename.substr(0, filename.rfind('.')) + ".bin";
+    size_t separator = binFilename.find_last_of("/\\");
+    std::string binUri = separator == std::string::npos ? binFilename : binFilename.substr(separator + 1);
+
+    std::ofstream bin;
+    if (!openFile(binFilename, bin))
+    {
+        return false;
+    }
+    size_t vertexCount = mesh.getVertexCount();
+    size_t vertexBytes = mesh.vertices.size() * sizeof(float);
+    size_t indexBytes = mesh.getIndexCount() * sizeof(uint32_t);
+    bin.write(reinterpret_cast<const char*>(mesh.vertices.data()), vertexBytes);
+
+    // Chunk indices are relative to their base vertex, glTF has no base vertex
+    const size_t blockSize = 4096;
+    uint32_t block[blockSize];
+    for (const MeshChunk& chunk : mesh.chunks)
+    {
+        for (size_t first = 0; first < static_cast<size_t>(chunk.indexCount); first += blockSize)
+        {
+            size_t count = std::min(blockSize, static_cast<size_t>(chunk.indexCount) - first);
+            for (size_t i = 0; i < count; ++i)
+            {
+                size_t index = chunk.firstIndex + first + i;
+                uint32_t relative = mesh.wideIndices ? mesh.indices32[index] : mesh.indices16[index];
+                block[i] = relative + static_cast<uint32_t>(chunk.baseVertex);
+            }
+            bin.write(reinterpret_cast<const char*>(block), sizeof(uint32_t) * count);
+        }
+    }
+    if (!bin)
+    {
+        return false;
+    }
+
+    float minPosition[3] = {std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max()};
+    float maxPosition[3] = {-std::numeric_limits<float>::max(), -std::numeric_limits<float>::max(), -std::numeric_limits<float>::max()};
+    for (size_t v = 0; v < mesh.vertices.size(); v += 6)
+    {
+        for (int k = 0; k < 3; ++k)
+        {
+            minPosition[k] = std::min(minPosition[k], mesh.vertices[v + k]);
+            maxPosition[k] = std::max(maxPosition[k], mesh.vertices[v + k]);
+        }
+    }
+
+    std::ofstream file;
+    if (!openFile(filename, file))
+    {
+        return false;
+    }
+    file << std::setprecision(std::numeric_limits<float>::max_digits10);
+    file << "{\"asset\":{\"version\":\"2.0\",\"generator\":\"random-terrain\"},\"scene\":0,\"scenes\":[{\"nodes\":[0]}],\"nodes\":[{\"mesh\":0}],\n"
+         << "\"meshes\":[{\"primitives\":[{\"attributes\":{\"POSITION\":0,\"NORMAL\":1},\"indices\":2,\"mode\":4}]}],\n"
+         << "\"buffers\":[{\"uri\":\"" << binUri << "\",\"byteLength\":" << vertexBytes + indexBytes << "}],\n"
+         << "\"bufferViews\":[{\"buffer\":0,\"byteOffset\":0,\"byteLength\":" << vertexBytes << ",\"byteStride\":24,\"target\":34962},"
+         << "{\"buffer\":0,\"byteOffset\":" << vertexBytes << ",\"byteLength\":" << indexBytes << ",\"target\":34963}],\n"
+         << "\"accessors\":[{\"bufferView\":0,\"byteOffset\":0,\"componentType\":5126,\"count\":" << vertexCount << ",\"type\":\"VEC3\",\"min\":["
+         << minPosition[0] << "," << minPosition[1] << "," << minPosition[2] << "],\"max\":[" << maxPosition[0] << "," << maxPosition[1] << ","
+         << maxPosition[2] << "]},\n"
+         << "{\"bufferView\":0,\"byteOffset\":12,\"componentType\":5126,\"count\":" << vertexCount << ",\"type\":\"VEC3\"},\n"
+         << "{\"bufferView\":1,\"byteOffset\":0,\"componentType\":5125,\"count\":" << mesh.getIndexCount() << ",\"type\":\"SCALAR\"}]}\n";
+    return static_cast<bool>(file);
+}
@@ -0,0 +1,131 @@
+#include "parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+int getDefaultThreadCount()
+{
+    return std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+}
+
+void parallelFor(int count, int threadCount, const std::function<void(int)>& task)
+{
+    int workerCount = std::min(threadCount, count) - 1;
+    if (workerCount <= 0)
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            task(i);
+        }
+        return;
+    }
+
+    std::atomic<int> next(0);
+    auto work = [&]() {
+        for (int i = next++; i < count; i = next++)
+        {
+            task(i);
+        }
+    };
+
+    std::vector<std::thread> workers;
+    workers.reserve(workerCount);
+    for (int i = 0; i < workerCount; ++i)
+    {
+        workers.emplace_back(work);
+    }
+    work();
+    for (std::thread& worker : workers)
+    {
+        worker.join();
+    }
+}
+
+namespace
+{
+// Indices [begin, end) not yet started, the owner takes from the front and thieves from the back
+struct Share
+{
+    std::mutex mutex;
+    int begin = 0;
+    int end = 0;
+};
+} // namespace
+
+void parallelForStealing(int count, int threadCount, const std::function<void(int, int)>& task)
+{
+    int shareCount = std::max(1, std::min(threadCount, count));
+    std::vector<std::unique_ptr<Share>> shares;
+    for (int i = 0; i < shareCount; ++i)
+    {
+        shares.emplace_back(new Share());
+        shares[i]->begin = static_cast<int>(static_cast<long long>(count) * i / shareCount);
+        shares[i]->end = static_cast<int>(static_cast<long long>(count) * (i + 1) / shareCount);
+    }
+
+    auto work = [&](int thread) {
+        Share& own = *shares[thread];
+        while (true)
+        {
+            int index = -1;
+            {
+                std::lock_guard<std::mutex> lock(own.mutex);
+                if (own.begin < own.end)
+                {
+                    index = own.begin++;
+                }
+            }
+            if (index >= 0)
+            {
+                task(thread, index);
+                continue;
+            }
+
+            // Steal the back half of the largest share
+            int victim = -1;
+            int largest = 0;
+            for (int i = 0; i < shareCount; ++i)
+            {
+                std::lock_guard<std::mutex> lock(shares[i]->mutex);
+                if (shares[i]->end - shares[i]->begin > largest)
+                {
+                    largest = shares[i]->end - shares[i]->begin;
+                    victim = i;
+                }
+            }
+            if (victim < 0)
+            {
+                return;
+            }
+
+            int stolenBegin;
+            int stolenEnd;
+            {
+                std::lock_guard<std::mutex> lock(shares[victim]->mutex);
+                Share& share = *shares[victim];
+                stolenEnd = share.end;
+                stolenBegin = share.end - (share.end - share.begin + 1) / 2;
+                share.end = stolenBegin;
+            }
+            std::lock_guard<std::mutex> lock(own.mutex);
+            own.begin = stolenBegin;
+            own.end = stolenEnd;
+        }
+    };
+
+    std::vector<std::thread> workers;
+    workers.reserve(shareCount - 1);
+    for (int i = 1; i < shareCount; ++i)
+    {
+        workers.emplace_back(work, i);
+    }
+    work(0);
+    for (std::thread& worker : workers)
+    {
+        worker.join();
+    }
+}
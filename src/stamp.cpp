@@ -0,0 +1,201 @@
+#include "stamp.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+namespace
+{
+float fastExp(float x)
+{
+    x = x < c_expMin ? c_expMin : x;
+    float n = std::floor(x * c_expLog2e + 0.5f);
+    float r = x - n * c_expLn2Hi;
+    r = r - n * c_expLn2Lo;
+
+    float y = c_expP0;
+    y = y * r + c_expP1;
+    y = y * r + c_expP2;
+    y = y * r + c_expP3;
+    y = y * r + c_expP4;
+    y = y * r + c_expP5;
+    y = y * (r * r);
+    y = y + r;
+    y = y + 1.0f;
+
+    int32_t bits = (static_cast<int32_t>(n) + 127) << 23;
+    float pow2n;
+    std::memcpy(&pow2n, &bits, sizeof(pow2n));
+    return y * pow2n;
+}
+
+bool detectAvx2()
+{
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+    {
+        return false;
+    }
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6)
+    {
+        return false;
+    }
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") != 0;
+#else
+    return false;
+#endif
+}
+
+StampKernel detectStampKernel()
+{
+    if (detectAvx2())
+    {
+        return StampKernel::AVX2;
+    }
+    if (isStampKernelSupported(StampKernel::SSE))
+    {
+        return StampKernel::SSE;
+    }
+    return StampKernel::Scalar;
+}
+
+StampKernel g_stampKernel = detectStampKernel();
+StampMode g_stampMode = StampMode::Cached;
+} // namespace
+
+void stampRowScalar(float* samples, int count, float firstDx, float dy2, float scale, float falloff)
+{
+    for (int i = 0; i < count; ++i)
+    {
+        float dx = firstDx + static_cast<float>(i);
+        float exponent = -((dx * dx + dy2) * falloff);
+        samples[i] += scale * fastExp(exponent);
+    }
+}
+
+void addScaledRowScalar(float* samples, const float* profile, int count, float scale)
+{
+    for (int i = 0; i < count; ++i)
+    {
+        samples[i] += scale * profile[i];
+    }
+}
+
+void addBumpPointsScalar(const float* x, const float* y, float* heights, int count, float centerX, float centerY, float limit, float scale, float falloff)
+{
+    for (int i = 0; i < count; ++i)
+    {
+        float dx = x[i] - centerX;
+        float dy = y[i] - centerY;
+        if (std::abs(dx) <= limit && std::abs(dy) <= limit)
+        {
+            float exponent = -((dx * dx + dy * dy) * falloff);
+            heights[i] += scale * fastExp(exponent);
+        }
+    }
+}
+
+bool isStampKernelSupported(StampKernel kernel)
+{
+    switch (kernel)
+    {
+    case StampKernel::Scalar:
+        return true;
+    case StampKernel::SSE:
+#if defined(__x86_64__) || defined(_M_X64)
+        return true;
+#else
+        return false;
+#endif
+    case StampKernel::AVX2:
+        return detectAvx2();
+    }
+    return false;
+}
+
+const char* getStampKernelName(StampKernel kernel)
+{
+    switch (kernel)
+    {
+    case StampKernel::Scalar:
+        return "scalar";
+    case StampKernel::SSE:
+        return "sse";
+    case StampKernel::AVX2:
+        return "avx2";
+    }
+    return "unknown";
+}
+
+StampRowFunction getStampRowFunction(StampKernel kernel)
+{
+    switch (kernel)
+    {
+    case StampKernel::SSE:
+        return stampRowSse;
+    case StampKernel::AVX2:
+        return stampRowAvx2;
+    default:
+        return stampRowScalar;
+    }
+}
+
+AddScaledRowFunction getAddScaledRowFunction(StampKernel kernel)
+{
+    switch (kernel)
+    {
+    case StampKernel::SSE:
+        return addScaledRowSse;
+    case StampKernel::AVX2:
+        return addScaledRowAvx2;
+    default:
+        return addScaledRowScalar;
+    }
+}
+
+AddBumpPointsFunction getAddBumpPointsFunction(StampKernel kernel)
+{
+    switch (kernel)
+    {
+    case StampKernel::SSE:
+        return addBumpPointsSse;
+    case StampKernel::AVX2:
+        return addBumpPointsAvx2;
+    default:
+        return addBumpPointsScalar;
+    }
+}
+
+StampKernel getStampKernel()
+{
+    return g_stampKernel;
+}
+
+void setStampKernel(StampKernel kernel)
+{
+    g_stampKernel = isStampKernelSupported(kernel) ? kernel : StampKernel::Scalar;
+}
+
+StampMode getStampMode()
+{
+    return g_stampMode;
+}
+
+void setStampMode(StampMode mode)
+{
+    g_stampMode = mode;
+}
@@ -0,0 +1,107 @@
+#include "stamp.h"
+
+#if defined(__AVX2__)
+
+#include <immintrin.h>
+
+namespace
+{
+// Deliberately no FMA so that results match the scalar and SSE kernels
+__m256 expAvx2(__m256 x)
+{
+    x = _mm256_max_ps(x, _mm256_set1_ps(c_expMin));
+
+    __m256 fx = _mm256_add_ps(_mm256_mul_ps(x, _mm256_set1_ps(c_expLog2e)), _mm256_set1_ps(0.5f));
+    __m256 n = _mm256_floor_ps(fx);
+
+    __m256 r = _mm256_sub_ps(x, _mm256_mul_ps(n, _mm256_set1_ps(c_expLn2Hi)));
+    r = _mm256_sub_ps(r, _mm256_mul_ps(n, _mm256_set1_ps(c_expLn2Lo)));
+
+    __m256 y = _mm256_set1_ps(c_expP0);
+    y = _mm256_add_ps(_mm256_mul_ps(y, r), _mm256_set1_ps(c_expP1));
+    y = _mm256_add_ps(_mm256_mul_ps(y, r), _mm256_set1_ps(c_expP2));
+    y = _mm256_add_ps(_mm256_mul_ps(y, r), _mm256_set1_ps(c_expP3));
+    y = _mm256_add_ps(_mm256_mul_ps(y, r), _mm256_set1_ps(c_expP4));
+    y = _mm256_add_ps(_mm256_mul_ps(y, r), _mm256_set1_ps(c_expP5));
+    y = _mm256_mul_ps(y, _mm256_mul_ps(r, r));
+    y = _mm256_add_ps(y, r);
+    y = _mm256_add_ps(y, _mm256_set1_ps(1.0f));
+
+    __m256i exponent = _mm256_add_epi32(_mm256_cvttps_epi32(n), _mm256_set1_epi32(127));
+    __m256 pow2n = _mm256_castsi256_ps(_mm256_slli_epi32(exponent, 23));
+    return _mm256_mul_ps(y, pow2n);
+}
+} // namespace
+
+void stampRowAvx2(float* samples, int count, float firstDx, float dy2, float scale, float falloff)
+{
+    const __m256 step = _mm256_set1_ps(8.0f);
+    const __m256 dy2s = _mm256_set1_ps(dy2);
+    const __m256 scales = _mm256_set1_ps(scale);
+    const __m256 falloffs = _mm256_set1_ps(falloff);
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    __m256 dx = _mm256_add_ps(_mm256_set1_ps(firstDx), _mm256_set_ps(7.0f, 6.0f, 5.0f, 4.0f, 3.0f, 2.0f, 1.0f, 0.0f));
+
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 exponent = _mm256_xor_ps(_mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), dy2s), falloffs), sign);
+        __m256 height = _mm256_mul_ps(scales, expAvx2(exponent));
+        _mm256_storeu_ps(samples + i, _mm256_add_ps(_mm256_loadu_ps(samples + i), height));
+        dx = _mm256_add_ps(dx, step);
+    }
+    stampRowSse(samples + i, count - i, firstDx + static_cast<float>(i), dy2, scale, falloff);
+}
+
+void addScaledRowAvx2(float* samples, const float* profile, int count, float scale)
+{
+    const __m256 scales = _mm256_set1_ps(scale);
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 height = _mm256_mul_ps(scales, _mm256_loadu_ps(profile + i));
+        _mm256_storeu_ps(samples + i, _mm256_add_ps(_mm256_loadu_ps(samples + i), height));
+    }
+    addScaledRowSse(samples + i, profile + i, count - i, scale);
+}
+
+void addBumpPointsAvx2(const float* x, const float* y, float* heights, int count, float centerX, float centerY, float limit, float scale, float falloff)
+{
+    const __m256 centerXs = _mm256_set1_ps(centerX);
+    const __m256 centerYs = _mm256_set1_ps(centerY);
+    const __m256 limits = _mm256_set1_ps(limit);
+    const __m256 scales = _mm256_set1_ps(scale);
+    const __m256 falloffs = _mm256_set1_ps(falloff);
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(x + i), centerXs);
+        __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(y + i), centerYs);
+        __m256 inside = _mm256_and_ps(_mm256_cmp_ps(_mm256_andnot_ps(sign, dx), limits, _CMP_LE_OQ), _mm256_cmp_ps(_mm256_andnot_ps(sign, dy), limits, _CMP_LE_OQ));
+        __m256 exponent = _mm256_xor_ps(_mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), falloffs), sign);
+        __m256 height = _mm256_and_ps(inside, _mm256_mul_ps(scales, expAvx2(exponent)));
+        _mm256_storeu_ps(heights + i, _mm256_add_ps(_mm256_loadu_ps(heights + i), height));
+    }
+    addBumpPointsSse(x + i, y + i, heights + i, count - i, centerX, centerY, limit, scale, falloff);
+}
+
+#else
+
+void stampRowAvx2(float* samples, int count, float firstDx, float dy2, float scale, float falloff)
+{
+    stampRowSse(samples, count, firstDx, dy2, scale, falloff);
+}
+
+void addScaledRowAvx2(float* samples, const float* profile, int count, float scale)
+{
+    addScaledRowSse(samples, profile, count, scale);
+}
+
+void addBumpPointsAvx2(const float* x, const float* y, float* heights, int count, float centerX, float centerY, float limit, float scale, float falloff)
+{
+    addBumpPointsSse(x, y, heights, count, centerX, centerY, limit, scale, falloff);
+}
+
+#endif
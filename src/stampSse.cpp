@@ -0,0 +1,109 @@
+#include "stamp.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+
+#include <emmintrin.h>
+
+namespace
+{
+__m128 expSse(__m128 x)
+{
+    x = _mm_max_ps(x, _mm_set1_ps(c_expMin));
+
+    // floor(x * log2e + 0.5) without SSE4.1
+    __m128 fx = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(c_expLog2e)), _mm_set1_ps(0.5f));
+    __m128 truncated = _mm_cvtepi32_ps(_mm_cvttps_epi32(fx));
+    __m128 correction = _mm_and_ps(_mm_cmpgt_ps(truncated, fx), _mm_set1_ps(1.0f));
+    __m128 n = _mm_sub_ps(truncated, correction);
+
+    __m128 r = _mm_sub_ps(x, _mm_mul_ps(n, _mm_set1_ps(c_expLn2Hi)));
+    r = _mm_sub_ps(r, _mm_mul_ps(n, _mm_set1_ps(c_expLn2Lo)));
+
+    __m128 y = _mm_set1_ps(c_expP0);
+    y = _mm_add_ps(_mm_mul_ps(y, r), _mm_set1_ps(c_expP1));
+    y = _mm_add_ps(_mm_mul_ps(y, r), _mm_set1_ps(c_expP2));
+    y = _mm_add_ps(_mm_mul_ps(y, r), _mm_set1_ps(c_expP3));
+    y = _mm_add_ps(_mm_mul_ps(y, r), _mm_set1_ps(c_expP4));
+    y = _mm_add_ps(_mm_mul_ps(y, r), _mm_set1_ps(c_expP5));
+    y = _mm_mul_ps(y, _mm_mul_ps(r, r));
+    y = _mm_add_ps(y, r);
+    y = _mm_add_ps(y, _mm_set1_ps(1.0f));
+
+    __m128i exponent = _mm_add_epi32(_mm_cvttps_epi32(n), _mm_set1_epi32(127));
+    __m128 pow2n = _mm_castsi128_ps(_mm_slli_epi32(exponent, 23));
+    return _mm_mul_ps(y, pow2n);
+}
+} // namespace
+
+void stampRowSse(float* samples, int count, float firstDx, float dy2, float scale, float falloff)
+{
+    const __m128 step = _mm_set1_ps(4.0f);
+    const __m128 dy2s = _mm_set1_ps(dy2);
+    const __m128 scales = _mm_set1_ps(scale);
+    const __m128 falloffs = _mm_set1_ps(falloff);
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    __m128 dx = _mm_add_ps(_mm_set1_ps(firstDx), _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f));
+
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 exponent = _mm_xor_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(dx, dx), dy2s), falloffs), sign);
+        __m128 height = _mm_mul_ps(scales, expSse(exponent));
+        _mm_storeu_ps(samples + i, _mm_add_ps(_mm_loadu_ps(samples + i), height));
+        dx = _mm_add_ps(dx, step);
+    }
+    stampRowScalar(samples + i, count - i, firstDx + static_cast<float>(i), dy2, scale, falloff);
+}
+
+void addScaledRowSse(float* samples, const float* profile, int count, float scale)
+{
+    const __m128 scales = _mm_set1_ps(scale);
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 height = _mm_mul_ps(scales, _mm_loadu_ps(profile + i));
+        _mm_storeu_ps(samples + i, _mm_add_ps(_mm_loadu_ps(samples + i), height));
+    }
+    addScaledRowScalar(samples + i, profile + i, count - i, scale);
+}
+
+void addBumpPointsSse(const float* x, const float* y, float* heights, int count, float centerX, float centerY, float limit, float scale, float falloff)
+{
+    const __m128 centerXs = _mm_set1_ps(centerX);
+    const __m128 centerYs = _mm_set1_ps(centerY);
+    const __m128 limits = _mm_set1_ps(limit);
+    const __m128 scales = _mm_set1_ps(scale);
+    const __m128 falloffs = _mm_set1_ps(falloff);
+    const __m128 sign = _mm_set1_ps(-0.0f);
+
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 dx = _mm_sub_ps(_mm_loadu_ps(x + i), centerXs);
+        __m128 dy = _mm_sub_ps(_mm_loadu_ps(y + i), centerYs);
+        __m128 inside = _mm_and_ps(_mm_cmple_ps(_mm_andnot_ps(sign, dx), limits), _mm_cmple_ps(_mm_andnot_ps(sign, dy), limits));
+        __m128 exponent = _mm_xor_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), falloffs), sign);
+        __m128 height = _mm_and_ps(inside, _mm_mul_ps(scales, expSse(exponent)));
+        _mm_storeu_ps(heights + i, _mm_add_ps(_mm_loadu_ps(heights + i), height));
+    }
+    addBumpPointsScalar(x + i, y + i, heights + i, count - i, centerX, centerY, limit, scale, falloff);
+}
+
+#else
+
+void stampRowSse(float* samples, int count, float firstDx, float dy2, float scale, float falloff)
+{
+    stampRowScalar(samples, count, firstDx, dy2, scale, falloff);
+}
+
+void addScaledRowSse(float* samples, const float* profile, int count, float scale)
+{
+    addScaledRowScalar(samples, profile, count, scale);
+}
+
+void addBumpPointsSse(const float* x, const float* y, float* heights, int count, float centerX, float centerY, float limit, float scale, float falloff)
+{
+    addBumpPointsScalar(x, y, heights, count, centerX, centerY, limit, scale, falloff);
+}
+
+#endif
@@ -0,0 +1,176 @@
+#include "stencil.h"
+#include "parallel.h"
+#include "trace.h"
+#include "constants.h"
+
+#include <utility>
+#include <vector>
+
+namespace
+{
+struct Stencil
+{
+    // Interior samples go through the selected kernel and the edge samples,
+    // which need a padded copy of their row, through the scalar one
+    StencilRowFunction interior;
+    StencilRowFunction edge;
+    float a;
+    float b;
+};
+
+// Samples [minX, maxX) of a row of width samples. Edge samples are their own
+// missing neighbors.
+void applyRowSegment(const Stencil& stencil, const float* above, const float* row, const float* below, float* out, int minX, int maxX, int width)
+{
+    if (minX == 0)
+    {
+        float padded[3] = {row[0], row[0], row[std::min(1, width - 1)]};
+        stencil.edge(above, padded + 1, below, out, 1, stencil.a, stencil.b);
+        minX = 1;
+    }
+    if (maxX == width && minX < width)
+    {
+        int last = width - 1;
+        float padded[3] = {row[last - 1], row[last], row[last]};
+        stencil.edge(above + last, padded + 1, below + last, out + last, 1, stencil.a, stencil.b);
+        maxX = last;
+    }
+    if (minX < maxX)
+    {
+        stencil.interior(above + minX, row + minX, below + minX, out + minX, maxX - minX, stencil.a, stencil.b);
+    }
+}
+
+void gatherRow(const Heightfield& field, int y, std::vector<float>& row)
+{
+    for (int x = 0; x < field.getWidth(); ++x)
+    {
+        row[x] = field.at(x, y);
+    }
+}
+
+// Rows [minY, maxY] of destination from source
+void applyBand(const Stencil& stencil, const Heightfield& source, Heightfield& destination, int minY, int maxY)
+{
+    int width = source.getWidth();
+    int lastY = source.getHeight() - 1;
+    if (source.getLayout() == Heightfield::Layout::RowMajor)
+    {
+        // Column blocks keep the three input rows of a block in the L1 cache
+        // while the band is walked down
+        for (int minX = 0; minX < width; minX += c_stencilBlockWidth)
+        {
+            int maxX = std::min(width, minX + c_stencilBlockWidth);
+            for (int y = minY; y <= maxY; ++y)
+            {
+                applyRowSegment(stencil, source.row(std::max(y - 1, 0)), source.row(y), source.row(std::min(y + 1, lastY)), destination.row(y), minX, maxX,
+                                width);
+            }
+        }
+        return;
+    }
+
+    // The tiled layout has no row pointers, rows are copied out and back
+    std::vector<float> above(width);
+    std::vector<float> row(width);
+    std::vector<float> below(width);
+    std::vector<float> out(width);
+    gatherRow(source, std::max(minY - 1, 0), above);
+    gatherRow(source, minY, row);
+    for (int y = minY; y <= maxY; ++y)
+    {
+        gatherRow(source, std::min(y + 1, lastY), below);
+        applyRowSegment(stencil, above.data(), row.data(), below.data(), out.data(), 0, width, width);
+        for (int x = 0; x < width; ++x)
+        {
+            destination.at(x, y) = out[x];
+        }
+        std::swap(above, row);
+        std::swap(row, below);
+    }
+}
+
+void applyStencil(const Stencil& stencil, Heightfield& world, Heightfield& scratch, int iterations, int threadCount)
+{
+    if (scratch.getWidth() != world.getWidth() || scratch.getHeight() != world.getHeight() || scratch.getLayout() != world.getLayout())
+    {
+        scratch.resize(world.getWidth(), world.getHeight(), world.getLayout());
+    }
+
+    int bandCount = (world.getHeight() + c_stencilBandHeight - 1) / c_stencilBandHeight;
+    for (int i = 0; i < iterations; ++i)
+    {
+        parallelFor(bandCount, threadCount, [&](int band) {
+            int minY = band * c_stencilBandHeight;
+            int maxY = std::min(world.getHeight(), minY + c_stencilBandHeight) - 1;
+            applyBand(stencil, world, scratch, minY, maxY);
+        });
+        std::swap(world, scratch);
+    }
+    if (iterations > 0)
+    {
+        world.markAllDirty();
+    }
+}
+} // namespace
+
+void thermalRowScalar(const float* above, const float* row, const float* below, float* out, int count, float talus, float rate)
+{
+    for (int i = 0; i < count; ++i)
+    {
+        float height = row[i];
+        float transfer = getThermalTransfer(row[i - 1] - height, talus) + getThermalTransfer(row[i + 1] - height, talus);
+        transfer = transfer + getThermalTransfer(above[i] - height, talus);
+        transfer = transfer + getThermalTransfer(below[i] - height, talus);
+        out[i] = height + rate * transfer;
+    }
+}
+
+void smoothRowScalar(const float* above, const float* row, const float* below, float* out, int count, float strength, float)
+{
+    for (int i = 0; i < count; ++i)
+    {
+        float average = ((row[i - 1] + row[i + 1]) + (above[i] + below[i])) * 0.25f;
+        out[i] = row[i] + strength * (average - row[i]);
+    }
+}
+
+StencilRowFunction getThermalRowFunction(StampKernel kernel)
+{
+    switch (kernel)
+    {
+    case StampKernel::SSE:
+        return thermalRowSse;
+    case StampKernel::AVX2:
+        return thermalRowAvx2;
+    default:
+        return thermalRowScalar;
+    }
+}
+
+StencilRowFunction getSmoothRowFunction(StampKernel kernel)
+{
+    switch (kernel)
+    {
+    case StampKernel::SSE:
+        return smoothRowSse;
+    case StampKernel::AVX2:
+        return smoothRowAvx2;
+    default:
+        return smoothRowScalar;
+    }
+}
+
+void erodeThermal(Heightfield& world, Heightfield& scratch, int iterations, float talus, float rate, int threadCount)
+{
+    TRACE_SCOPE("erodeThermal");
+    Stencil stencil = {getThermalRowFunction(getStampKernel()), thermalRowScalar, talus, rate};
+    applyStencil(stencil, world, scratch, iterations, threadCount);
+}
+
+void smoothHeights(Heightfield& world, Heightfield& scratch, int iterations, float strength, int threadCount)
+{
+    TRACE_SCOPE("smoothHeights");
+    Stencil stencil = {getSmoothRowFunction(getStampKernel()), smoothRowScalar, strength, 0.0f};
+    applyStencil(stencil, world, scratch, iterations, threadCount);
+}
@@ -0,0 +1,61 @@
+#include "stencil.h"
+
+#if defined(__AVX2__)
+
+#include <immintrin.h>
+
+namespace
+{
+// No FMA, the results match the scalar and SSE kernels
+__m256 thermalTransferAvx2(__m256 difference, __m256 talus)
+{
+    const __m256 zero = _mm256_setzero_ps();
+    return _mm256_add_ps(_mm256_max_ps(_mm256_sub_ps(difference, talus), zero), _mm256_min_ps(_mm256_add_ps(difference, talus), zero));
+}
+} // namespace
+
+void thermalRowAvx2(const float* above, const float* row, const float* below, float* out, int count, float talus, float rate)
+{
+    const __m256 taluses = _mm256_set1_ps(talus);
+    const __m256 rates = _mm256_set1_ps(rate);
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 height = _mm256_loadu_ps(row + i);
+        __m256 transfer = _mm256_add_ps(thermalTransferAvx2(_mm256_sub_ps(_mm256_loadu_ps(row + i - 1), height), taluses),
+                                        thermalTransferAvx2(_mm256_sub_ps(_mm256_loadu_ps(row + i + 1), height), taluses));
+        transfer = _mm256_add_ps(transfer, thermalTransferAvx2(_mm256_sub_ps(_mm256_loadu_ps(above + i), height), taluses));
+        transfer = _mm256_add_ps(transfer, thermalTransferAvx2(_mm256_sub_ps(_mm256_loadu_ps(below + i), height), taluses));
+        _mm256_storeu_ps(out + i, _mm256_add_ps(height, _mm256_mul_ps(rates, transfer)));
+    }
+    thermalRowSse(above + i, row + i, below + i, out + i, count - i, talus, rate);
+}
+
+void smoothRowAvx2(const float* above, const float* row, const float* below, float* out, int count, float strength, float unused)
+{
+    const __m256 strengths = _mm256_set1_ps(strength);
+    const __m256 quarter = _mm256_set1_ps(0.25f);
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 height = _mm256_loadu_ps(row + i);
+        __m256 sides = _mm256_add_ps(_mm256_loadu_ps(row + i - 1), _mm256_loadu_ps(row + i + 1));
+        __m256 average = _mm256_mul_ps(_mm256_add_ps(sides, _mm256_add_ps(_mm256_loadu_ps(above + i), _mm256_loadu_ps(below + i))), quarter);
+        _mm256_storeu_ps(out + i, _mm256_add_ps(height, _mm256_mul_ps(strengths, _mm256_sub_ps(average, height))));
+    }
+    smoothRowSse(above + i, row + i, below + i, out + i, count - i, strength, unused);
+}
+
+#else
+
+void thermalRowAvx2(const float* above, const float* row, const float* below, float* out, int count, float talus, float rate)
+{
+    thermalRowSse(above, row, below, out, count, talus, rate);
+}
+
+void smoothRowAvx2(const float* above, const float* row, const float* below, float* out, int count, float strength, float unused)
+{
+    smoothRowSse(above, row, below, out, count, strength, unused);
+}
+
+#endif
@@ -0,0 +1,61 @@
+#include "stencil.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+
+#include <emmintrin.h>
+
+namespace
+{
+// max(difference - talus, 0) + min(difference + talus, 0) like getThermalTransfer
+__m128 thermalTransferSse(__m128 difference, __m128 talus)
+{
+    const __m128 zero = _mm_setzero_ps();
+    return _mm_add_ps(_mm_max_ps(_mm_sub_ps(difference, talus), zero), _mm_min_ps(_mm_add_ps(difference, talus), zero));
+}
+} // namespace
+
+void thermalRowSse(const float* above, const float* row, const float* below, float* out, int count, float talus, float rate)
+{
+    const __m128 taluses = _mm_set1_ps(talus);
+    const __m128 rates = _mm_set1_ps(rate);
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 height = _mm_loadu_ps(row + i);
+        __m128 transfer = _mm_add_ps(thermalTransferSse(_mm_sub_ps(_mm_loadu_ps(row + i - 1), height), taluses),
+                                     thermalTransferSse(_mm_sub_ps(_mm_loadu_ps(row + i + 1), height), taluses));
+        transfer = _mm_add_ps(transfer, thermalTransferSse(_mm_sub_ps(_mm_loadu_ps(above + i), height), taluses));
+        transfer = _mm_add_ps(transfer, thermalTransferSse(_mm_sub_ps(_mm_loadu_ps(below + i), height), taluses));
+        _mm_storeu_ps(out + i, _mm_add_ps(height, _mm_mul_ps(rates, transfer)));
+    }
+    thermalRowScalar(above + i, row + i, below + i, out + i, count - i, talus, rate);
+}
+
+void smoothRowSse(const float* above, const float* row, const float* below, float* out, int count, float strength, float unused)
+{
+    const __m128 strengths = _mm_set1_ps(strength);
+    const __m128 quarter = _mm_set1_ps(0.25f);
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 height = _mm_loadu_ps(row + i);
+        __m128 sides = _mm_add_ps(_mm_loadu_ps(row + i - 1), _mm_loadu_ps(row + i + 1));
+        __m128 average = _mm_mul_ps(_mm_add_ps(sides, _mm_add_ps(_mm_loadu_ps(above + i), _mm_loadu_ps(below + i))), quarter);
+        _mm_storeu_ps(out + i, _mm_add_ps(height, _mm_mul_ps(strengths, _mm_sub_ps(average, height))));
+    }
+    smoothRowScalar(above + i, row + i, below + i, out + i, count - i, strength, unused);
+}
+
+#else
+
+void thermalRowSse(const float* above, const float* row, const float* below, float* out, int count, float talus, float rate)
+{
+    thermalRowScalar(above, row, below, out, count, talus, rate);
+}
+
+void smoothRowSse(const float* above, const float* row, const float* below, float* out, int count, float strength, float unused)
+{
+    smoothRowScalar(above, row, below, out, count, strength, unused);
+}
+
+#endif
@@ -0,0 +1,152 @@
+#include "trace.h"
+
+#ifdef TERRAIN_TRACING
+
+#include "constants.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace
+{
+struct TraceEvent
+{
+    const char* name;
+    uint64_t start;
+    // Duration of scopes in nanoseconds, unused for counters
+    uint64_t duration;
+    double value;
+    bool counter;
+};
+
+// Written by its own thread only, older events are overwritten when full
+struct TraceBuffer
+{
+    int threadId;
+    const char* threadName = nullptr;
+    std::vector<TraceEvent> events;
+    std::atomic<uint64_t> written;
+};
+
+std::mutex g_traceMutex;
+std::vector<std::unique_ptr<TraceBuffer>> g_traceBuffers;
+thread_local TraceBuffer* t_traceBuffer = nullptr;
+
+TraceBuffer& getThreadBuffer()
+{
+    if (t_traceBuffer == nullptr)
+    {
+        // Buffers outlive their threads so that worker events can still be written out
+        std::lock_guard<std::mutex> lock(g_traceMutex);
+        g_traceBuffers.emplace_back(new TraceBuffer());
+        t_traceBuffer = g_traceBuffers.back().get();
+        t_traceBuffer->threadId = static_cast<int>(g_traceBuffers.size());
+        t_traceBuffer->events.resize(c_traceBufferEvents);
+        t_traceBuffer->written = 0;
+    }
+    return *t_traceBuffer;
+}
+
+void recordEvent(const TraceEvent& event)
+{
+    TraceBuffer& buffer = getThreadBuffer();
+    uint64_t written = buffer.written.load(std::memory_order_relaxed);
+    buffer.events[written % buffer.events.size()] = event;
+    buffer.written.store(written + 1, std::memory_order_release);
+}
+} // namespace
+
+uint64_t getTraceTime()
+{
+    typedef std::chrono::steady_clock Clock;
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count());
+}
+
+void recordTraceScope(const char* name, uint64_t start, uint64_t end)
+{
+    recordEvent({name, start, end - start, 0.0, false});
+}
+
+void recordTraceCounter(const char* name, double value)
+{
+    recordEvent({name, getTraceTime(), 0, value, true});
+}
+
+void setTraceThreadName(const char* name)
+{
+    getThreadBuffer().threadName = name;
+}
+
+bool writeChromeTrace(const std::string& filename)
+{
+    std::ofstream file(filename.c_str());
+    if (!file)
+    {
+        std::cerr << "ERROR: Could not open file: " << filename << "\n";
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(g_traceMutex);
+    uint64_t origin = UINT64_MAX;
+    for (const std::unique_ptr<TraceBuffer>& buffer : g_traceBuffers)
+    {
+        uint64_t written = buffer->written.load(std::memory_order_acquire);
+        uint64_t first = written > buffer->events.size() ? written - buffer->events.size() : 0;
+        for (uint64_t i = first; i < written; ++i)
+        {
+            origin = std::min(origin, buffer->events[i % buffer->events.size()].start);
+        }
+    }
+
+    // Timestamps are in microseconds from the first event
+    file << "{\"traceEvents\":[\n";
+    file.precision(3);
+    file << std::fixed;
+    bool first = true;
+    for (const std::unique_ptr<TraceBuffer>& buffer : g_traceBuffers)
+    {
+        if (buffer->threadName != nullptr)
+        {
+            file << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->threadId
+                 << ",\"args\":{\"name\":\"" << buffer->threadName << "\"}}";
+            first = false;
+        }
+
+        uint64_t written = buffer->written.load(std::memory_order_acquire);
+        uint64_t begin = written > buffer->events.size() ? written - buffer->events.size() : 0;
+        for (uint64_t i = begin; i < written; ++i)
+        {
+            const TraceEvent& event = buffer->events[i % buffer->events.size()];
+            double timestamp = static_cast<double>(event.start - origin) / 1000.0;
+            file << (first ? "" : ",\n") << "{\"name\":\"" << event.name << "\",\"pid\":1,\"tid\":" << buffer->threadId << ",\"ts\":" << timestamp;
+            if (event.counter)
+            {
+                file << ",\"ph\":\"C\",\"args\":{\"value\":" << event.value << "}}";
+            }
+            else
+            {
+                file << ",\"ph\":\"X\",\"dur\":" << static_cast<double>(event.duration) / 1000.0 << "}";
+            }
+            first = false;
+        }
+    }
+    file << "\n]}\n";
+    return static_cast<bool>(file);
+}
+
+void clearTrace()
+{
+    std::lock_guard<std::mutex> lock(g_traceMutex);
+    for (const std::unique_ptr<TraceBuffer>& buffer : g_traceBuffers)
+    {
+        buffer->written = 0;
+    }
+}
+
+#endif
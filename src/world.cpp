@@ -0,0 +1,487 @@
+#include "world.h"
+#include "erosion.h"
+#include "stencil.h"
+#include "stamp.h"
+#include "StampCache.h"
+#include "parallel.h"
+#include "functions.h"
+#include "trace.h"
+#include "constants.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+void stampExact(Heightfield& world, int centerX, int centerY, int minX, int maxX, int minY, int maxY, float scale, float deviation)
+{
+    float falloff = 1.0f / (2.0f * deviation * deviation);
+    StampRowFunction stampRow = getStampRowFunction(getStampKernel());
+
+    for (int y = minY; y <= maxY; ++y)
+    {
+        float dy = static_cast<float>(y - centerY);
+        float dy2 = dy * dy;
+        int x = minX;
+        while (x <= maxX)
+        {
+            int count = std::min(maxX - x + 1, world.getContiguousRun(x));
+            stampRow(&world.at(x, y), count, static_cast<float>(x - centerX), dy2, scale, falloff);
+            x += count;
+        }
+    }
+}
+
+void stampCached(Heightfield& world, int centerX, int centerY, int minX, int maxX, int minY, int maxY, float scale, const float* profile)
+{
+    AddScaledRowFunction addScaledRow = getAddScaledRowFunction(getStampKernel());
+
+    for (int y = minY; y <= maxY; ++y)
+    {
+        float rowScale = scale * profile[y - centerY];
+        int x = minX;
+        while (x <= maxX)
+        {
+            int count = std::min(maxX - x + 1, world.getContiguousRun(x));
+            addScaledRow(&world.at(x, y), profile + (x - centerX), count, rowScale);
+            x += count;
+        }
+    }
+}
+} // namespace
+
+void markBumpDirty(Heightfield& world, const Bump& bump)
+{
+    int limit = static_cast<int>(bump.deviation * c_standardDeviationArea);
+    world.markDirty(bump.x - limit, bump.y - limit, bump.x + limit, bump.y + limit);
+}
+
+void stampBump(Heightfield& world, const Bump& bump, int minY, int maxY)
+{
+    int limit = static_cast<int>(bump.deviation * c_standardDeviationArea);
+    int minX = std::max(0, bump.x - limit);
+    int maxX = std::min(world.getWidth() - 1, bump.x + limit);
+    minY = std::max(minY, bump.y - limit);
+    maxY = std::min(maxY, bump.y + limit);
+    if (minY > maxY || minX > maxX)
+    {
+        return;
+    }
+
+    // normalDistribution(0, deviation, d) * multiplier with the constants hoisted out of the loops
+    float variance = bump.deviation * bump.deviation;
+    float scale = bump.multiplier / (bump.deviation * std::sqrt(2.0f * pi * variance));
+
+    const StampCache& cache = getStampCache();
+    if (getStampMode() == StampMode::Cached && cache.contains(bump.deviation))
+    {
+        int radius = 0;
+        const float* profile = cache.getProfile(bump.deviation, radius);
+        stampCached(world, bump.x, bump.y, minX, maxX, minY, maxY, scale, profile);
+    }
+    else
+    {
+        stampExact(world, bump.x, bump.y, minX, maxX, minY, maxY, scale, bump.deviation);
+    }
+}
+
+void stampBumps(Heightfield& world, const std::vector<Bump>& bumps, int threadCount)
+{
+    for (const Bump& bump : bumps)
+    {
+        markBumpDirty(world, bump);
+    }
+
+    int bandCount = (world.getHeight() + c_stampBandHeight - 1) / c_stampBandHeight;
+    parallelFor(bandCount, threadCount, [&](int band) {
+        TRACE_SCOPE("stampBand");
+        int minY = band * c_stampBandHeight;
+        int maxY = std::min(world.getHeight(), minY + c_stampBandHeight) - 1;
+        for (const Bump& bump : bumps)
+        {
+            stampBump(world, bump, minY, maxY);
+        }
+    });
+}
+
+float createBump(Heightfield& world, int centerX, int centerY, float bumpHeightMultiplier, float deviation)
+{
+    Bump bump = {centerX, centerY, bumpHeightMultiplier, deviation};
+    markBumpDirty(world, bump);
+    stampBump(world, bump, 0, world.getHeight() - 1);
+    return world.at(centerX, centerY);
+}
+
+bool getBumpPosition(const WorldParams& params, int iteration, int centerX, int centerY, int& x, int& y, float a, int exp)
+{
+    float relativeY = 0.0f;
+    relativeY = parabola(a, static_cast<float>(iteration), exp);
+
+    int newX = centerX + iteration;
+    int newY = centerY + static_cast<int>(relativeY);
+    int widthLimit = params.width - params.mountainEdgeMargin;
+    int heightLimit = params.height - params.mountainEdgeMargin;
+    bool insideLimits = newX >= 0 && newX <= widthLimit && newY >= 0 && newY <= heightLimit;
+
+    x = std::min(std::max(0, newX), widthLimit);
+    y = std::min(std::max(0, newY), heightLimit);
+    return insideLimits;
+}
+
+namespace
+{
+// Draw indices of the mountain parameters, bump deviations follow them
+enum MountainDraw : uint32_t
+{
+    c_lengthDraw,
+    c_heightMultiplierDraw,
+    c_centerXDraw,
+    c_centerYDraw,
+    c_iterationStartDraw,
+    c_coefficientDraw,
+    c_exponentDraw,
+    c_firstDeviationDraw
+};
+} // namespace
+
+Mountain createMountainParameters(const WorldParams& params, unsigned int seed, int mountainIndex, int regionX, int regionY)
+{
+    CounterRandom random(seed, CounterRandom::Feature::Mountain, static_cast<uint32_t>(mountainIndex), regionX, regionY);
+    int length = random.uniformInt(c_lengthDraw, params.minMountainLength, params.maxMountainLength);
+    Mountain mountain = {
+        random,
+        length,
+        random.uniformFloat(c_heightMultiplierDraw, params.minHeightMultiplier, params.maxHeightMultiplier),
+        random.uniformInt(c_centerXDraw, 0, params.width),
+        random.uniformInt(c_centerYDraw, 0, params.height),
+        random.uniformInt(c_iterationStartDraw, -length / 2, length / 2),
+        random.uniformFloat(c_coefficientDraw, params.minParabolaCoefficient, params.maxParabolaCoefficient),
+        random.uniformInt(c_exponentDraw, params.minParabolaExponent, params.maxParabolaExponent)};
+    return mountain;
+}
+
+int getMountainBumpCount(const WorldParams& params, const Mountain& mountain)
+{
+    return (mountain.length + params.bumpDensity - 1) / params.bumpDensity;
+}
+
+bool createMountainBump(const WorldParams& params, const Mountain& mountain, int bumpIndex, Bump& bump)
+{
+    int i = bumpIndex * params.bumpDensity;
+    if (!getBumpPosition(params, mountain.iterationStart + i, mountain.centerX, mountain.centerY, bump.x, bump.y, mountain.a, mountain.exp))
+    {
+        return false;
+    }
+
+    float sinStep = std::sin(static_cast<float>(i) * params.mountainWaveLength);
+    sinStep = (sinStep + 2.0f) / 2.0f;
+    bump.multiplier = mountain.baseMultiplier * sinStep;
+    bump.deviation = mountain.random.uniformFloat(c_firstDeviationDraw + static_cast<uint32_t>(bumpIndex), params.minBumpDeviation, params.maxBumpDeviation);
+    return true;
+}
+
+void createMountainBumps(const WorldParams& params, unsigned int seed, int mountainIndex, std::vector<Bump>& bumps)
+{
+    Mountain mountain = createMountainParameters(params, seed, mountainIndex);
+    int bumpCount = getMountainBumpCount(params, mountain);
+    for (int i = 0; i < bumpCount; ++i)
+    {
+        Bump bump;
+        if (createMountainBump(params, mountain, i, bump))
+        {
+            bumps.push_back(bump);
+        }
+    }
+}
+
+void createMountain(Heightfield& world, unsigned int seed, int mountainIndex, const WorldParams& params)
+{
+    std::vector<Bump> bumps;
+    createMountainBumps(params, seed, mountainIndex, bumps);
+    stampBumps(world, bumps, 1);
+}
+
+int getPitPosition(const Heightfield& world, int startHeight, int endHeight, int x, const WorldParams& params)
+{
+    return getPitPosition(world.getWidth(), startHeight, endHeight, x, params);
+}
+
+int getPitPosition(int sampleWidth, int startHeight, int endHeight, int x, const WorldParams& params)
+{
+    float yt = slope(divide(x, sampleWidth - 1), params.riverSlopeSteepness);
+    return interpolate(startHeight, endHeight, yt);
+}
+
+float getBumpCenterGain(float deviation)
+{
+    return 1.0f / (deviation * std::sqrt(2.0f * pi * deviation * deviation));
+}
+
+void carveRiver(Heightfield& world, const std::vector<RiverPoint>& pits, const WorldParams& params)
+{
+    // Bumps are linear in their multiplier, so the one that takes the center
+    // to the river depth is known before stamping
+    float gain = getBumpCenterGain(params.riverDeviation);
+    for (const RiverPoint& pit : pits)
+    {
+        int x = static_cast<int>(std::lround(pit.x));
+        int y = static_cast<int>(std::lround(pit.y));
+        if (x < 0 || y < 0 || x >= world.getWidth() || y >= world.getHeight())
+        {
+            continue;
+        }
+        float excess = world.at(x, y) + params.riverDepth;
+        if (excess > 0.0f)
+        {
+            Bump bump = {x, y, -excess / gain, params.riverDeviation};
+            markBumpDirty(world, bump);
+            stampBump(world, bump, 0, world.getHeight() - 1);
+        }
+    }
+}
+
+void getRiverPits(const std::vector<RiverPoint>& controlPoints, float spacing, std::vector<RiverPoint>& pits)
+{
+    pits.clear();
+    if (controlPoints.empty())
+    {
+        return;
+    }
+    pits.push_back(controlPoints.front());
+
+    // Segments are walked in steps of about a tenth of the spacing
+    float travelled = 0.0f;
+    RiverPoint previous = controlPoints.front();
+    int last = static_cast<int>(controlPoints.size()) - 1;
+    for (int i = 0; i < last; ++i)
+    {
+        const RiverPoint& p0 = controlPoints[std::max(i - 1, 0)];
+        const RiverPoint& p1 = controlPoints[i];
+        const RiverPoint& p2 = controlPoints[i + 1];
+        const RiverPoint& p3 = controlPoints[std::min(i + 2, last)];
+        float chord = std::sqrt((p2.x - p1.x) * (p2.x - p1.x) + (p2.y - p1.y) * (p2.y - p1.y));
+        int steps = std::max(1, static_cast<int>(std::ceil(chord * 10.0f / spacing)));
+        for (int step = 1; step <= steps; ++step)
+        {
+            float t = static_cast<float>(step) / static_cast<float>(steps);
+            float t2 = t * t;
+            float t3 = t2 * t;
+            RiverPoint point = {
+                0.5f * (2.0f * p1.x + (p2.x - p0.x) * t + (2.0f * p0.x - 5.0f * p1.x + 4.0f * p2.x - p3.x) * t2 + (3.0f * p1.x - p0.x - 3.0f * p2.x + p3.x) * t3),
+                0.5f * (2.0f * p1.y + (p2.y - p0.y) * t + (2.0f * p0.y - 5.0f * p1.y + 4.0f * p2.y - p3.y) * t2 + (3.0f * p1.y - p0.y - 3.0f * p2.y + p3.y) * t3)};
+            travelled += std::sqrt((point.x - previous.x) * (point.x - previous.x) + (point.y - previous.y) * (point.y - previous.y));
+            previous = point;
+            if (travelled >= spacing)
+            {
+                pits.push_back(point);
+                travelled = 0.0f;
+            }
+        }
+    }
+}
+
+void createRiver(Heightfield& world, const WorldParams& params)
+{
+    TRACE_SCOPE("createRiver");
+    int startHeight = params.riverEndPointMargin;
+    int endHeight = world.getHeight() - 1 - params.riverEndPointMargin;
+
+    std::vector<RiverPoint> pits;
+    for (int x = 0; x < world.getWidth(); x += params.riverPitDensity)
+    {
+        int y = getPitPosition(world, startHeight, endHeight, x, params);
+        pits.push_back({static_cast<float>(x), static_cast<float>(y)});
+    }
+    carveRiver(world, pits, params);
+}
+
+void createRiverPath(const WorldParams& params, unsigned int seed, int riverIndex, std::vector<RiverPoint>& controlPoints)
+{
+    // Draw 0 picks the direction, the rest the cross positions of the points
+    CounterRandom random(seed, CounterRandom::Feature::River, static_cast<uint32_t>(riverIndex));
+    bool vertical = random.uniformInt(0, 0, 1) == 1;
+    float length = static_cast<float>(vertical ? params.height : params.width);
+    float across = static_cast<float>(vertical ? params.width : params.height);
+    float margin = std::min(static_cast<float>(params.riverEndPointMargin), across / 2.0f);
+
+    controlPoints.clear();
+    for (int i = 0; i < params.riverControlPoints; ++i)
+    {
+        float along = length * static_cast<float>(i) / static_cast<float>(params.riverControlPoints - 1);
+        float position = random.uniformFloat(1 + static_cast<uint32_t>(i), margin, across - margin);
+        controlPoints.push_back(vertical ? RiverPoint{position, along} : RiverPoint{along, position});
+    }
+}
+
+void createRivers(Heightfield& world, unsigned int seed, const WorldParams& params)
+{
+    TRACE_SCOPE("createRivers");
+    if (params.numRivers > 0)
+    {
+        createRiver(world, params);
+    }
+
+    std::vector<RiverPoint> controlPoints;
+    std::vector<RiverPoint> pits;
+    for (int i = 1; i < params.numRivers; ++i)
+    {
+        createRiverPath(params, seed, i, controlPoints);
+        getRiverPits(controlPoints, static_cast<float>(params.riverPitDensity), pits);
+        carveRiver(world, pits, params);
+    }
+}
+
+namespace
+{
+// Calls edit(sample, t) for the samples within reach * radius, t is the distance in radii
+template<typename Edit>
+void editArea(Heightfield& world, int centerX, int centerY, float radius, float reach, Edit edit)
+{
+    int limit = static_cast<int>(std::ceil(radius * reach));
+    int minX = std::max(centerX - limit, 0);
+    int maxX = std::min(centerX + limit, world.getWidth() - 1);
+    int minY = std::max(centerY - limit, 0);
+    int maxY = std::min(centerY + limit, world.getHeight() - 1);
+    for (int y = minY; y <= maxY; ++y)
+    {
+        for (int x = minX; x <= maxX; ++x)
+        {
+            float t = distance(x, y, centerX, centerY) / radius;
+            if (t < reach)
+            {
+                edit(world.at(x, y), t);
+            }
+        }
+    }
+    world.markDirty(minX, minY, maxX, maxY);
+}
+} // namespace
+
+void createCrater(Heightfield& world, int centerX, int centerY, float radius, float depth)
+{
+    // Parabolic bowl meeting the rim at the radius, the rim falls off quadratically
+    editArea(world, centerX, centerY, radius, 1.0f + c_craterRimWidth, [&](float& height, float t) {
+        if (t < 1.0f)
+        {
+            height += depth * ((1.0f + c_craterRimHeight) * t * t - 1.0f);
+        }
+        else
+        {
+            float rim = 1.0f - (t - 1.0f) / c_craterRimWidth;
+            height += depth * c_craterRimHeight * rim * rim;
+        }
+    });
+}
+
+void flattenArea(Heightfield& world, int centerX, int centerY, float radius, float height)
+{
+    editArea(world, centerX, centerY, radius, 1.0f, [&](float& sample, float t) {
+        float s = std::min(std::max(2.0f - 2.0f * t, 0.0f), 1.0f);
+        float weight = s * s * (3.0f - 2.0f * s);
+        sample += weight * (height - sample);
+    });
+}
+
+void generateWorld(Heightfield& world, unsigned int seed, const WorldParams& params, int threadCount, std::vector<Bump>& bumps, Heightfield& scratch)
+{
+    TRACE_SCOPE("generateWorld");
+    if (world.getWidth() != params.width + 1 || world.getHeight() != params.height + 1)
+    {
+        world.resize(params.width + 1, params.height + 1, world.getLayout());
+    }
+    world.fill(0.0f);
+
+    // The random draws do not depend on the heights, so all mountains are
+    // planned first and stamped in one pass
+    {
+        TRACE_SCOPE("planMountains");
+        bumps.clear();
+        for (int i = 0; i < params.numMountains; ++i)
+        {
+            createMountainBumps(params, seed, i, bumps);
+        }
+    }
+    TRACE_COUNTER("bumps", bumps.size());
+    {
+        TRACE_SCOPE("stampBumps");
+        stampBumps(world, bumps, threadCount);
+    }
+
+    createRivers(world, seed, params);
+
+    if (params.erosionDroplets > 0)
+    {
+        erodeHydraulic(world, seed, params, threadCount);
+    }
+    if (params.thermalIterations > 0 || params.smoothIterations > 0)
+    {
+        erodeThermal(world, scratch, params.thermalIterations, params.thermalTalus, params.thermalRate, threadCount);
+        smoothHeights(world, scratch, params.smoothIterations, params.smoothStrength, threadCount);
+    }
+}
+
+void generateWorld(Heightfield& world, unsigned int seed, const WorldParams& params, int threadCount)
+{
+    std::vector<Bump> bumps;
+    Heightfield scratch;
+    generateWorld(world, seed, params, threadCount, bumps, scratch);
+}
+
+void generateWorld(Heightfield& world, unsigned int seed, int threadCount)
+{
+    WorldParams params;
+    params.width = world.getWidth() - 1;
+    params.height = world.getHeight() - 1;
+    generateWorld(world, seed, params, threadCount);
+}
+
+void createRegionBumps(const WorldParams& params, unsigned int seed, int regionX, int regionY, std::vector<Bump>& bumps)
+{
+    int originX = regionX * params.width;
+    int originY = regionY * params.height;
+    for (int m = 0; m < params.numMountains; ++m)
+    {
+        Mountain mountain = createMountainParameters(params, seed, m, regionX, regionY);
+        int bumpCount = getMountainBumpCount(params, mountain);
+        for (int i = 0; i < bumpCount; ++i)
+        {
+            Bump bump;
+            if (createMountainBump(params, mountain, i, bump))
+            {
+                bump.x += originX;
+                bump.y += originY;
+                bumps.push_back(bump);
+            }
+        }
+    }
+}
+
+void generateWindow(Heightfield& window, unsigned int seed, int originX, int originY, const WorldParams& params)
+{
+    TRACE_SCOPE("generateWindow");
+    window.fill(0.0f);
+
+    // Regions are visited in row-major order so that every window applies the
+    // bumps covering a sample in the same order
+    int reach = static_cast<int>(params.maxBumpDeviation * c_standardDeviationArea) + 1;
+    int firstRegionX = floorDivide(originX - reach, params.width);
+    int lastRegionX = floorDivide(originX + window.getWidth() - 1 + reach, params.width);
+    int firstRegionY = floorDivide(originY - reach, params.height);
+    int lastRegionY = floorDivide(originY + window.getHeight() - 1 + reach, params.height);
+
+    std::vector<Bump> bumps;
+    for (int regionY = firstRegionY; regionY <= lastRegionY; ++regionY)
+    {
+        for (int regionX = firstRegionX; regionX <= lastRegionX; ++regionX)
+        {
+            createRegionBumps(params, seed, regionX, regionY, bumps);
+        }
+    }
+
+    for (Bump& bump : bumps)
+    {
+        bump.x -= originX;
+        bump.y -= originY;
+    }
+    stampBumps(window, bumps, 1);
+}
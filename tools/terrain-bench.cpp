@@ -0,0 +1,2045 @@
+#include "Heightfield.h"
+#include "stamp.h"
+#include "StampCache.h"
+#include "world.h"
+#include "mesh.h"
+#include "parallel.h"
+#include "TerrainStreamer.h"
+#include "Geomipmap.h"
+#include "culling.h"
+#include "WorldCache.h"
+#include "erosion.h"
+#include "stencil.h"
+#include "trace.h"
+#include "outOfCore.h"
+#include "HeightQuery.h"
+#include "HeightPyramid.h"
+#include "Rtin.h"
+#include "functions.h"
+#include "constants.h"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+typedef std::chrono::high_resolution_clock Clock;
+
+double secondsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Correctness checks that failed, main returns nonzero when any did
+int failedChecks = 0;
+
+// Counts a failed check and passes the result on for printing
+bool check(bool passed, const std::string& name)
+{
+    if (!passed)
+    {
+        ++failedChecks;
+        std::cerr << "FAILED: " << name << "\n";
+    }
+    return passed;
+}
+
+struct TestBump
+{
+    int x;
+    int y;
+    float multiplier;
+    float deviation;
+};
+
+std::vector<TestBump> createTestBumps(const Heightfield& world, int count, unsigned int seed)
+{
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int> randomX(0, world.getWidth() - 1);
+    std::uniform_int_distribution<int> randomY(0, world.getHeight() - 1);
+    std::uniform_real_distribution<float> randomMultiplier(c_minHeightMultiplier, c_maxHeightMultiplier);
+    std::uniform_real_distribution<float> randomDeviation(c_minBumpDeviation, c_maxBumpDeviation);
+
+    std::vector<TestBump> bumps(count);
+    for (TestBump& bump : bumps)
+    {
+        bump.x = randomX(rng);
+        bump.y = randomY(rng);
+        bump.multiplier = randomMultiplier(rng);
+        bump.deviation = randomDeviation(rng);
+    }
+    return bumps;
+}
+
+// The original per cell formula, kept as the accuracy reference
+void stampReference(Heightfield& world, const TestBump& bump)
+{
+    int limit = static_cast<int>(bump.deviation * c_standardDeviationArea);
+    for (int y = std::max(0, bump.y - limit); y <= std::min(world.getHeight() - 1, bump.y + limit); ++y)
+    {
+        for (int x = std::max(0, bump.x - limit); x <= std::min(world.getWidth() - 1, bump.x + limit); ++x)
+        {
+            float d = distance(bump.x, bump.y, x, y);
+            world.at(x, y) += normalDistribution(0.0f, bump.deviation, d) * bump.multiplier;
+        }
+    }
+}
+
+long long countStampedCells(const Heightfield& world, const std::vector<TestBump>& bumps)
+{
+    long long cells = 0;
+    for (const TestBump& bump : bumps)
+    {
+        int limit = static_cast<int>(bump.deviation * c_standardDeviationArea);
+        long long width = std::min(world.getWidth() - 1, bump.x + limit) - std::max(0, bump.x - limit) + 1;
+        long long height = std::min(world.getHeight() - 1, bump.y + limit) - std::max(0, bump.y - limit) + 1;
+        cells += width * height;
+    }
+    return cells;
+}
+
+float maxAbsDifference(const Heightfield& a, const Heightfield& b)
+{
+    float maxDifference = 0.0f;
+    for (int y = 0; y < a.getHeight(); ++y)
+    {
+        for (int x = 0; x < a.getWidth(); ++x)
+        {
+            maxDifference = std::max(maxDifference, std::abs(a.at(x, y) - b.at(x, y)));
+        }
+    }
+    return maxDifference;
+}
+
+double stampBumps(Heightfield& world, const std::vector<TestBump>& bumps)
+{
+    Clock::time_point start = Clock::now();
+    for (const TestBump& bump : bumps)
+    {
+        createBump(world, bump.x, bump.y, bump.multiplier, bump.deviation);
+    }
+    return secondsSince(start);
+}
+
+void benchmarkStamp()
+{
+    const int worldSize = 1024;
+    const int bumpCount = 2000;
+
+    Heightfield reference(worldSize, worldSize);
+    std::vector<TestBump> bumps = createTestBumps(reference, bumpCount, c_seed);
+    long long cells = countStampedCells(reference, bumps);
+
+    Clock::time_point start = Clock::now();
+    for (const TestBump& bump : bumps)
+    {
+        stampReference(reference, bump);
+    }
+    double referenceSeconds = secondsSince(start);
+    std::cout << "stamp reference: " << cells / referenceSeconds / 1.0e6 << " Mcells/s\n";
+
+    // Relative error of a single bump against the reference formula
+    TestBump single = {worldSize / 2, worldSize / 2, 1.0f, c_maxBumpDeviation};
+    Heightfield singleReference(worldSize, worldSize);
+    stampReference(singleReference, single);
+
+    StampKernel defaultKernel = getStampKernel();
+    StampMode defaultMode = getStampMode();
+    Heightfield scalarExact;
+    Heightfield scalarCached;
+    const StampKernel kernels[] = {StampKernel::Scalar, StampKernel::SSE, StampKernel::AVX2};
+    for (StampKernel kernel : kernels)
+    {
+        if (!isStampKernelSupported(kernel))
+        {
+            std::cout << "stamp " << getStampKernelName(kernel) << ": not supported\n";
+            continue;
+        }
+        setStampKernel(kernel);
+
+        setStampMode(StampMode::Exact);
+        Heightfield exact(worldSize, worldSize);
+        double exactSeconds = stampBumps(exact, bumps);
+
+        Heightfield singleWorld(worldSize, worldSize);
+        createBump(singleWorld, single.x, single.y, single.multiplier, single.deviation);
+        float maxRelativeError = 0.0f;
+        for (int y = 0; y < worldSize; ++y)
+        {
+            for (int x = 0; x < worldSize; ++x)
+            {
+                float expected = singleReference.at(x, y);
+                if (expected > 0.0f)
+                {
+                    maxRelativeError = std::max(maxRelativeError, std::abs(singleWorld.at(x, y) - expected) / expected);
+                }
+            }
+        }
+
+        setStampMode(StampMode::Cached);
+        Heightfield cached(worldSize, worldSize);
+        double cachedSeconds = stampBumps(cached, bumps);
+
+        if (kernel == StampKernel::Scalar)
+        {
+            scalarExact = exact;
+            scalarCached = cached;
+        }
+        bool identical = std::equal(exact.data(), exact.data() + exact.getSize(), scalarExact.data())
+                         && std::equal(cached.data(), cached.data() + cached.getSize(), scalarCached.data());
+        check(identical, std::string("stamp ") + getStampKernelName(kernel) + " matches scalar");
+
+        std::cout << "stamp " << getStampKernelName(kernel) << " exact: " << cells / exactSeconds / 1.0e6 << " Mcells/s, "
+                  << referenceSeconds / exactSeconds << "x reference, max abs error " << maxAbsDifference(exact, reference)
+                  << ", max relative error " << maxRelativeError << "\n";
+        std::cout << "stamp " << getStampKernelName(kernel) << " cached: " << cells / cachedSeconds / 1.0e6 << " Mcells/s, "
+                  << referenceSeconds / cachedSeconds << "x reference, max abs error vs exact " << maxAbsDifference(cached, exact)
+                  << (identical ? ", matches scalar" : ", DIFFERS from scalar") << "\n";
+    }
+    setStampKernel(defaultKernel);
+    setStampMode(defaultMode);
+
+    const StampCache& cache = getStampCache();
+    std::cout << "stamp cache: " << cache.getProfileCount() << " profiles, step " << c_stampDeviationStep << ", "
+              << cache.getMemoryUsage() / 1024.0 << " KiB separable, "
+              << cache.getTileMemoryUsage() / 1024.0 << " KiB as 2D tiles\n";
+}
+
+void benchmarkGenerate()
+{
+    const int worldSizes[] = {1024, 4096};
+    const int threadCounts[] = {1, 2, 4, 8};
+
+    for (int worldSize : worldSizes)
+    {
+        Heightfield serial(worldSize + 1, worldSize + 1);
+        Clock::time_point start = Clock::now();
+        generateWorld(serial, c_seed, 1);
+        double serialSeconds = secondsSince(start);
+
+        for (int threadCount : threadCounts)
+        {
+            Heightfield world(worldSize + 1, worldSize + 1);
+            start = Clock::now();
+            generateWorld(world, c_seed, threadCount);
+            double seconds = secondsSince(start);
+            bool identical = std::equal(world.data(), world.data() + world.getSize(), serial.data());
+            check(identical, "generate " + std::to_string(worldSize) + " on " + std::to_string(threadCount) + " threads matches serial");
+            std::cout << "generate " << worldSize << "^2, " << threadCount << " threads: " << seconds * 1000.0 << " ms, "
+                      << serialSeconds / seconds << "x serial" << (identical ? ", matches serial" : ", DIFFERS from serial") << "\n";
+        }
+    }
+    std::cout << "hardware threads: " << getDefaultThreadCount() << "\n";
+}
+
+// Fraction of indices found in a FIFO post-transform cache and average
+// transformed vertices per triangle
+template<typename Index>
+void simulateVertexCache(const Index* indices, size_t count, int baseVertex, size_t cacheSize, size_t& hits)
+{
+    std::vector<long long> cache(cacheSize, -1);
+    size_t next = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        long long vertex = static_cast<long long>(indices[i]) + baseVertex;
+        if (std::find(cache.begin(), cache.end(), vertex) != cache.end())
+        {
+            ++hits;
+            continue;
+        }
+        cache[next] = vertex;
+        next = (next + 1) % cacheSize;
+    }
+}
+
+void benchmarkMesh()
+{
+    const size_t cacheSize = 32;
+    const int worldSize = c_worldWidth;
+
+    Heightfield world(worldSize + 1, worldSize + 1);
+    generateWorld(world, c_seed, getDefaultThreadCount());
+
+    Clock::time_point start = Clock::now();
+    std::vector<int> indices;
+    std::vector<float> vertices;
+    generateMesh(world, indices, vertices);
+    double soupSeconds = secondsSince(start);
+    size_t soupBytes = indices.size() * sizeof(int) + vertices.size() * sizeof(float);
+    size_t soupHits = 0;
+    simulateVertexCache(indices.data(), indices.size(), 0, cacheSize, soupHits);
+    size_t triangles = indices.size() / 3;
+
+    start = Clock::now();
+    IndexedMesh mesh;
+    generateIndexedMesh(world, mesh);
+    double indexedSeconds = secondsSince(start);
+    size_t indexedHits = 0;
+    for (const MeshChunk& chunk : mesh.chunks)
+    {
+        if (mesh.wideIndices)
+        {
+            simulateVertexCache(&mesh.indices32[chunk.firstIndex], chunk.indexCount, chunk.baseVertex, cacheSize, indexedHits);
+        }
+        else
+        {
+            simulateVertexCache(&mesh.indices16[chunk.firstIndex], chunk.indexCount, chunk.baseVertex, cacheSize, indexedHits);
+        }
+    }
+
+    std::cout << "mesh " << worldSize << "^2 soup: " << soupSeconds * 1000.0 << " ms, " << soupBytes / (1024.0 * 1024.0) << " MiB, "
+              << vertices.size() / 6 << " vertices, cache hit rate " << static_cast<double>(soupHits) / indices.size()
+              << ", ACMR " << static_cast<double>(indices.size() - soupHits) / triangles << "\n";
+    std::cout << "mesh " << worldSize << "^2 indexed: " << indexedSeconds * 1000.0 << " ms, " << mesh.getMemoryUsage() / (1024.0 * 1024.0) << " MiB, "
+              << mesh.getVertexCount() << " vertices, " << mesh.chunks.size() << " chunks, " << (mesh.wideIndices ? 32 : 16) << "-bit indices, cache hit rate "
+              << static_cast<double>(indexedHits) / mesh.getIndexCount() << ", ACMR " << static_cast<double>(mesh.getIndexCount() - indexedHits) / triangles << "\n";
+    std::cout << "mesh memory saved: " << 100.0 * (1.0 - static_cast<double>(mesh.getMemoryUsage()) / soupBytes) << "% (FIFO cache of "
+              << cacheSize << " vertices)\n";
+
+    const int normalBits[] = {8, 16};
+    for (int bits : normalBits)
+    {
+        start = Clock::now();
+        PackedMesh packed;
+        generatePackedMesh(world, bits, packed);
+        double packedSeconds = secondsSince(start);
+
+        // Round trip of every vertex against the heightfield and the float normals
+        float maxHeightError = 0.0f;
+        float minNormalDot = 1.0f;
+        bool crackFree = true;
+        bool withinStep = true;
+        for (size_t c = 0; c < packed.chunks.size(); ++c)
+        {
+            const PackedChunk& chunk = packed.chunks[c];
+            int vertexCount = static_cast<int>((c + 1 < packed.chunks.size() ? packed.chunks[c + 1].baseVertex : packed.getVertexCount()) - chunk.baseVertex);
+            for (int i = 0; i < vertexCount; ++i)
+            {
+                float position[3];
+                float normal[3];
+                unpackVertex(packed, chunk, i, position, normal);
+                int x = i % packed.width;
+                int y = chunk.firstRow + i / packed.width;
+                float heightError = std::abs(position[1] - world.at(x, y));
+                maxHeightError = std::max(maxHeightError, heightError);
+
+                // Rows inside a chunk round to the nearest step, shared rows
+                // floor to the coarser step of the two chunks
+                float bound = chunk.heightStep / 2.0f;
+                if (c > 0 && i < packed.width)
+                {
+                    bound = std::max(chunk.heightStep, packed.chunks[c - 1].heightStep);
+                }
+                if (c + 1 < packed.chunks.size() && i >= vertexCount - packed.width)
+                {
+                    bound = std::max(chunk.heightStep, packed.chunks[c + 1].heightStep);
+                }
+                // Plus the float rounding of the offset from the chunk minimum
+                bound += 2.0f * std::numeric_limits<float>::epsilon() * (std::abs(chunk.minHeight) + std::abs(world.at(x, y)));
+                withinStep = withinStep && heightError <= bound;
+
+                float expected[3];
+                getSampleNormal(world, x, y, expected);
+                minNormalDot = std::min(minNormalDot, normal[0] * expected[0] + normal[1] * expected[1] + normal[2] * expected[2]);
+
+                // The first row of a chunk is the last row of the previous one
+                if (c > 0 && i < packed.width)
+                {
+                    const PackedChunk& previous = packed.chunks[c - 1];
+                    float previousPosition[3];
+                    unpackVertex(packed, previous, (y - previous.firstRow) * packed.width + x, previousPosition, normal);
+                    crackFree = crackFree && previousPosition[1] == position[1];
+                }
+            }
+        }
+
+        // Octahedral error of 8-bit normals is just under a degree
+        float maxNormalDegrees = std::acos(std::min(minNormalDot, 1.0f)) * 180.0f / pi;
+        float normalTolerance = bits <= 8 ? 1.5f : 0.1f;
+        std::string name = "mesh packed " + std::to_string(bits) + "-bit normals";
+        check(crackFree, name + " chunk borders");
+        check(withinStep, name + " height within the quantization step");
+        check(maxNormalDegrees <= normalTolerance, name + " normal error");
+
+        size_t packedIndexBytes = packed.getIndexCount() * (packed.wideIndices ? 4 : 2);
+        std::cout << "mesh " << worldSize << "^2 packed " << bits << "-bit normals: " << packedSeconds * 1000.0 << " ms, "
+                  << packed.getMemoryUsage() / (1024.0 * 1024.0) << " MiB, " << packed.stride << " bytes/vertex (indexed "
+                  << 6 * sizeof(float) << "), vertex data " << (packed.getMemoryUsage() - packedIndexBytes) / 1024.0 << " KiB vs "
+                  << mesh.vertices.size() * sizeof(float) / 1024.0 << " KiB, max height error " << maxHeightError
+                  << ", max normal error " << maxNormalDegrees << " deg"
+                  << (crackFree ? ", chunk borders match" : ", CRACKS at chunk borders") << "\n";
+    }
+
+    // Vertices of shaders/heightmap.vert against the indexed mesh
+    const int textureBits[] = {32, 16};
+    std::vector<uint16_t> gridVertices;
+    std::vector<uint16_t> gridIndices;
+    generateGridMesh(c_gridTileSize, gridVertices, gridIndices);
+    size_t gridBytes = gridVertices.size() * sizeof(uint16_t) + gridIndices.size() * sizeof(uint16_t);
+    for (int bits : textureBits)
+    {
+        start = Clock::now();
+        HeightTexture texture;
+        generateHeightTexture(world, bits, texture);
+        double textureSeconds = secondsSince(start);
+
+        float maxPositionError = 0.0f;
+        float maxNormalError = 0.0f;
+        for (int y = 0; y < texture.height; ++y)
+        {
+            for (int x = 0; x < texture.width; ++x)
+            {
+                float position[3];
+                float normal[3];
+                getHeightTextureVertex(texture, x, y, position, normal);
+                const float* expected = &mesh.vertices[(static_cast<size_t>(y) * texture.width + x) * 6];
+                for (int k = 0; k < 3; ++k)
+                {
+                    maxPositionError = std::max(maxPositionError, std::abs(position[k] - expected[k]));
+                    maxNormalError = std::max(maxNormalError, std::abs(normal[k] - expected[3 + k]));
+                }
+            }
+        }
+
+        int tileCountX = 0;
+        int tileCount = getGridTileCount(texture, c_gridTileSize, tileCountX);
+        std::cout << "mesh " << worldSize << "^2 height texture " << bits << "-bit: " << textureSeconds * 1000.0 << " ms, "
+                  << texture.getMemoryUsage() / 1024.0 << " KiB + grid " << gridBytes / 1024.0 << " KiB drawn " << tileCount << " times, "
+                  << static_cast<double>(soupBytes) / texture.getMemoryUsage() << "x smaller than soup, "
+                  << static_cast<double>(mesh.getMemoryUsage()) / texture.getMemoryUsage() << "x smaller than indexed, max position error "
+                  << maxPositionError << ", max normal component error " << maxNormalError << "\n";
+    }
+
+    // Octahedral round trip over normals of the whole sphere
+    std::mt19937 rng(c_seed);
+    std::normal_distribution<float> gaussian(0.0f, 1.0f);
+    for (int bits : normalBits)
+    {
+        float minDot = 1.0f;
+        for (int i = 0; i < 100000; ++i)
+        {
+            glm::vec3 n = glm::normalize(glm::vec3(gaussian(rng), gaussian(rng), gaussian(rng)));
+            float normal[3] = {n.x, n.y, n.z};
+            uint32_t u = 0;
+            uint32_t v = 0;
+            encodeOctahedral(normal, bits, u, v);
+            float decoded[3];
+            decodeOctahedral(u, v, bits, decoded);
+            minDot = std::min(minDot, n.x * decoded[0] + n.y * decoded[1] + n.z * decoded[2]);
+        }
+        float maxDegrees = std::acos(std::min(minDot, 1.0f)) * 180.0f / pi;
+        check(maxDegrees <= (bits <= 8 ? 1.5f : 0.1f), "octahedral " + std::to_string(bits) + "-bit round trip");
+        std::cout << "octahedral " << bits << "-bit: max error " << maxDegrees << " deg\n";
+    }
+}
+
+// The original triangle soup with a push_back per float, kept as the reference
+void addVertexReference(std::vector<float>& vertices, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c)
+{
+    auto addVec3 = [](std::vector<float>& vec, const glm::vec3& v) {
+        vec.push_back(v.x);
+        vec.push_back(v.y);
+        vec.push_back(v.z);
+    };
+
+    addVec3(vertices, a);
+    addVec3(vertices, glm::normalize(glm::cross(c - a, b - a)));
+
+    addVec3(vertices, b);
+    addVec3(vertices, glm::normalize(glm::cross(a - b, c - b)));
+
+    addVec3(vertices, c);
+    addVec3(vertices, glm::normalize(glm::cross(b - c, a - c)));
+}
+
+void generateMeshReference(const Heightfield& world, std::vector<int>& indices, std::vector<float>& vertices)
+{
+    const int verticesPerSquare = 6;
+    int columns = world.getWidth() - 1;
+    int rows = world.getHeight() - 1;
+    int count = columns * rows * verticesPerSquare;
+
+    indices.reserve(count);
+    vertices.reserve(count);
+
+    for (int h = 0; h < rows; ++h)
+    {
+        for (int w = 0; w < columns; ++w)
+        {
+            float x = static_cast<float>(w) * c_worldScale;
+            float z = static_cast<float>(h) * c_worldScale;
+
+            glm::vec3 a(x, world.at(w, h), z);
+            glm::vec3 b(x + c_worldScale, world.at(w + 1, h), z);
+            glm::vec3 c(x, world.at(w, h + 1), z + c_worldScale);
+            addVertexReference(vertices, a, b, c);
+
+            a = glm::vec3(x + c_worldScale, world.at(w + 1, h), z);
+            b = glm::vec3(x + c_worldScale, world.at(w + 1, h + 1), z + c_worldScale);
+            c = glm::vec3(x, world.at(w, h + 1), z + c_worldScale);
+            addVertexReference(vertices, a, b, c);
+        }
+    }
+
+    for (int i = 0; i < count; ++i)
+    {
+        indices.push_back(i);
+    }
+}
+
+void benchmarkSoup()
+{
+    const int worldSizes[] = {c_worldWidth, 2048};
+    const int threadCounts[] = {1, 2, 4, 8};
+    for (int worldSize : worldSizes)
+    {
+        Heightfield world(worldSize + 1, worldSize + 1);
+        generateWorld(world, c_seed, getDefaultThreadCount());
+
+        std::vector<int> referenceIndices;
+        std::vector<float> referenceVertices;
+        Clock::time_point start = Clock::now();
+        generateMeshReference(world, referenceIndices, referenceVertices);
+        double referenceSeconds = secondsSince(start);
+        double vertexCount = static_cast<double>(referenceIndices.size());
+        std::cout << "soup " << worldSize << "^2 reference: " << referenceSeconds * 1000.0 << " ms, " << vertexCount / referenceSeconds / 1e6
+                  << " M vertices/s\n";
+
+        std::vector<int> serialIndices;
+        std::vector<float> serialVertices;
+        generateMesh(world, serialIndices, serialVertices, 1);
+        float maxDifference = 0.0f;
+        for (size_t i = 0; i < serialVertices.size(); ++i)
+        {
+            maxDifference = std::max(maxDifference, std::abs(serialVertices[i] - referenceVertices[i]));
+        }
+
+        // Buffers are kept between runs like in a batch
+        std::vector<int> indices;
+        std::vector<float> vertices;
+        for (int threadCount : threadCounts)
+        {
+            generateMesh(world, indices, vertices, threadCount);
+            start = Clock::now();
+            generateMesh(world, indices, vertices, threadCount);
+            double seconds = secondsSince(start);
+            bool identical = indices == serialIndices && vertices == serialVertices;
+            check(identical, "soup " + std::to_string(worldSize) + " on " + std::to_string(threadCount) + " threads matches serial");
+            std::cout << "  " << threadCount << " threads: " << seconds * 1000.0 << " ms, " << vertexCount / seconds / 1e6 << " M vertices/s, "
+                      << referenceSeconds / seconds << "x reference" << (identical ? ", matches serial" : ", DIFFERS from serial") << "\n";
+        }
+        // Vertices differ from the reference only by float rounding
+        check(referenceIndices == serialIndices && maxDifference <= 1.0e-5f, "soup " + std::to_string(worldSize) + " matches reference");
+        std::cout << "  max difference to reference " << maxDifference << (referenceIndices == serialIndices ? ", same indices" : ", DIFFERENT indices")
+                  << "\n";
+    }
+}
+
+// Edges used by a single triangle must be on the world border, otherwise the mesh has a crack
+size_t countOpenEdges(const std::vector<uint32_t>& indices, int width, int height)
+{
+    std::unordered_map<uint64_t, int> edges;
+    for (size_t i = 0; i < indices.size(); i += 3)
+    {
+        for (int k = 0; k < 3; ++k)
+        {
+            uint32_t a = indices[i + k];
+            uint32_t b = indices[i + (k + 1) % 3];
+            ++edges[(static_cast<uint64_t>(std::min(a, b)) << 32) | std::max(a, b)];
+        }
+    }
+
+    size_t openEdges = 0;
+    for (const auto& edge : edges)
+    {
+        uint32_t a = static_cast<uint32_t>(edge.first >> 32);
+        uint32_t b = static_cast<uint32_t>(edge.first);
+        int ax = a % width, ay = a / width, bx = b % width, by = b / width;
+        bool border = (ax == bx && (ax == 0 || ax == width - 1)) || (ay == by && (ay == 0 || ay == height - 1));
+        openEdges += edge.second == 1 && !border;
+    }
+    return openEdges;
+}
+
+// Flies a circle over the world, 300 frames
+void benchmarkLod()
+{
+    const int worldSizes[] = {c_worldWidth, 2048};
+    const int frameCount = 300;
+    const float fov = 45.0f * pi / 180.0f;
+    glm::mat4 projection = glm::perspective(fov, static_cast<float>(c_screenWidth) / c_screenHeight, 0.1f, 100.0f);
+    float pixelScale = Geomipmap::getPixelScale(projection, c_screenHeight);
+
+    for (int worldSize : worldSizes)
+    {
+        Heightfield world(worldSize + 1, worldSize + 1);
+        generateWorld(world, c_seed, getDefaultThreadCount());
+        float maxHeight = *std::max_element(world.data(), world.data() + world.getSize());
+
+        Clock::time_point start = Clock::now();
+        Geomipmap geomipmap(world);
+        double setupSeconds = secondsSince(start);
+
+        float extent = static_cast<float>(worldSize) * c_worldScale;
+        std::vector<uint32_t> indices;
+        std::vector<size_t> patchOffsets;
+        double selectSeconds = 0.0;
+        double buildSeconds = 0.0;
+        size_t triangles = 0;
+        size_t minTriangles = SIZE_MAX;
+        size_t maxTriangles = 0;
+        size_t openEdges = 0;
+        for (int frame = 0; frame < frameCount; ++frame)
+        {
+            float angle = 2.0f * pi * static_cast<float>(frame) / frameCount;
+            glm::vec3 position(0.5f * extent + 0.35f * extent * std::cos(angle), maxHeight + 0.5f,
+                               0.5f * extent + 0.35f * extent * std::sin(angle));
+
+            start = Clock::now();
+            geomipmap.selectLevels(position, pixelScale, c_lodPixelError);
+            selectSeconds += secondsSince(start);
+
+            start = Clock::now();
+            geomipmap.buildIndices(indices, patchOffsets);
+            buildSeconds += secondsSince(start);
+
+            triangles += indices.size() / 3;
+            minTriangles = std::min(minTriangles, indices.size() / 3);
+            maxTriangles = std::max(maxTriangles, indices.size() / 3);
+            if (frame % 50 == 0)
+            {
+                openEdges += countOpenEdges(indices, world.getWidth(), world.getHeight());
+            }
+        }
+
+        check(openEdges == 0, "lod " + std::to_string(worldSize) + " has no cracks");
+        size_t fullTriangles = 2 * static_cast<size_t>(worldSize) * worldSize;
+        std::cout << "lod " << worldSize << "^2, " << geomipmap.getPatchCountX() * geomipmap.getPatchCountY() << " patches, "
+                  << geomipmap.getLevelCount() << " levels, setup " << setupSeconds * 1000.0 << " ms\n"
+                  << "  triangles/frame " << triangles / frameCount << " (min " << minTriangles << ", max " << maxTriangles << ") of "
+                  << fullTriangles << ", " << static_cast<double>(fullTriangles) * frameCount / triangles << "x fewer\n"
+                  << "  selection " << selectSeconds * 1000.0 / frameCount << " ms/frame, index build "
+                  << buildSeconds * 1000.0 / frameCount << " ms/frame\n"
+                  << "  cracks " << openEdges << "\n";
+    }
+}
+
+// True when no terrain sample along the line of sight is above it
+bool isSampleVisible(const Heightfield& world, const glm::vec3& camera, int x, int y)
+{
+    glm::vec3 target(static_cast<float>(x) * c_worldScale, world.at(x, y), static_cast<float>(y) * c_worldScale);
+    float cells = glm::length(glm::vec2(target.x - camera.x, target.z - camera.z)) / c_worldScale;
+    int steps = static_cast<int>(cells * 2.0f);
+    for (int i = 1; i < steps - 1; ++i)
+    {
+        float t = static_cast<float>(i) / static_cast<float>(steps);
+        glm::vec3 p = camera + (target - camera) * t;
+        float fx = p.x / c_worldScale;
+        float fz = p.z / c_worldScale;
+        if (fx < 0.0f || fz < 0.0f || fx >= world.getWidth() - 1 || fz >= world.getHeight() - 1)
+        {
+            continue;
+        }
+        int sx = static_cast<int>(fx);
+        int sz = static_cast<int>(fz);
+        float u = fx - sx;
+        float v = fz - sz;
+        float h = (world.at(sx, sz) * (1.0f - u) + world.at(sx + 1, sz) * u) * (1.0f - v) +
+                  (world.at(sx, sz + 1) * (1.0f - u) + world.at(sx + 1, sz + 1) * u) * v;
+        if (h > p.y)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Flies low over the world and culls the level of detail patches
+void benchmarkCull()
+{
+    const int worldSizes[] = {c_worldWidth, 2048};
+    const int frameCount = 300;
+    const float fov = 45.0f * pi / 180.0f;
+    glm::mat4 projection = glm::perspective(fov, static_cast<float>(c_screenWidth) / c_screenHeight, 0.1f, 100.0f);
+    float pixelScale = Geomipmap::getPixelScale(projection, c_screenHeight);
+
+    for (int worldSize : worldSizes)
+    {
+        Heightfield world(worldSize + 1, worldSize + 1);
+        generateWorld(world, c_seed, getDefaultThreadCount());
+        Geomipmap geomipmap(world);
+
+        BoxList boxes;
+        for (int py = 0; py < geomipmap.getPatchCountY(); ++py)
+        {
+            for (int px = 0; px < geomipmap.getPatchCountX(); ++px)
+            {
+                glm::vec3 min;
+                glm::vec3 max;
+                geomipmap.getPatchBounds(px, py, min, max);
+                boxes.add(min, max);
+            }
+        }
+
+        float extent = static_cast<float>(worldSize) * c_worldScale;
+        std::vector<uint32_t> indices;
+        std::vector<size_t> patchOffsets;
+        std::vector<uint8_t> visible;
+        std::vector<uint8_t> scalarVisible;
+        double scalarSeconds = 0.0;
+        double simdSeconds = 0.0;
+        double horizonSeconds = 0.0;
+        long long frustumCulled = 0;
+        long long horizonCulled = 0;
+        size_t allTriangles = 0;
+        size_t visibleTriangles = 0;
+        bool simdMatches = true;
+        int checkedSamples = 0;
+        int wronglyHidden = 0;
+        for (int frame = 0; frame < frameCount; ++frame)
+        {
+            float angle = 2.0f * pi * static_cast<float>(frame) / frameCount;
+            glm::vec3 position(0.5f * extent + 0.35f * extent * std::cos(angle), 0.0f, 0.5f * extent + 0.35f * extent * std::sin(angle));
+            int sampleX = std::min(static_cast<int>(position.x / c_worldScale), worldSize);
+            int sampleY = std::min(static_cast<int>(position.z / c_worldScale), worldSize);
+            position.y = world.at(sampleX, sampleY) + 0.1f;
+            glm::vec3 forward(-std::sin(angle), -0.1f, std::cos(angle));
+            glm::mat4 viewProjection = projection * glm::lookAt(position, position + forward, glm::vec3(0.0f, 1.0f, 0.0f));
+
+            geomipmap.selectLevels(position, pixelScale, c_lodPixelError);
+            geomipmap.buildIndices(indices, patchOffsets);
+
+            Frustum frustum;
+            extractFrustum(viewProjection, frustum);
+            Clock::time_point start = Clock::now();
+            cullFrustumScalar(frustum, boxes, scalarVisible);
+            scalarSeconds += secondsSince(start);
+            start = Clock::now();
+            cullFrustum(frustum, boxes, visible);
+            simdSeconds += secondsSince(start);
+            simdMatches = simdMatches && visible == scalarVisible;
+            frustumCulled += std::count(visible.begin(), visible.end(), 0);
+
+            std::vector<uint8_t> frustumVisible = visible;
+            start = Clock::now();
+            horizonCulled += cullHorizon(position, boxes, c_horizonBins, visible);
+            horizonSeconds += secondsSince(start);
+
+            for (size_t i = 0; i < boxes.size(); ++i)
+            {
+                size_t triangles = (patchOffsets[i + 1] - patchOffsets[i]) / 3;
+                allTriangles += triangles;
+                visibleTriangles += visible[i] ? triangles : 0;
+            }
+
+            // Every sample of a patch hidden by the horizon must be occluded
+            if (frame % 100 == 0)
+            {
+                for (size_t i = 0; i < boxes.size(); ++i)
+                {
+                    if (!frustumVisible[i] || visible[i])
+                    {
+                        continue;
+                    }
+                    int px = static_cast<int>(i) % geomipmap.getPatchCountX();
+                    int py = static_cast<int>(i) / geomipmap.getPatchCountX();
+                    for (int y = py * c_lodPatchSize; y <= std::min((py + 1) * c_lodPatchSize, worldSize); y += 8)
+                    {
+                        for (int x = px * c_lodPatchSize; x <= std::min((px + 1) * c_lodPatchSize, worldSize); x += 8)
+                        {
+                            ++checkedSamples;
+                            wronglyHidden += isSampleVisible(world, position, x, y);
+                        }
+                    }
+                }
+            }
+        }
+
+        std::string name = "cull " + std::to_string(worldSize);
+        check(simdMatches, name + " SSE frustum matches scalar");
+        check(wronglyHidden == 0, name + " horizon hides no visible samples");
+        long long tested = static_cast<long long>(boxes.size()) * frameCount;
+        std::cout << "cull " << worldSize << "^2, " << boxes.size() << " patches\n"
+                  << "  frustum culled " << static_cast<double>(frustumCulled) / tested << ", horizon culled "
+                  << static_cast<double>(horizonCulled) / tested << " of the patches\n"
+                  << "  triangles/frame " << visibleTriangles / frameCount << " of " << allTriangles / frameCount << "\n"
+                  << "  frustum scalar " << scalarSeconds * 1000.0 / frameCount << " ms/frame, SSE " << simdSeconds * 1000.0 / frameCount
+                  << " ms/frame" << (simdMatches ? ", matches scalar" : ", DIFFERS from scalar") << "\n"
+                  << "  horizon " << horizonSeconds * 1000.0 / frameCount << " ms/frame, " << wronglyHidden << " of " << checkedSamples
+                  << " hidden samples visible\n";
+    }
+}
+
+// Startup without a cache file against startup from the mapped file
+void benchmarkCache()
+{
+    const int worldSizes[] = {c_worldWidth, 2048};
+    for (int worldSize : worldSizes)
+    {
+        WorldParams params;
+        params.width = worldSize;
+        params.height = worldSize;
+        uint64_t hash = getWorldParameterHash(c_seed, params);
+        std::string filename = getWorldCacheFilename(hash);
+        std::remove(filename.c_str());
+
+        Clock::time_point start = Clock::now();
+        WorldCache cache;
+        Heightfield world(worldSize + 1, worldSize + 1);
+        IndexedMesh mesh;
+        bool coldHit = cache.open(filename, hash);
+        generateWorld(world, c_seed, getDefaultThreadCount());
+        generateIndexedMesh(world, mesh);
+        double generateSeconds = secondsSince(start);
+        bool written = WorldCache::write(filename, hash, world, &mesh);
+        double coldSeconds = secondsSince(start);
+
+        start = Clock::now();
+        bool warmHit = cache.open(filename, hash);
+        double openSeconds = secondsSince(start);
+        Heightfield cached;
+        cache.copyHeights(cached);
+        double heightsSeconds = secondsSince(start);
+        // Read every page of the mesh like an upload would
+        IndexedMeshView view = cache.getMesh();
+        float sum = 0.0f;
+        for (size_t i = 0; i < view.vertexFloatCount; i += 1024)
+        {
+            sum += view.vertices[i];
+        }
+        volatile float touched = sum;
+        (void)touched;
+        double warmSeconds = secondsSince(start);
+
+        bool identical = warmHit && std::equal(world.data(), world.data() + world.getSize(), cached.data()) &&
+                         view.vertexFloatCount == mesh.vertices.size() && view.indexCount == mesh.getIndexCount() &&
+                         std::equal(mesh.vertices.begin(), mesh.vertices.end(), view.vertices);
+        size_t fileSize = cache.getFileSize();
+        bool otherSeed = cache.open(filename, getWorldParameterHash(c_seed + 1, params));
+        std::string name = "cache " + std::to_string(worldSize);
+        check(!coldHit && written, name + " cold state");
+        check(identical, name + " matches generated");
+        check(!otherSeed, name + " rejects other seed");
+
+        std::cout << "cache " << worldSize << "^2, " << fileSize / 1024 << " KiB file\n"
+                  << "  cold " << coldSeconds * 1000.0 << " ms (generation and mesh " << generateSeconds * 1000.0 << " ms, write "
+                  << (coldSeconds - generateSeconds) * 1000.0 << " ms)" << (coldHit || !written ? ", UNEXPECTED cache state" : "") << "\n"
+                  << "  warm " << warmSeconds * 1000.0 << " ms (open " << openSeconds * 1000.0 << " ms, heights "
+                  << (heightsSeconds - openSeconds) * 1000.0 << " ms, mesh " << (warmSeconds - heightsSeconds) * 1000.0 << " ms), "
+                  << coldSeconds / warmSeconds << "x faster" << (identical ? ", matches generated" : ", DIFFERS from generated")
+                  << (otherSeed ? ", ACCEPTED other seed" : "") << "\n";
+        cache.close();
+        std::remove(filename.c_str());
+    }
+}
+
+// The original river, stamping every pit again until its center is deep enough
+int createRiverReference(Heightfield& world, const WorldParams& params)
+{
+    int startHeight = params.riverEndPointMargin;
+    int endHeight = world.getHeight() - 1 - params.riverEndPointMargin;
+    int stamps = 0;
+    for (int x = 0; x < world.getWidth(); x += params.riverPitDensity)
+    {
+        int y = getPitPosition(world, startHeight, endHeight, x, params);
+        float currentDepth = world.at(x, y);
+        while (currentDepth > -params.riverDepth)
+        {
+            currentDepth = createBump(world, x, y, -2.0f, params.riverDeviation);
+            ++stamps;
+        }
+    }
+    return stamps;
+}
+
+void benchmarkRiver()
+{
+    const int worldSizes[] = {c_worldWidth, 2048};
+    const int riverCount = 8;
+    for (int worldSize : worldSizes)
+    {
+        WorldParams params;
+        params.width = worldSize;
+        params.height = worldSize;
+        params.numRivers = 0;
+        Heightfield mountains;
+        generateWorld(mountains, c_seed, params, getDefaultThreadCount());
+
+        Heightfield reference = mountains;
+        Clock::time_point start = Clock::now();
+        int referenceStamps = createRiverReference(reference, params);
+        double referenceSeconds = secondsSince(start);
+
+        Heightfield world = mountains;
+        start = Clock::now();
+        createRiver(world, params);
+        double seconds = secondsSince(start);
+
+        // Deepest pit center left above the river depth
+        float shallowest = -std::numeric_limits<float>::max();
+        int startHeight = params.riverEndPointMargin;
+        int endHeight = world.getHeight() - 1 - params.riverEndPointMargin;
+        for (int x = 0; x < world.getWidth(); x += params.riverPitDensity)
+        {
+            shallowest = std::max(shallowest, world.at(x, getPitPosition(world, startHeight, endHeight, x, params)));
+        }
+
+        params.numRivers = riverCount;
+        Heightfield rivers = mountains;
+        start = Clock::now();
+        createRivers(rivers, c_seed, params);
+        double riversSeconds = secondsSince(start);
+
+        std::cout << "river " << worldSize << "^2\n"
+                  << "  iterative " << referenceSeconds * 1000.0 << " ms, " << referenceStamps << " stamps\n"
+                  << "  closed form " << seconds * 1000.0 << " ms, " << (world.getWidth() + params.riverPitDensity - 1) / params.riverPitDensity
+                  << " stamps at most, " << referenceSeconds / seconds << "x faster, max difference " << maxAbsDifference(reference, world)
+                  << ", shallowest pit " << shallowest << " (depth " << -params.riverDepth << ")\n"
+                  << "  " << riverCount << " spline rivers " << riversSeconds * 1000.0 << " ms\n";
+    }
+}
+
+void benchmarkErosion()
+{
+    const int worldSizes[] = {1024, 2048};
+    const int threadCounts[] = {1, 2, 4, 8};
+    for (int worldSize : worldSizes)
+    {
+        WorldParams params;
+        params.width = worldSize;
+        params.height = worldSize;
+        Heightfield original;
+        generateWorld(original, c_seed, params, getDefaultThreadCount());
+        params.erosionDroplets = worldSize * worldSize;
+
+        Heightfield serial = original;
+        Clock::time_point start = Clock::now();
+        long long droplets = erodeHydraulic(serial, c_seed, params, 1);
+        double serialSeconds = secondsSince(start);
+
+        double change = 0.0;
+        for (int y = 0; y < serial.getHeight(); ++y)
+        {
+            for (int x = 0; x < serial.getWidth(); ++x)
+            {
+                change += std::abs(serial.at(x, y) - original.at(x, y));
+            }
+        }
+        std::cout << "erosion " << worldSize << "^2, " << droplets << " droplets, tile " << getErosionTileSize(params) << ", mean height change "
+                  << change / static_cast<double>(serial.getSize()) << "\n";
+
+        for (int threadCount : threadCounts)
+        {
+            Heightfield world = original;
+            start = Clock::now();
+            erodeHydraulic(world, c_seed, params, threadCount);
+            double seconds = secondsSince(start);
+            bool identical = std::equal(world.data(), world.data() + world.getSize(), serial.data());
+            check(identical, "erosion " + std::to_string(worldSize) + " on " + std::to_string(threadCount) + " threads matches serial");
+            std::cout << "  " << threadCount << " threads: " << seconds * 1000.0 << " ms, " << droplets / seconds / 1e6 << " M droplets/s, "
+                      << serialSeconds / seconds << "x serial" << (identical ? ", matches serial" : ", DIFFERS from serial") << "\n";
+        }
+    }
+    std::cout << "hardware threads: " << getDefaultThreadCount() << "\n";
+}
+
+double sumHeights(const Heightfield& world)
+{
+    double sum = 0.0;
+    for (int y = 0; y < world.getHeight(); ++y)
+    {
+        for (int x = 0; x < world.getWidth(); ++x)
+        {
+            sum += world.at(x, y);
+        }
+    }
+    return sum;
+}
+
+void benchmarkStencil()
+{
+    const int worldSizes[] = {512, 1024, 2048, 4096};
+    const int iterations = 10;
+    const StampKernel kernels[] = {StampKernel::Scalar, StampKernel::SSE, StampKernel::AVX2};
+    StampKernel bestKernel = getStampKernel();
+    int threads = getDefaultThreadCount();
+
+    typedef std::function<void(Heightfield&, Heightfield&, int)> Pass;
+    const char* passNames[] = {"thermal", "smooth"};
+    Pass passes[] = {
+        [](Heightfield& world, Heightfield& scratch, int threadCount) { erodeThermal(world, scratch, iterations, c_thermalTalus, c_thermalRate, threadCount); },
+        [](Heightfield& world, Heightfield& scratch, int threadCount) { smoothHeights(world, scratch, iterations, c_smoothStrength, threadCount); }};
+
+    for (int worldSize : worldSizes)
+    {
+        Heightfield original(worldSize + 1, worldSize + 1);
+        generateWorld(original, c_seed, threads);
+        double cells = static_cast<double>(original.getSize()) * iterations;
+        double originalSum = sumHeights(original);
+
+        for (int p = 0; p < 2; ++p)
+        {
+            Heightfield scratch;
+            Heightfield reference;
+            for (StampKernel kernel : kernels)
+            {
+                if (!isStampKernelSupported(kernel))
+                {
+                    continue;
+                }
+                setStampKernel(kernel);
+                Heightfield world = original;
+                Clock::time_point start = Clock::now();
+                passes[p](world, scratch, 1);
+                double seconds = secondsSince(start);
+                if (kernel == StampKernel::Scalar)
+                {
+                    reference = world;
+                }
+                bool identical = std::equal(world.data(), world.data() + world.getSize(), reference.data());
+                check(identical, std::string(passNames[p]) + " " + std::to_string(worldSize) + " " + getStampKernelName(kernel) + " matches scalar");
+                std::cout << passNames[p] << " " << worldSize << "^2 x " << iterations << ", " << getStampKernelName(kernel) << ": " << seconds * 1000.0
+                          << " ms, " << cells / seconds / 1e6 << " M cells/s" << (identical ? ", matches scalar" : ", DIFFERS from scalar");
+                if (p == 0 && kernel == StampKernel::Scalar)
+                {
+                    std::cout << ", total height change " << sumHeights(world) - originalSum;
+                }
+                std::cout << "\n";
+            }
+
+            setStampKernel(bestKernel);
+            Heightfield world = original;
+            Clock::time_point start = Clock::now();
+            passes[p](world, scratch, threads);
+            double seconds = secondsSince(start);
+            bool identical = std::equal(world.data(), world.data() + world.getSize(), reference.data());
+            check(identical, std::string(passNames[p]) + " " + std::to_string(worldSize) + " on " + std::to_string(threads) + " threads matches scalar");
+            std::cout << passNames[p] << " " << worldSize << "^2 x " << iterations << ", " << getStampKernelName(bestKernel) << " on " << threads
+                      << " threads: " << seconds * 1000.0 << " ms, " << cells / seconds / 1e6 << " M cells/s"
+                      << (identical ? ", matches scalar" : ", DIFFERS from scalar") << "\n";
+        }
+    }
+}
+
+// Craters and flattening at random spots, with the mesh updated from the
+// dirty rectangles after every edit and compared with a full rebuild
+void benchmarkEdit()
+{
+    const int worldSizes[] = {c_worldWidth, 2048};
+    const int editCount = 100;
+    for (int worldSize : worldSizes)
+    {
+        Heightfield world(worldSize + 1, worldSize + 1);
+        generateWorld(world, c_seed, getDefaultThreadCount());
+        IndexedMesh mesh;
+        generateIndexedMesh(world, mesh);
+        HeightTexture texture;
+        generateHeightTexture(world, 32, texture);
+        world.clearDirty();
+        size_t fullBytes = mesh.vertices.size() * sizeof(float);
+
+        std::mt19937 rng(c_seed);
+        std::uniform_int_distribution<int> randomSample(0, worldSize);
+        std::vector<BufferRange> ranges;
+        double editSeconds = 0.0;
+        double updateSeconds = 0.0;
+        size_t uploadBytes = 0;
+        size_t rangeCount = 0;
+        size_t texelBytes = 0;
+        for (int i = 0; i < editCount; ++i)
+        {
+            int x = randomSample(rng);
+            int y = randomSample(rng);
+            Clock::time_point start = Clock::now();
+            if (i % 2 == 0)
+            {
+                createCrater(world, x, y, c_craterRadius, c_craterDepth);
+            }
+            else
+            {
+                flattenArea(world, x, y, c_flattenRadius, world.at(x, y));
+            }
+            editSeconds += secondsSince(start);
+
+            ranges.clear();
+            start = Clock::now();
+            updateIndexedMesh(world, mesh, ranges);
+            updateSeconds += secondsSince(start);
+            for (const DirtyRect& rect : world.getDirtyRects())
+            {
+                updateHeightTexture(world, rect, texture);
+                texelBytes += static_cast<size_t>(rect.maxX - rect.minX + 1) * (rect.maxY - rect.minY + 1) * texture.getTexelSize();
+            }
+            world.clearDirty();
+            for (const BufferRange& range : ranges)
+            {
+                uploadBytes += range.size;
+            }
+            rangeCount += ranges.size();
+        }
+
+        IndexedMesh reference;
+        Clock::time_point start = Clock::now();
+        generateIndexedMesh(world, reference);
+        double rebuildSeconds = secondsSince(start);
+        bool identical = reference.vertices == mesh.vertices;
+        HeightTexture referenceTexture;
+        generateHeightTexture(world, 32, referenceTexture);
+        bool textureIdentical = referenceTexture.texels32 == texture.texels32;
+        check(identical, "edit " + std::to_string(worldSize) + " mesh matches rebuild");
+        check(textureIdentical, "edit " + std::to_string(worldSize) + " height texture matches rebuild");
+
+        std::cout << "edit " << worldSize << "^2, " << editCount << " craters and flattenings\n"
+                  << "  edit " << editSeconds * 1e6 / editCount << " us, update " << updateSeconds * 1e6 / editCount << " us, full rebuild "
+                  << rebuildSeconds * 1e6 << " us\n"
+                  << "  upload " << uploadBytes / editCount / 1024.0 << " KiB in " << static_cast<double>(rangeCount) / editCount << " ranges per edit, full "
+                  << fullBytes / 1024.0 << " KiB" << (identical ? ", matches rebuild" : ", DIFFERS from rebuild") << "\n"
+                  << "  height texture upload " << texelBytes / editCount / 1024.0 << " KiB per edit, full " << texture.getMemoryUsage() / 1024.0 << " KiB"
+                  << (textureIdentical ? ", matches rebuild" : ", DIFFERS from rebuild") << "\n";
+    }
+}
+
+// Tiles generated on their own against the in-core world without rivers
+void benchmarkTiles()
+{
+    const int worldSize = 2048;
+    const int tileSizes[] = {64, 256, 1024};
+    WorldParams params;
+    params.width = worldSize;
+    params.height = worldSize;
+    params.numRivers = 0;
+    params.numMountains = 40;
+
+    Heightfield world;
+    Clock::time_point start = Clock::now();
+    generateWorld(world, c_seed, params, 1);
+    double worldSeconds = secondsSince(start);
+    std::cout << "tiles " << worldSize << "^2 in core: " << worldSeconds * 1000.0 << " ms, " << world.getSize() * sizeof(float) / (1024.0 * 1024.0)
+              << " MiB of heights\n";
+
+    std::vector<Bump> bumps;
+    for (int i = 0; i < params.numMountains; ++i)
+    {
+        createMountainBumps(params, c_seed, i, bumps);
+    }
+    for (int tileSize : tileSizes)
+    {
+        TileGrid grid = getTileGrid(params, tileSize);
+        std::vector<std::vector<uint32_t>> bins;
+        start = Clock::now();
+        binBumps(bumps, grid, bins);
+        double binSeconds = secondsSince(start);
+        size_t binned = 0;
+        for (const std::vector<uint32_t>& bin : bins)
+        {
+            binned += bin.size();
+        }
+
+        Heightfield tile;
+        std::vector<Bump> scratch;
+        bool identical = true;
+        start = Clock::now();
+        for (int tileY = 0; tileY < grid.tileCountY; ++tileY)
+        {
+            for (int tileX = 0; tileX < grid.tileCountX; ++tileX)
+            {
+                generateTile(grid, tileX, tileY, bumps, bins[tileY * grid.tileCountX + tileX], tile, scratch);
+                for (int y = c_outOfCoreApron; y < tile.getHeight() - c_outOfCoreApron; ++y)
+                {
+                    for (int x = c_outOfCoreApron; x < tile.getWidth() - c_outOfCoreApron; ++x)
+                    {
+                        int worldX = tileX * tileSize + x - c_outOfCoreApron;
+                        int worldY = tileY * tileSize + y - c_outOfCoreApron;
+                        identical = identical && tile.at(x, y) == world.at(worldX, worldY);
+                    }
+                }
+            }
+        }
+        double tileSeconds = secondsSince(start);
+        check(identical, "tiles of " + std::to_string(tileSize) + " cells match in core");
+        std::cout << "  " << tileSize << " cell tiles: " << grid.getTileCount() << " tiles, binning " << binSeconds * 1000.0 << " ms, "
+                  << static_cast<double>(binned) / bumps.size() << " bins per bump, generation and compare " << tileSeconds * 1000.0 << " ms, "
+                  << getTileMemory(tileSize, TileMeshFormat::Binary) / (1024.0 * 1024.0) << " MiB per tile in flight"
+                  << (identical ? ", matches in core" : ", DIFFERS from in core") << "\n";
+    }
+}
+
+float sampleBilinear(const Heightfield& world, float x, float y)
+{
+    int x0 = std::min(static_cast<int>(x), world.getWidth() - 2);
+    int y0 = std::min(static_cast<int>(y), world.getHeight() - 2);
+    float u = x - static_cast<float>(x0);
+    float v = y - static_cast<float>(y0);
+    float top = world.at(x0, y0) + u * (world.at(x0 + 1, y0) - world.at(x0, y0));
+    float bottom = world.at(x0, y0 + 1) + u * (world.at(x0 + 1, y0 + 1) - world.at(x0, y0 + 1));
+    return top + v * (bottom - top);
+}
+
+// Point queries of the bump features against sampling a generated grid
+void benchmarkQuery()
+{
+    const int worldSize = 2048;
+    const int queryCount = 1 << 20;
+    WorldParams params;
+    params.width = worldSize;
+    params.height = worldSize;
+    params.numMountains = 40;
+    params.numRivers = 3;
+
+    StampKernel defaultKernel = getStampKernel();
+    StampMode defaultMode = getStampMode();
+
+    Clock::time_point start = Clock::now();
+    HeightQuery query(c_seed, params);
+    double buildSeconds = secondsSince(start);
+    Heightfield world;
+    start = Clock::now();
+    generateWorld(world, c_seed, params, 1);
+    double gridSeconds = secondsSince(start);
+    std::cout << "query " << worldSize << "^2: " << query.getFeatureCount() << " features built in " << buildSeconds * 1000.0 << " ms, "
+              << query.getMemoryUsage() / 1024.0 << " KiB, grid generated in " << gridSeconds * 1000.0 << " ms, "
+              << world.getSize() * sizeof(float) / 1024.0 << " KiB\n";
+
+    // Every sample of the grid, exact stamping sums the same terms in the same order
+    std::vector<float> sampleX;
+    std::vector<float> sampleY;
+    for (int y = 0; y <= worldSize; ++y)
+    {
+        for (int x = 0; x <= worldSize; ++x)
+        {
+            sampleX.push_back(static_cast<float>(x));
+            sampleY.push_back(static_cast<float>(y));
+        }
+    }
+    float cachedDifference = 0.0f;
+    for (size_t i = 0; i < sampleX.size(); ++i)
+    {
+        cachedDifference = std::max(cachedDifference, std::abs(query.heightAt(sampleX[i], sampleY[i]) - world.at(static_cast<int>(sampleX[i]), static_cast<int>(sampleY[i]))));
+    }
+    setStampMode(StampMode::Exact);
+    Heightfield exact;
+    generateWorld(exact, c_seed, params, 1);
+    setStampMode(defaultMode);
+    bool identical = true;
+    for (size_t i = 0; i < sampleX.size(); ++i)
+    {
+        identical = identical && query.heightAt(sampleX[i], sampleY[i]) == exact.at(static_cast<int>(sampleX[i]), static_cast<int>(sampleY[i]));
+    }
+    check(identical, "query samples match the exact grid");
+    std::cout << "  samples: " << (identical ? "matches exact grid" : "DIFFERS from exact grid") << ", max abs difference to cached grid "
+              << cachedDifference << "\n";
+
+    std::mt19937 random(c_seed);
+    std::uniform_real_distribution<float> position(0.0f, static_cast<float>(worldSize));
+    std::vector<float> x(queryCount);
+    std::vector<float> y(queryCount);
+    for (int i = 0; i < queryCount; ++i)
+    {
+        x[i] = position(random);
+        y[i] = position(random);
+    }
+
+    // Analytic gradient against central differences, which also see the small
+    // steps at the edges of the truncated bump windows. Those stay below a
+    // thousandth for this world and step.
+    const float step = 0.1f;
+    const float gradientTolerance = 2.0e-3f;
+    float maxGradient = 0.0f;
+    float maxGradientError = 0.0f;
+    for (int i = 0; i < 10000; ++i)
+    {
+        float px = std::min(std::max(x[i], step), worldSize - step);
+        float py = std::min(std::max(y[i], step), worldSize - step);
+        float dhdx = 0.0f;
+        float dhdy = 0.0f;
+        query.gradientAt(px, py, dhdx, dhdy);
+        float differenceX = (query.heightAt(px + step, py) - query.heightAt(px - step, py)) / (2.0f * step);
+        float differenceY = (query.heightAt(px, py + step) - query.heightAt(px, py - step)) / (2.0f * step);
+        maxGradient = std::max(maxGradient, std::max(std::abs(dhdx), std::abs(dhdy)));
+        maxGradientError = std::max(maxGradientError, std::max(std::abs(dhdx - differenceX), std::abs(dhdy - differenceY)));
+    }
+    check(maxGradientError <= gradientTolerance, "query gradient within tolerance of central differences");
+    std::cout << "  gradient: max " << maxGradient << ", max abs error to central differences " << maxGradientError << " (tolerance "
+              << gradientTolerance << ")\n";
+
+    start = Clock::now();
+    float sum = 0.0f;
+    for (int i = 0; i < queryCount; ++i)
+    {
+        sum += sampleBilinear(world, x[i], y[i]);
+    }
+    double gridQuerySeconds = secondsSince(start);
+    volatile float touched = sum;
+    std::cout << "  grid bilinear: " << queryCount / gridQuerySeconds / 1.0e6 << " Mqueries/s after " << gridSeconds * 1000.0 << " ms of generation\n";
+
+    start = Clock::now();
+    sum = 0.0f;
+    for (int i = 0; i < queryCount; ++i)
+    {
+        sum += query.heightAt(x[i], y[i]);
+    }
+    double pointSeconds = secondsSince(start);
+    touched = sum;
+    (void)touched;
+    std::cout << "  heightAt: " << queryCount / pointSeconds / 1.0e6 << " Mqueries/s, fewer than "
+              << static_cast<long long>((gridSeconds - buildSeconds) / (pointSeconds / queryCount)) << " queries are cheaper than the grid\n";
+
+    std::vector<float> heights(queryCount);
+    std::vector<float> scalarHeights;
+    HeightQuery::Scratch scratch;
+    const StampKernel kernels[] = {StampKernel::Scalar, StampKernel::SSE, StampKernel::AVX2};
+    for (StampKernel kernel : kernels)
+    {
+        if (!isStampKernelSupported(kernel))
+        {
+            std::cout << "  batched " << getStampKernelName(kernel) << ": not supported\n";
+            continue;
+        }
+        setStampKernel(kernel);
+        query.getHeights(x.data(), y.data(), queryCount, heights.data(), scratch);
+        start = Clock::now();
+        query.getHeights(x.data(), y.data(), queryCount, heights.data(), scratch);
+        double batchSeconds = secondsSince(start);
+        if (kernel == StampKernel::Scalar)
+        {
+            scalarHeights = heights;
+        }
+        bool matches = heights == scalarHeights;
+        for (int i = 0; i < queryCount && matches; i += 97)
+        {
+            matches = heights[i] == query.heightAt(x[i], y[i]);
+        }
+        check(matches, std::string("query batched ") + getStampKernelName(kernel) + " matches heightAt");
+        std::cout << "  batched " << getStampKernelName(kernel) << ": " << queryCount / batchSeconds / 1.0e6 << " Mqueries/s, "
+                  << pointSeconds / batchSeconds << "x heightAt" << (matches ? ", matches heightAt" : ", DIFFERS from heightAt") << "\n";
+    }
+    setStampKernel(defaultKernel);
+}
+
+// Walks the cells under the ray in order and tests each, the ray starts above the world
+bool intersectRayReference(const Heightfield& world, const glm::vec3& origin, const glm::vec3& direction, float maxDistance, float& distance)
+{
+    glm::vec3 o(origin.x / c_worldScale, origin.y, origin.z / c_worldScale);
+    glm::vec3 d(direction.x / c_worldScale, direction.y, direction.z / c_worldScale);
+    int cellsX = world.getWidth() - 1;
+    int cellsY = world.getHeight() - 1;
+    int x = std::min(static_cast<int>(o.x), cellsX - 1);
+    int y = std::min(static_cast<int>(o.z), cellsY - 1);
+    int stepX = d.x >= 0.0f ? 1 : -1;
+    int stepY = d.z >= 0.0f ? 1 : -1;
+    const float infinity = std::numeric_limits<float>::infinity();
+    float deltaX = d.x != 0.0f ? std::abs(1.0f / d.x) : infinity;
+    float deltaY = d.z != 0.0f ? std::abs(1.0f / d.z) : infinity;
+    float nextX = d.x != 0.0f ? (static_cast<float>(x + (stepX > 0 ? 1 : 0)) - o.x) / d.x : infinity;
+    float nextY = d.z != 0.0f ? (static_cast<float>(y + (stepY > 0 ? 1 : 0)) - o.z) / d.z : infinity;
+    float entry = 0.0f;
+    while (x >= 0 && y >= 0 && x < cellsX && y < cellsY && entry <= maxDistance)
+    {
+        float hit = 0.0f;
+        if (HeightPyramid::intersectCell(world, x, y, o, d, hit))
+        {
+            distance = hit;
+            return hit <= maxDistance;
+        }
+        if (nextX < nextY)
+        {
+            entry = nextX;
+            nextX += deltaX;
+            x += stepX;
+        }
+        else
+        {
+            entry = nextY;
+            nextY += deltaY;
+            y += stepY;
+        }
+    }
+    return false;
+}
+
+// Hierarchical ray casting against walking the cells under each ray
+void benchmarkRay()
+{
+    const int worldSize = 4096;
+    const int rayCount = 1 << 20;
+    const int referenceCount = 1 << 14;
+    const int threadCounts[] = {1, 2, 4, 8};
+    const float maxDistance = 100.0f;
+    WorldParams params;
+    params.width = worldSize;
+    params.height = worldSize;
+    params.numMountains = 80;
+
+    Heightfield world;
+    generateWorld(world, c_seed, params, getDefaultThreadCount());
+    Clock::time_point start = Clock::now();
+    HeightPyramid pyramid(world);
+    double buildSeconds = secondsSince(start);
+    float maxHeight = *std::max_element(world.data(), world.data() + world.getSize());
+    std::cout << "ray " << worldSize << "^2: pyramid of " << pyramid.getLevelCount() << " levels built in " << buildSeconds * 1000.0 << " ms, "
+              << pyramid.getMemoryUsage() / (1024.0 * 1024.0) << " MiB\n";
+
+    // Steep rays from above the terrain as for picking and grazing rays from
+    // just above the ground as for line of sight
+    std::mt19937 random(c_seed);
+    std::uniform_real_distribution<float> position(0.0f, worldSize * c_worldScale);
+    std::uniform_real_distribution<float> angle(0.0f, 2.0f * pi);
+    const char* names[] = {"steep", "grazing"};
+    for (int set = 0; set < 2; ++set)
+    {
+        std::vector<glm::vec3> origins(rayCount);
+        std::vector<glm::vec3> directions(rayCount);
+        std::uniform_real_distribution<float> slope = set == 0 ? std::uniform_real_distribution<float>(-2.0f, -0.2f)
+                                                               : std::uniform_real_distribution<float>(-0.05f, 0.05f);
+        for (int i = 0; i < rayCount; ++i)
+        {
+            float x = position(random);
+            float z = position(random);
+            float y = set == 0 ? maxHeight + 1.0f : pyramid.getSurfaceHeight(x, z) + c_cameraGroundClearance;
+            float a = angle(random);
+            origins[i] = glm::vec3(x, y, z);
+            directions[i] = glm::normalize(glm::vec3(std::cos(a), slope(random), std::sin(a)));
+        }
+
+        std::vector<float> expected(referenceCount);
+        std::vector<uint8_t> expectedHits(referenceCount);
+        start = Clock::now();
+        for (int i = 0; i < referenceCount; ++i)
+        {
+            expectedHits[i] = intersectRayReference(world, origins[i], directions[i], maxDistance, expected[i]) ? 1 : 0;
+        }
+        double referenceSeconds = secondsSince(start);
+        std::vector<float> found(referenceCount);
+        std::vector<uint8_t> hits(referenceCount);
+        start = Clock::now();
+        for (int i = 0; i < referenceCount; ++i)
+        {
+            hits[i] = pyramid.intersectRay(origins[i], directions[i], maxDistance, found[i]) ? 1 : 0;
+        }
+        double pyramidSeconds = secondsSince(start);
+        int mismatches = 0;
+        int hitCount = 0;
+        for (int i = 0; i < referenceCount; ++i)
+        {
+            hitCount += hits[i];
+            mismatches += hits[i] != expectedHits[i] || (hits[i] && std::abs(found[i] - expected[i]) > 1e-4f * std::max(expected[i], 1.0f)) ? 1 : 0;
+        }
+        check(mismatches == 0, std::string("ray ") + names[set] + " matches cell walk");
+        std::cout << "  " << names[set] << ": " << 100.0 * hitCount / referenceCount << "% hit, cell walk " << referenceCount / referenceSeconds / 1.0e6
+                  << " Mrays/s, pyramid " << referenceCount / pyramidSeconds / 1.0e6 << " Mrays/s"
+                  << (mismatches == 0 ? ", matches cell walk" : ", DIFFERS from cell walk in " + std::to_string(mismatches) + " rays") << "\n";
+
+        std::vector<float> distances;
+        std::vector<float> serialDistances;
+        double serialSeconds = 0.0;
+        for (int threadCount : threadCounts)
+        {
+            start = Clock::now();
+            pyramid.intersectRays(origins, directions, maxDistance, distances, threadCount);
+            double seconds = secondsSince(start);
+            serialSeconds = threadCount == 1 ? seconds : serialSeconds;
+            if (threadCount == 1)
+            {
+                serialDistances = distances;
+            }
+            bool identical = check(distances == serialDistances, std::string("ray ") + names[set] + " on " + std::to_string(threadCount) + " threads matches serial");
+            std::cout << "    " << threadCount << " threads: " << rayCount / seconds / 1.0e6 << " Mrays/s, " << serialSeconds / seconds << "x serial"
+                      << (identical ? "" : ", DIFFERS from serial") << "\n";
+        }
+    }
+    std::cout << "hardware threads: " << getDefaultThreadCount() << "\n";
+}
+
+// Largest height difference between the triangles of a mesh and the samples
+// they cover, and the count of interior edges used by one triangle only,
+// which are cracks along T-junctions
+void checkAdaptiveMesh(const Heightfield& world, const IndexedMesh& mesh, float& maxError, size_t& openEdges)
+{
+    std::vector<uint64_t> edges;
+    maxError = 0.0f;
+    size_t indexCount = mesh.getIndexCount();
+    for (size_t i = 0; i < indexCount; i += 3)
+    {
+        int x[3];
+        int y[3];
+        float h[3];
+        uint32_t index[3];
+        for (int corner = 0; corner < 3; ++corner)
+        {
+            index[corner] = mesh.wideIndices ? mesh.indices32[i + corner] : mesh.indices16[i + corner];
+            const float* vertex = &mesh.vertices[static_cast<size_t>(index[corner]) * 6];
+            x[corner] = static_cast<int>(std::lround(vertex[0] / c_worldScale));
+            y[corner] = static_cast<int>(std::lround(vertex[2] / c_worldScale));
+            h[corner] = vertex[1];
+        }
+
+        // Samples inside the triangle from the edge functions, exact on the integer corners
+        int area = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+        for (int sy = std::min(std::min(y[0], y[1]), y[2]); sy <= std::max(std::max(y[0], y[1]), y[2]); ++sy)
+        {
+            for (int sx = std::min(std::min(x[0], x[1]), x[2]); sx <= std::max(std::max(x[0], x[1]), x[2]); ++sx)
+            {
+                int w0 = (x[2] - x[1]) * (sy - y[1]) - (y[2] - y[1]) * (sx - x[1]);
+                int w1 = (x[0] - x[2]) * (sy - y[2]) - (y[0] - y[2]) * (sx - x[2]);
+                int w2 = area - w0 - w1;
+                if (w0 < 0 || w1 < 0 || w2 < 0)
+                {
+                    continue;
+                }
+                float height = (w0 * h[0] + w1 * h[1] + w2 * h[2]) / static_cast<float>(area);
+                maxError = std::max(maxError, std::abs(height - world.at(sx, sy)));
+            }
+        }
+
+        for (int corner = 0; corner < 3; ++corner)
+        {
+            int next = (corner + 1) % 3;
+            bool border = (x[corner] == x[next] && (x[corner] == 0 || x[corner] == world.getWidth() - 1)) ||
+                          (y[corner] == y[next] && (y[corner] == 0 || y[corner] == world.getHeight() - 1));
+            if (!border)
+            {
+                uint64_t a = std::min(index[corner], index[next]);
+                uint64_t b = std::max(index[corner], index[next]);
+                edges.push_back(a << 32 | b);
+            }
+        }
+    }
+
+    std::sort(edges.begin(), edges.end());
+    openEdges = 0;
+    for (size_t i = 0; i < edges.size();)
+    {
+        size_t j = i;
+        while (j < edges.size() && edges[j] == edges[i])
+        {
+            ++j;
+        }
+        openEdges += j - i == 1 ? 1 : 0;
+        i = j;
+    }
+}
+
+// Adaptive triangulation against the full resolution mesh
+void benchmarkAdaptive()
+{
+    const int worldSizes[] = {500, 2048};
+    const float maxErrors[] = {0.0f, 0.001f, 0.005f, 0.02f, 0.05f};
+
+    for (int worldSize : worldSizes)
+    {
+        Heightfield world(worldSize + 1, worldSize + 1);
+        generateWorld(world, c_seed, getDefaultThreadCount());
+
+        std::vector<int> indices;
+        std::vector<float> vertices;
+        Clock::time_point start = Clock::now();
+        generateMesh(world, indices, vertices);
+        double fullSeconds = secondsSince(start);
+        size_t fullTriangles = indices.size() / 3;
+
+        start = Clock::now();
+        Rtin rtin(world);
+        double buildSeconds = secondsSince(start);
+        std::cout << "adaptive " << worldSize << "^2: full mesh " << fullTriangles << " triangles in " << fullSeconds * 1000.0 << " ms, errors of a "
+                  << rtin.getGridSize() << "^2 grid in " << buildSeconds * 1000.0 << " ms, " << rtin.getMemoryUsage() / (1024.0 * 1024.0) << " MiB\n";
+
+        for (float maxError : maxErrors)
+        {
+            IndexedMesh mesh;
+            start = Clock::now();
+            rtin.generateMesh(maxError, mesh);
+            double meshSeconds = secondsSince(start);
+            size_t triangles = mesh.getIndexCount() / 3;
+
+            float error = 0.0f;
+            size_t openEdges = 0;
+            checkAdaptiveMesh(world, mesh, error, openEdges);
+            std::string name = "adaptive " + std::to_string(worldSize) + " max error " + std::to_string(maxError);
+            check(error <= maxError, name + " within bound");
+            check(openEdges == 0, name + " has no cracks");
+            std::cout << "  max error " << maxError << ": " << triangles << " triangles, " << static_cast<double>(fullTriangles) / triangles
+                      << "x fewer, " << mesh.getVertexCount() << " vertices, " << meshSeconds * 1000.0 << " ms, max error to the full mesh vertices "
+                      << error << (error <= maxError ? ", within bound" : ", EXCEEDS bound") << (openEdges == 0 ? ", no cracks" : ", CRACKS") << "\n";
+        }
+    }
+}
+
+// Cost of one trace scope and of generation with every scope recording. Build
+// once with and once without TERRAIN_TRACING to compare.
+void benchmarkTrace()
+{
+#ifdef TERRAIN_TRACING
+    std::cout << "tracing enabled, " << c_traceBufferEvents << " events per thread\n";
+#else
+    std::cout << "tracing compiled out, configure with -DTERRAIN_TRACING=ON to record\n";
+#endif
+    const int scopeCount = 1000000;
+    volatile int sink = 0;
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < scopeCount; ++i)
+    {
+        TRACE_SCOPE("benchmarkScope");
+        sink = sink + 1;
+    }
+    std::cout << "scope: " << secondsSince(start) * 1e9 / scopeCount << " ns\n";
+
+    const int worldSize = 1024;
+    const int repetitions = 10;
+    Heightfield world(worldSize + 1, worldSize + 1);
+    IndexedMesh mesh;
+    generateWorld(world, c_seed, getDefaultThreadCount());
+    start = Clock::now();
+    for (int i = 0; i < repetitions; ++i)
+    {
+        generateWorld(world, c_seed, getDefaultThreadCount());
+        generateIndexedMesh(world, mesh);
+    }
+    std::cout << "generate and mesh " << worldSize << "^2: " << secondsSince(start) * 1000.0 / repetitions << " ms\n";
+
+    const std::string filename = "terrain-bench-trace.json";
+    if (TRACE_WRITE(filename))
+    {
+        std::cout << "trace: " << filename << "\n";
+    }
+}
+
+// Flies a fixed path over the infinite world at 60 frames per second
+void benchmarkStream()
+{
+    const int frameCount = 600;
+    const float chunkWorldSize = static_cast<float>(c_chunkSize) * c_worldScale;
+    const float speed = 0.05f * chunkWorldSize;
+    const std::chrono::microseconds frameTime(16667);
+    int workerCount = std::max(getDefaultThreadCount() - 1, 1);
+
+    TerrainStreamer streamer(c_seed, workerCount);
+    std::unordered_map<int64_t, std::shared_ptr<const TerrainChunk>> chunks;
+    std::vector<std::shared_ptr<const TerrainChunk>> ready;
+    std::vector<int64_t> evicted;
+    int missingFrames = 0;
+    Clock::time_point start = Clock::now();
+    for (int frame = 0; frame < frameCount; ++frame)
+    {
+        Clock::time_point frameStart = Clock::now();
+        float x = speed * static_cast<float>(frame);
+        float z = 0.5f * speed * static_cast<float>(frame);
+        ready.clear();
+        evicted.clear();
+        streamer.update(x, z, ready, evicted);
+        for (const std::shared_ptr<const TerrainChunk>& chunk : ready)
+        {
+            chunks[TerrainStreamer::getChunkKey(chunk->x, chunk->z)] = chunk;
+        }
+        for (int64_t key : evicted)
+        {
+            chunks.erase(key);
+        }
+        int cx = static_cast<int>(std::floor(x / chunkWorldSize));
+        int cz = static_cast<int>(std::floor(z / chunkWorldSize));
+        if (chunks.find(TerrainStreamer::getChunkKey(cx, cz)) == chunks.end())
+        {
+            ++missingFrames;
+        }
+        std::this_thread::sleep_until(frameStart + frameTime);
+    }
+    double seconds = secondsSince(start);
+
+    StreamingStats stats = streamer.getStats();
+    long long requests = stats.cacheHits + stats.cacheMisses;
+    std::cout << "stream " << frameCount << " frames in " << seconds << " s, " << workerCount << " workers\n"
+              << "  chunks generated " << stats.generated << ", cancelled " << stats.cancelled << ", evicted " << stats.evicted
+              << ", resident " << streamer.getResidentCount() << "\n"
+              << "  cache hit rate " << static_cast<double>(stats.cacheHits) / std::max(requests, 1LL) << "\n"
+              << "  generation " << stats.totalGenerationSeconds * 1000.0 / std::max(stats.generated, 1LL) << " ms/chunk\n"
+              << "  latency average " << stats.totalLatencySeconds * 1000.0 / std::max(stats.generated, 1LL) << " ms, max "
+              << stats.maxLatencySeconds * 1000.0 << " ms\n"
+              << "  frames without the chunk under the camera " << missingFrames << "\n";
+
+    // Shared borders of neighboring chunks must match exactly
+    int seams = 0;
+    int crackedSeams = 0;
+    for (const auto& entry : chunks)
+    {
+        const TerrainChunk& chunk = *entry.second;
+        auto right = chunks.find(TerrainStreamer::getChunkKey(chunk.x + 1, chunk.z));
+        auto below = chunks.find(TerrainStreamer::getChunkKey(chunk.x, chunk.z + 1));
+        const int n = c_chunkSize;
+        const int floatsPerVertex = 6;
+        auto vertex = [&](const TerrainChunk& c, int x, int y) { return &c.mesh.vertices[(static_cast<size_t>(y) * (n + 1) + x) * floatsPerVertex]; };
+        for (int i = 0; i <= n; ++i)
+        {
+            if (right != chunks.end())
+            {
+                const float* a = vertex(chunk, n, i);
+                const float* b = vertex(*right->second, 0, i);
+                crackedSeams += !(chunk.heights.at(n, i) == right->second->heights.at(0, i) && std::equal(a + 3, a + 6, b + 3));
+            }
+            if (below != chunks.end())
+            {
+                const float* a = vertex(chunk, i, n);
+                const float* b = vertex(*below->second, i, 0);
+                crackedSeams += !(chunk.heights.at(i, n) == below->second->heights.at(i, 0) && std::equal(a + 3, a + 6, b + 3));
+            }
+        }
+        seams += (right != chunks.end()) + (below != chunks.end());
+    }
+    check(crackedSeams == 0, "stream chunk borders match");
+    std::cout << "  seams checked " << seams << ", mismatching border samples " << crackedSeams << "\n";
+}
+
+struct SuiteOptions
+{
+    int warmup = 2;
+    int repetitions = 10;
+    std::vector<int> sizes = {256, c_worldWidth, 1024};
+    std::vector<unsigned int> seeds = {c_seed, 1, 2};
+    std::string jsonFilename;
+};
+
+struct SuiteResult
+{
+    std::string stage;
+    int size;
+    unsigned int seed;
+    int threads;
+    std::vector<double> milliseconds;
+};
+
+// Runs setup untimed before every repetition, warm-up runs are discarded
+std::vector<double> measure(const SuiteOptions& options, const std::function<void()>& setup, const std::function<void()>& run)
+{
+    std::vector<double> milliseconds;
+    for (int i = 0; i < options.warmup + options.repetitions; ++i)
+    {
+        setup();
+        Clock::time_point start = Clock::now();
+        run();
+        double elapsed = secondsSince(start) * 1000.0;
+        if (i >= options.warmup)
+        {
+            milliseconds.push_back(elapsed);
+        }
+    }
+    return milliseconds;
+}
+
+void getStatistics(std::vector<double> values, double& min, double& median, double& mean, double& deviation, double& max)
+{
+    std::sort(values.begin(), values.end());
+    size_t count = values.size();
+    min = values.front();
+    max = values.back();
+    median = count % 2 == 1 ? values[count / 2] : 0.5 * (values[count / 2 - 1] + values[count / 2]);
+    mean = 0.0;
+    for (double value : values)
+    {
+        mean += value;
+    }
+    mean /= static_cast<double>(count);
+    deviation = 0.0;
+    for (double value : values)
+    {
+        deviation += (value - mean) * (value - mean);
+    }
+    deviation = count > 1 ? std::sqrt(deviation / static_cast<double>(count - 1)) : 0.0;
+}
+
+bool writeSuiteJson(const std::string& filename, const SuiteOptions& options, const std::vector<SuiteResult>& results)
+{
+    std::ofstream file(filename.c_str());
+    if (!file)
+    {
+        std::cerr << "ERROR: Could not open file: " << filename << "\n";
+        return false;
+    }
+
+    file << "{\n"
+         << "  \"stampKernel\": \"" << getStampKernelName(getStampKernel()) << "\",\n"
+         << "  \"stampMode\": \"" << (getStampMode() == StampMode::Cached ? "cached" : "exact") << "\",\n"
+         << "  \"hardwareThreads\": " << getDefaultThreadCount() << ",\n"
+         << "  \"warmup\": " << options.warmup << ",\n"
+         << "  \"repetitions\": " << options.repetitions << ",\n"
+         << "  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        const SuiteResult& result = results[i];
+        double min, median, mean, deviation, max;
+        getStatistics(result.milliseconds, min, median, mean, deviation, max);
+        file << "    {\"stage\": \"" << result.stage << "\", \"size\": " << result.size << ", \"seed\": " << result.seed
+             << ", \"threads\": " << result.threads << ", \"minMs\": " << min << ", \"medianMs\": " << median << ", \"meanMs\": " << mean
+             << ", \"stddevMs\": " << deviation << ", \"maxMs\": " << max << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    file << "  ]\n"
+         << "}\n";
+    return true;
+}
+
+// Every generation and meshing stage over the world sizes and seeds
+bool benchmarkSuite(const SuiteOptions& options)
+{
+    std::vector<SuiteResult> results;
+    int threads = getDefaultThreadCount();
+    for (int size : options.sizes)
+    {
+        WorldParams params;
+        params.width = size;
+        params.height = size;
+        params.minMountainLength = c_minMountainLength * size / c_worldWidth;
+        params.maxMountainLength = c_maxMountainLength * size / c_worldWidth;
+        params.mountainEdgeMargin = c_mountainEdgeMargin * size / c_worldWidth;
+        params.riverEndPointMargin = c_riverEndPointMargin * size / c_worldWidth;
+
+        for (unsigned int seed : options.seeds)
+        {
+            Heightfield world(size + 1, size + 1);
+            Heightfield mountains(size + 1, size + 1);
+            std::vector<Bump> bumps;
+            Heightfield scratch;
+            for (int i = 0; i < params.numMountains; ++i)
+            {
+                createMountainBumps(params, seed, i, bumps);
+            }
+            stampBumps(mountains, bumps, 1);
+
+            auto clear = [&]() { world.fill(0.0f); };
+            auto none = []() {};
+            auto add = [&](const std::string& stage, int stageThreads, const std::vector<double>& milliseconds) {
+                results.push_back({stage, size, seed, stageThreads, milliseconds});
+            };
+
+            add("createBump", 1, measure(options, clear, [&]() { createBump(world, size / 2, size / 2, c_maxHeightMultiplier, c_maxBumpDeviation); }));
+            add("createMountain", 1, measure(options, clear, [&]() { createMountain(world, seed, 0, params); }));
+            add("createRiver", 1, measure(options, [&]() { world = mountains; }, [&]() { createRiver(world, params); }));
+            add("generateWorld", 1, measure(options, none, [&]() { generateWorld(world, seed, params, 1, bumps, scratch); }));
+            if (threads > 1)
+            {
+                add("generateWorld", threads, measure(options, none, [&]() { generateWorld(world, seed, params, threads, bumps, scratch); }));
+            }
+
+            // One droplet per 16 cells on the finished world
+            WorldParams erosionParams = params;
+            erosionParams.erosionDroplets = size * size / 16;
+            Heightfield generated = world;
+            auto restore = [&]() { world = generated; };
+            add("erodeHydraulic", 1, measure(options, restore, [&]() { erodeHydraulic(world, seed, erosionParams, 1); }));
+            if (threads > 1)
+            {
+                add("erodeHydraulic", threads, measure(options, restore, [&]() { erodeHydraulic(world, seed, erosionParams, threads); }));
+            }
+            add("erodeThermal", 1, measure(options, restore, [&]() { erodeThermal(world, scratch, 10, c_thermalTalus, c_thermalRate, 1); }));
+            add("smoothHeights", 1, measure(options, restore, [&]() { smoothHeights(world, scratch, 10, c_smoothStrength, 1); }));
+            world = generated;
+
+            std::vector<int> indices;
+            std::vector<float> vertices;
+            IndexedMesh indexedMesh;
+            PackedMesh packedMesh;
+            add("generateMesh", 1, measure(options, none, [&]() { generateMesh(world, indices, vertices); }));
+            if (threads > 1)
+            {
+                add("generateMesh", threads, measure(options, none, [&]() { generateMesh(world, indices, vertices, threads); }));
+            }
+            add("generateIndexedMesh", 1, measure(options, none, [&]() { generateIndexedMesh(world, indexedMesh); }));
+            add("generatePackedMesh", 1, measure(options, none, [&]() { generatePackedMesh(world, c_packedNormalBits, packedMesh); }));
+        }
+    }
+
+    std::cout << "stage                 size       seed threads    median ms      mean ms    stddev ms\n";
+    for (const SuiteResult& result : results)
+    {
+        double min, median, mean, deviation, max;
+        getStatistics(result.milliseconds, min, median, mean, deviation, max);
+        char line[160];
+        std::snprintf(line, sizeof(line), "%-20s %5d %10u %7d %12.4f %12.4f %12.4f\n", result.stage.c_str(), result.size, result.seed,
+                      result.threads, median, mean, deviation);
+        std::cout << line;
+    }
+    return options.jsonFilename.empty() || writeSuiteJson(options.jsonFilename, options, results);
+}
+
+bool parseSuiteOptions(int argc, char** argv, SuiteOptions& options)
+{
+    auto parseList = [](const std::string& text, std::vector<int>& values) {
+        values.clear();
+        std::string::size_type start = 0;
+        while (start <= text.size())
+        {
+            std::string::size_type end = text.find(',', start);
+            end = end == std::string::npos ? text.size() : end;
+            int value = std::atoi(text.substr(start, end - start).c_str());
+            if (value <= 0)
+            {
+                return false;
+            }
+            values.push_back(value);
+            start = end + 1;
+        }
+        return !values.empty();
+    };
+
+    for (int i = 2; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        std::vector<int> values;
+        if (arg == "--warmup" && hasValue)
+        {
+            options.warmup = std::atoi(argv[++i]);
+        }
+        else if (arg == "--repetitions" && hasValue)
+        {
+            options.repetitions = std::atoi(argv[++i]);
+        }
+        else if (arg == "--sizes" && hasValue && parseList(argv[++i], values))
+        {
+            options.sizes = values;
+        }
+        else if (arg == "--seeds" && hasValue && parseList(argv[++i], values))
+        {
+            options.seeds.assign(values.begin(), values.end());
+        }
+        else if (arg == "--json" && hasValue)
+        {
+            options.jsonFilename = argv[++i];
+        }
+        else
+        {
+            return false;
+        }
+    }
+    return options.warmup >= 0 && options.repetitions > 0;
+}
+
+void printUsage()
+{
+    std::cout << "Usage: terrain-bench <benchmark>\n"
+              << "  suite      Every generation and meshing stage with statistics, options:\n"
+              << "             --warmup N, --repetitions N, --sizes A,B,..., --seeds A,B,...,\n"
+              << "             --json FILE to write the results as JSON\n"
+              << "  stamp      Gaussian bump stamping kernels against the reference formula\n"
+              << "  generate   World generation thread scaling\n"
+              << "  mesh       Triangle soup against the indexed and packed meshes and height texture\n"
+              << "  soup       Triangle soup against the original mesher and thread scaling\n"
+              << "  lod        Geomipmap level selection along a camera path\n"
+              << "  cull       Frustum and horizon culling of the level of detail patches\n"
+              << "  cache      Cold startup against the memory mapped world cache\n"
+              << "  stream     Chunk streaming along a camera path\n"
+              << "  river      Iterative against closed form river carving\n"
+              << "  erosion    Hydraulic erosion thread scaling\n"
+              << "  stencil    Thermal erosion and smoothing kernels and threads\n"
+              << "  edit       Partial mesh updates after craters and flattening\n"
+              << "  tiles      Out-of-core tiles against the in-core world\n"
+              << "  query      Point height queries against sampling a generated grid\n"
+              << "  ray        Ray casting with the height pyramid against walking the cells\n"
+              << "  adaptive   Adaptive triangulation against the full resolution mesh\n"
+              << "  trace      Overhead of the trace scopes\n"
+              << "Exits with 2 when a correctness check of the benchmark fails.\n";
+}
+
+int main(int argc, char** argv)
+{
+    std::string benchmark = argc >= 2 ? argv[1] : "";
+    if (benchmark == "suite")
+    {
+        SuiteOptions options;
+        if (!parseSuiteOptions(argc, argv, options))
+        {
+            printUsage();
+            return 1;
+        }
+        return benchmarkSuite(options) ? 0 : 2;
+    }
+    if (argc != 2)
+    {
+        printUsage();
+        return 1;
+    }
+
+    if (benchmark == "stamp")
+    {
+        benchmarkStamp();
+    }
+    else if (benchmark == "generate")
+    {
+        benchmarkGenerate();
+    }
+    else if (benchmark == "mesh")
+    {
+        benchmarkMesh();
+    }
+    else if (benchmark == "soup")
+    {
+        benchmarkSoup();
+    }
+    else if (benchmark == "lod")
+    {
+        benchmarkLod();
+    }
+    else if (benchmark == "cull")
+    {
+        benchmarkCull();
+    }
+    else if (benchmark == "cache")
+    {
+        benchmarkCache();
+    }
+    else if (benchmark == "stream")
+    {
+        benchmarkStream();
+    }
+    else if (benchmark == "river")
+    {
+        benchmarkRiver();
+    }
+    else if (benchmark == "erosion")
+    {
+        benchmarkErosion();
+    }
+    else if (benchmark == "stencil")
+    {
+        benchmarkStencil();
+    }
+    else if (benchmark == "edit")
+    {
+        benchmarkEdit();
+    }
+    else if (benchmark == "tiles")
+    {
+        benchmarkTiles();
+    }
+    else if (benchmark == "query")
+    {
+        benchmarkQuery();
+    }
+    else if (benchmark == "ray")
+    {
+        benchmarkRay();
+    }
+    else if (benchmark == "adaptive")
+    {
+        benchmarkAdaptive();
+    }
+    else if (benchmark == "trace")
+    {
+        benchmarkTrace();
+    }
+    else
+    {
+        printUsage();
+        return 1;
+    }
+    return failedChecks == 0 ? 0 : 2;
+}
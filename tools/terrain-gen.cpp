@@ -0,0 +1,460 @@
+#include "world.h"
+#include "mesh.h"
+#include "outOfCore.h"
+#include "parallel.h"
+#include "WorldParams.h"
+#include "trace.h"
+#include "constants.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+struct Options
+{
+    unsigned int seed = c_seed;
+    int count = 1;
+    int width = c_worldWidth;
+    int height = c_worldHeight;
+    Heightfield::Layout layout = Heightfield::Layout::RowMajor;
+    int threads = getDefaultThreadCount();
+    bool mesh = true;
+    bool indexed = false;
+    std::string outputPrefix;
+    std::string manifest;
+    std::string traceFilename;
+    int tileSize = 0;
+    bool gltf = false;
+    size_t maxMemory = 0;
+};
+
+// Seed and parameters of one world in a batch
+struct Job
+{
+    unsigned int seed;
+    WorldParams params;
+};
+
+void printUsage()
+{
+    std::cout << "Usage: terrain-gen [options]\n"
+              << "  --seed N       Seed of the first world (default " << c_seed << ")\n"
+              << "  --count N      Number of worlds to generate, seeds N, N+1, ... (default 1)\n"
+              << "  --width N      World width in cells (default " << c_worldWidth << ")\n"
+              << "  --height N     World height in cells (default " << c_worldHeight << ")\n"
+              << "  --tiled        Store heights in tiled instead of row-major layout\n"
+              << "  --threads N    Generation threads (default " << getDefaultThreadCount() << ")\n"
+              << "  --no-mesh      Generate heightfields only\n"
+              << "  --indexed      Generate indexed meshes with one vertex per height sample\n"
+              << "  --output PATH  Write PATH_<seed>.heights and PATH_<seed>.mesh for each world\n"
+              << "  --manifest FILE\n"
+              << "                 Generate the jobs of FILE on --threads threads, one job per line as\n"
+              << "                 <seed> [name=value ...] with WorldParams member names, e.g.\n"
+              << "                 \"42 width=256 height=256 numMountains=8\". Output files are\n"
+              << "                 PATH_<line>_<seed>. --seed, --count, --width and --height are ignored.\n"
+              << "  --tiles N      Generate one world out of core in tiles of N cells and write\n"
+              << "                 PATH.tiles, PATH_<x>_<y>.r16 heights and PATH_<x>_<y>.mesh meshes.\n"
+              << "                 Rivers and erosion are not applied. --count is ignored.\n"
+              << "  --gltf         Write the tile meshes as PATH_<x>_<y>.gltf and .bin\n"
+              << "  --max-memory N Lower the tile threads and size until the estimated peak is at\n"
+              << "                 most N MiB\n"
+              << "  --trace FILE   Write Chrome trace events of the run to FILE, needs a build\n"
+              << "                 configured with TERRAIN_TRACING\n";
+}
+
+bool parseOptions(int argc, char** argv, Options& options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--seed" && hasValue)
+        {
+            options.seed = static_cast<unsigned int>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (arg == "--count" && hasValue)
+        {
+            options.count = std::atoi(argv[++i]);
+        }
+        else if (arg == "--width" && hasValue)
+        {
+            options.width = std::atoi(argv[++i]);
+        }
+        else if (arg == "--height" && hasValue)
+        {
+            options.height = std::atoi(argv[++i]);
+        }
+        else if (arg == "--tiled")
+        {
+            options.layout = Heightfield::Layout::Tiled;
+        }
+        else if (arg == "--threads" && hasValue)
+        {
+            options.threads = std::atoi(argv[++i]);
+        }
+        else if (arg == "--no-mesh")
+        {
+            options.mesh = false;
+        }
+        else if (arg == "--indexed")
+        {
+            options.indexed = true;
+        }
+        else if (arg == "--output" && hasValue)
+        {
+            options.outputPrefix = argv[++i];
+        }
+        else if (arg == "--manifest" && hasValue)
+        {
+            options.manifest = argv[++i];
+        }
+        else if (arg == "--tiles" && hasValue)
+        {
+            options.tileSize = std::atoi(argv[++i]);
+            if (options.tileSize <= 0)
+            {
+                return false;
+            }
+        }
+        else if (arg == "--gltf")
+        {
+            options.gltf = true;
+        }
+        else if (arg == "--max-memory" && hasValue)
+        {
+            options.maxMemory = static_cast<size_t>(std::strtoull(argv[++i], nullptr, 10)) * 1024 * 1024;
+        }
+        else if (arg == "--trace" && hasValue)
+        {
+            options.traceFilename = argv[++i];
+        }
+        else
+        {
+            return false;
+        }
+    }
+    return options.count > 0 && options.width > 0 && options.height > 0 && options.threads > 0;
+}
+
+// Heights are written row by row as 32-bit floats, preceded by the sample counts
+bool writeHeights(const std::string& filename, const Heightfield& world)
+{
+    std::ofstream file(filename.c_str(), std::ios::binary);
+    if (!file)
+    {
+        std::cerr << "ERROR: Could not open file: " << filename << "\n";
+        return false;
+    }
+    uint32_t rows = static_cast<uint32_t>(world.getHeight());
+    uint32_t columns = static_cast<uint32_t>(world.getWidth());
+    file.write(reinterpret_cast<const char*>(&rows), sizeof(rows));
+    file.write(reinterpret_cast<const char*>(&columns), sizeof(columns));
+    std::vector<float> row(columns);
+    for (int y = 0; y < world.getHeight(); ++y)
+    {
+        for (int x = 0; x < world.getWidth(); ++x)
+        {
+            row[x] = world.at(x, y);
+        }
+        file.write(reinterpret_cast<const char*>(row.data()), sizeof(float) * row.size());
+    }
+    return true;
+}
+
+// Mesh is written as vertex float count, index count, interleaved vertices and indices
+bool writeMesh(const std::string& filename, const std::vector<int>& indices, const std::vector<float>& vertices)
+{
+    std::ofstream file(filename.c_str(), std::ios::binary);
+    if (!file)
+    {
+        std::cerr << "ERROR: Could not open file: " << filename << "\n";
+        return false;
+    }
+    uint32_t vertexCount = static_cast<uint32_t>(vertices.size());
+    uint32_t indexCount = static_cast<uint32_t>(indices.size());
+    file.write(reinterpret_cast<const char*>(&vertexCount), sizeof(vertexCount));
+    file.write(reinterpret_cast<const char*>(&indexCount), sizeof(indexCount));
+    file.write(reinterpret_cast<const char*>(vertices.data()), sizeof(float) * vertices.size());
+    file.write(reinterpret_cast<const char*>(indices.data()), sizeof(int) * indices.size());
+    return true;
+}
+
+bool readManifest(const std::string& filename, std::vector<Job>& jobs)
+{
+    std::ifstream file(filename.c_str());
+    if (!file)
+    {
+        std::cerr << "ERROR: Could not open file: " << filename << "\n";
+        return false;
+    }
+
+    std::string line;
+    for (int lineNumber = 1; std::getline(file, line); ++lineNumber)
+    {
+        std::istringstream fields(line.substr(0, line.find('#')));
+        std::string field;
+        if (!(fields >> field))
+        {
+            continue;
+        }
+
+        Job job;
+        char* end = nullptr;
+        job.seed = static_cast<unsigned int>(std::strtoul(field.c_str(), &end, 10));
+        bool valid = *end == '\0';
+        while (valid && fields >> field)
+        {
+            size_t separator = field.find('=');
+            valid = separator != std::string::npos && setWorldParam(job.params, field.substr(0, separator), field.substr(separator + 1));
+        }
+        if (!valid)
+        {
+            std::cerr << "ERROR: " << filename << ":" << lineNumber << ": Invalid field: " << field << "\n";
+            return false;
+        }
+        if (!validateWorldParams(job.params))
+        {
+            std::cerr << "ERROR: " << filename << ":" << lineNumber << "\n";
+            return false;
+        }
+        jobs.push_back(job);
+    }
+    return true;
+}
+
+// Buffers of one batch thread, reused from job to job
+struct BatchBuffers
+{
+    Heightfield world;
+    std::vector<Bump> bumps;
+    Heightfield scratch;
+    std::vector<int> indices;
+    std::vector<float> vertices;
+    IndexedMesh indexedMesh;
+    int jobs = 0;
+};
+
+int runBatch(const Options& options)
+{
+    std::vector<Job> jobs;
+    if (!readManifest(options.manifest, jobs))
+    {
+        return 1;
+    }
+
+    std::vector<BatchBuffers> buffers(options.threads);
+    for (BatchBuffers& buffer : buffers)
+    {
+        buffer.world.resize(1, 1, options.layout);
+    }
+    std::atomic<bool> failed(false);
+
+    typedef std::chrono::high_resolution_clock Clock;
+    Clock::time_point start = Clock::now();
+    parallelForStealing(static_cast<int>(jobs.size()), options.threads, [&](int thread, int i) {
+        TRACE_SCOPE("job");
+        const Job& job = jobs[i];
+        BatchBuffers& buffer = buffers[thread];
+        generateWorld(buffer.world, job.seed, job.params, 1, buffer.bumps, buffer.scratch);
+        if (options.mesh && options.indexed)
+        {
+            generateIndexedMesh(buffer.world, buffer.indexedMesh);
+        }
+        else if (options.mesh)
+        {
+            generateMesh(buffer.world, buffer.indices, buffer.vertices);
+        }
+        ++buffer.jobs;
+
+        if (!options.outputPrefix.empty())
+        {
+            std::string prefix = options.outputPrefix + "_" + std::to_string(i) + "_" + std::to_string(job.seed);
+            bool written = writeHeights(prefix + ".heights", buffer.world);
+            if (options.mesh && options.indexed)
+            {
+                written = written && writeIndexedMesh(prefix + ".mesh", buffer.indexedMesh);
+            }
+            else if (options.mesh)
+            {
+                written = written && writeMesh(prefix + ".mesh", buffer.indices, buffer.vertices);
+            }
+            if (!written)
+            {
+                failed = true;
+            }
+        }
+    });
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    if (failed)
+    {
+        return 2;
+    }
+
+    int minJobs = static_cast<int>(jobs.size());
+    int maxJobs = 0;
+    for (const BatchBuffers& buffer : buffers)
+    {
+        minJobs = std::min(minJobs, buffer.jobs);
+        maxJobs = std::max(maxJobs, buffer.jobs);
+    }
+    std::cout << "jobs: " << jobs.size() << " on " << options.threads << " threads (" << minJobs << " to " << maxJobs << " per thread)\n"
+              << "time: " << seconds * 1000.0 << " ms\n"
+              << "throughput: " << jobs.size() / seconds << " terrains/s\n";
+    return 0;
+}
+
+int runSeeds(const Options& options)
+{
+    typedef std::chrono::high_resolution_clock Clock;
+    double generationSeconds = 0.0;
+    double meshSeconds = 0.0;
+
+    for (int i = 0; i < options.count; ++i)
+    {
+        unsigned int seed = options.seed + static_cast<unsigned int>(i);
+
+        Clock::time_point start = Clock::now();
+        Heightfield world(options.width + 1, options.height + 1, options.layout);
+        generateWorld(world, seed, options.threads);
+        Clock::time_point generated = Clock::now();
+        generationSeconds += std::chrono::duration<double>(generated - start).count();
+
+        std::vector<int> indices;
+        std::vector<float> vertices;
+        IndexedMesh indexedMesh;
+        if (options.mesh)
+        {
+            if (options.indexed)
+            {
+                generateIndexedMesh(world, indexedMesh);
+            }
+            else
+            {
+                generateMesh(world, indices, vertices, options.threads);
+            }
+            meshSeconds += std::chrono::duration<double>(Clock::now() - generated).count();
+        }
+
+        if (!options.outputPrefix.empty())
+        {
+            std::string prefix = options.outputPrefix + "_" + std::to_string(seed);
+            if (!writeHeights(prefix + ".heights", world))
+            {
+                return 2;
+            }
+            if (options.mesh && options.indexed && !writeIndexedMesh(prefix + ".mesh", indexedMesh))
+            {
+                return 2;
+            }
+            if (options.mesh && !options.indexed && !writeMesh(prefix + ".mesh", indices, vertices))
+            {
+                return 2;
+            }
+        }
+    }
+
+    double totalSeconds = generationSeconds + meshSeconds;
+    std::cout << "worlds: " << options.count << " (" << options.width << "x" << options.height << ")\n"
+              << "generation: " << generationSeconds * 1000.0 / options.count << " ms/world\n";
+    if (options.mesh)
+    {
+        std::cout << "meshing: " << meshSeconds * 1000.0 / options.count << " ms/world\n";
+    }
+    std::cout << "throughput: " << options.count / totalSeconds << " worlds/s\n";
+    return 0;
+}
+
+// Peak resident set size of the process in bytes, 0 where unknown
+size_t getPeakMemory()
+{
+#ifdef _WIN32
+    return 0;
+#else
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return static_cast<size_t>(usage.ru_maxrss);
+#else
+    return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+int runTiles(const Options& options)
+{
+    if (options.outputPrefix.empty())
+    {
+        std::cerr << "ERROR: --tiles needs --output\n";
+        return 1;
+    }
+    WorldParams params;
+    params.width = options.width;
+    params.height = options.height;
+    TileExportOptions exportOptions;
+    exportOptions.tileSize = options.tileSize;
+    exportOptions.threadCount = options.threads;
+    exportOptions.maxMemory = options.maxMemory;
+    exportOptions.meshFormat = !options.mesh ? TileMeshFormat::None : options.gltf ? TileMeshFormat::Gltf : TileMeshFormat::Binary;
+    exportOptions.outputPrefix = options.outputPrefix;
+
+    typedef std::chrono::high_resolution_clock Clock;
+    Clock::time_point start = Clock::now();
+    TileExportStats stats;
+    if (!exportTiles(options.seed, params, exportOptions, stats))
+    {
+        return 2;
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    double cells = static_cast<double>(options.width) * options.height;
+    std::cout << "world: " << options.width << "x" << options.height << ", " << stats.bumpCount << " bumps\n"
+              << "tiles: " << stats.tileCount << " of " << stats.tileSize << " cells on " << stats.threadCount << " threads\n"
+              << "time: " << seconds * 1000.0 << " ms, " << cells / seconds / 1e6 << " M cells/s\n"
+              << "written: " << stats.bytesWritten / (1024.0 * 1024.0) << " MiB\n"
+              << "memory: " << stats.estimatedMemory / (1024.0 * 1024.0) << " MiB estimated, " << getPeakMemory() / (1024.0 * 1024.0)
+              << " MiB peak resident\n";
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    if (!parseOptions(argc, argv, options))
+    {
+        printUsage();
+        return 1;
+    }
+    TRACE_THREAD_NAME("main");
+
+    int result = 0;
+    if (options.tileSize > 0)
+    {
+        result = runTiles(options);
+    }
+    else
+    {
+        result = options.manifest.empty() ? runSeeds(options) : runBatch(options);
+    }
+    if (!options.traceFilename.empty())
+    {
+#ifdef TERRAIN_TRACING
+        if (TRACE_WRITE(options.traceFilename))
+        {
+            std::cout << "trace: " << options.traceFilename << "\n";
+        }
+#else
+        std::cerr << "ERROR: Trace not written, configure with -DTERRAIN_TRACING=ON\n";
+#endif
+    }
+    return result;
+}